@@ -0,0 +1,1181 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file microbenchmark.cpp
+ * @brief Benchmarks the hot paths of the API without any scan heads. Synthetic
+ * profile data, byte ordered as the scan head sends it, is fed through the
+ * same code that handles data received from the network. For each benchmark,
+ * the time per operation, the points handled per second and the number of
+ * heap allocations per operation are reported, so that regressions in the
+ * receive path become visible.
+ *
+ * Each benchmark runs for the given time; use `--filter` to only run those
+ * whose name contains the given text.
+ *
+ * With `--check`, nothing is benchmarked; instead, the fixed point camera to
+ * mill conversion is checked against double precision math for every kind of
+ * alignment, and each `ProcessPointsXY` implementation the CPU supports is
+ * checked to produce bit identical results to the plain C++ one. Profiles
+ * with a single valid point are also assembled into storage that last held
+ * profiles full of valid points, to check nothing is left over.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AlignmentParams.hpp"
+#include "DataPacket.hpp"
+#include "DatagramHeader.hpp"
+#include "NetworkTypes.hpp"
+#include "PhaseTable.hpp"
+#include "ProfileKernels.hpp"
+#include "ScanHead.hpp"
+#include "ScanManager.hpp"
+#include "TcpSerializationHelpers.hpp"
+#include "Version.hpp"
+#include "joescan_pinchot.h"
+
+#include "cxxopts.hpp"
+
+using namespace joescan;
+
+static std::atomic<uint64_t> _allocations(0);
+
+// Count every heap allocation made, including those made by the API itself.
+// The replacements are kept out of line so the compiler doesn't see `free`
+// paired with `new` and warn of a mismatch.
+#if defined(__GNUC__) || defined(__clang__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void *operator new(std::size_t size)
+{
+  _allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = std::malloc((0 == size) ? 1 : size);
+  if (nullptr == p) {
+    throw std::bad_alloc();
+  }
+
+  return p;
+}
+
+NOINLINE void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+NOINLINE void operator delete(void *p, std::size_t size) noexcept
+{
+  (void)size;
+  std::free(p);
+}
+
+// server sends int16_t x/y data points; invalid is int16_t minimum
+static const int16_t kInvalidXY = -32768;
+// profiles passed to `ScanHead::ReceiveData` at a time
+static const uint32_t kProfilesPerBatch = 64;
+// profiles copied out per call to `ScanHead::GetProfiles`, as the C API does
+static const uint32_t kCopyBatchSize = 32;
+static const double kPi = 3.14159265358979323846;
+
+// keeps results from being optimized out
+static volatile uint64_t _sink = 0;
+
+/**
+ * @brief Time and counts accumulated over the timed sections of a benchmark.
+ */
+struct Measurement {
+  uint64_t ns = 0;
+  uint64_t ops = 0;
+  uint64_t points = 0;
+  uint64_t allocations = 0;
+};
+
+/**
+ * @brief Times a section of a benchmark, adding to a `Measurement` when
+ * destroyed.
+ */
+class TimedSection {
+ public:
+  TimedSection(Measurement &m, uint64_t ops, uint64_t points)
+    : m_measurement(m),
+      m_ops(ops),
+      m_points(points),
+      m_allocations(_allocations.load(std::memory_order_relaxed)),
+      m_start(std::chrono::steady_clock::now())
+  {
+  }
+
+  ~TimedSection()
+  {
+    auto end = std::chrono::steady_clock::now();
+    m_measurement.ns += static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start)
+        .count());
+    m_measurement.allocations +=
+      _allocations.load(std::memory_order_relaxed) - m_allocations;
+    m_measurement.ops += m_ops;
+    m_measurement.points += m_points;
+  }
+
+ private:
+  Measurement &m_measurement;
+  uint64_t m_ops;
+  uint64_t m_points;
+  uint64_t m_allocations;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+static void PrintHeader()
+{
+  printf("%-40s %12s %14s %12s\n", "benchmark", "ns/op", "points/s",
+         "allocs/op");
+}
+
+static void PrintResult(const std::string &name, const Measurement &m)
+{
+  const double ops = (0 == m.ops) ? 1.0 : static_cast<double>(m.ops);
+  const double s = static_cast<double>(m.ns) * 1e-9;
+  const double points_per_s = (0.0 == s) ? 0.0 : m.points / s;
+
+  printf("%-40s %12.1f %14.4g %12.2f\n", name.c_str(), m.ns / ops,
+         points_per_s, m.allocations / ops);
+}
+
+/**
+ * @brief Synthetic scan line: a curved surface spanning the camera's columns
+ * with a tenth of the columns, near either edge, left invalid.
+ */
+static void SyntheticPoint(uint32_t column, uint32_t columns, int16_t *x,
+                           int16_t *y, uint8_t *brightness)
+{
+  const uint32_t margin = columns / 20;
+
+  if ((column < margin) || (column >= (columns - margin))) {
+    *x = kInvalidXY;
+    *y = kInvalidXY;
+    *brightness = 0;
+    return;
+  }
+
+  double t = static_cast<double>(column) / columns;
+  *x = static_cast<int16_t>((static_cast<int32_t>(column) -
+                             static_cast<int32_t>(columns / 2)) * 20);
+  *y = static_cast<int16_t>(4000 + 6000 * std::sin(t * kPi));
+  *brightness = static_cast<uint8_t>(80 + (column % 128));
+}
+
+// only valid column of the profiles checked by `CheckSparseProfiles`
+static const uint32_t kSparseColumn = 700;
+// columns sent for the profiles checked by `CheckSparseProfiles`, fewer than
+// the dense profiles before them so stale points could linger past the end
+static const uint32_t kSparseColumns = 1024;
+
+/**
+ * @brief Synthetic scan line with every column valid.
+ */
+static void DensePoint(uint32_t column, uint32_t columns, int16_t *x,
+                       int16_t *y, uint8_t *brightness)
+{
+  *x = static_cast<int16_t>((static_cast<int32_t>(column) -
+                             static_cast<int32_t>(columns / 2)) * 20);
+  *y = static_cast<int16_t>(1000 + column);
+  *brightness = static_cast<uint8_t>(1 + (column % 200));
+}
+
+/**
+ * @brief Synthetic scan line with a single valid column.
+ */
+static void SparsePoint(uint32_t column, uint32_t columns, int16_t *x,
+                        int16_t *y, uint8_t *brightness)
+{
+  if (kSparseColumn != column) {
+    *x = kInvalidXY;
+    *y = kInvalidXY;
+    *brightness = 0;
+    return;
+  }
+
+  DensePoint(column, columns, x, y, brightness);
+}
+
+static uint16_t FormatToMask(jsDataFormat format)
+{
+  switch (format) {
+    case (JS_DATA_FORMAT_XY_FULL):
+    case (JS_DATA_FORMAT_XY_HALF):
+    case (JS_DATA_FORMAT_XY_QUARTER):
+      return DataType::XYData;
+    default:
+      return DataType::XYData | DataType::Brightness;
+  }
+}
+
+static uint32_t FormatToStride(jsDataFormat format)
+{
+  switch (format) {
+    case (JS_DATA_FORMAT_XY_BRIGHTNESS_HALF):
+    case (JS_DATA_FORMAT_XY_HALF):
+      return 2;
+    case (JS_DATA_FORMAT_XY_BRIGHTNESS_QUARTER):
+    case (JS_DATA_FORMAT_XY_QUARTER):
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+static const char *FormatToString(jsDataFormat format)
+{
+  switch (format) {
+    case (JS_DATA_FORMAT_XY_BRIGHTNESS_FULL):
+      return "xy_brightness_full";
+    case (JS_DATA_FORMAT_XY_BRIGHTNESS_HALF):
+      return "xy_brightness_half";
+    case (JS_DATA_FORMAT_XY_BRIGHTNESS_QUARTER):
+      return "xy_brightness_quarter";
+    case (JS_DATA_FORMAT_XY_FULL):
+      return "xy_full";
+    case (JS_DATA_FORMAT_XY_HALF):
+      return "xy_half";
+    case (JS_DATA_FORMAT_XY_QUARTER):
+      return "xy_quarter";
+    default:
+      return "invalid";
+  }
+}
+
+/**
+ * @brief A batch of profiles encoded as length prefixed data messages, the
+ * way they arrive on the data socket.
+ */
+class ProfileStream {
+ public:
+  typedef void (*PointFn)(uint32_t column, uint32_t columns, int16_t *x,
+                          int16_t *y, uint8_t *brightness);
+
+  ProfileStream(jsDataFormat format, uint32_t columns, uint32_t datagrams,
+                uint32_t num_profiles, PointFn point = SyntheticPoint)
+    : m_num_profiles(num_profiles),
+      m_valid_points(0),
+      m_timestamp_ns(0)
+  {
+    const uint16_t mask = FormatToMask(format);
+    const uint32_t stride = FormatToStride(format);
+    const uint32_t num_types = (mask & DataType::Brightness) ? 2 : 1;
+    const uint32_t total = columns / stride;
+    const uint32_t num_encoders = 1;
+
+    for (uint32_t c = 0; c < columns; c += stride) {
+      int16_t x = 0;
+      int16_t y = 0;
+      uint8_t brightness = 0;
+      point(c, columns, &x, &y, &brightness);
+      if (kInvalidXY != x) {
+        m_valid_points++;
+      }
+    }
+
+    DatagramHeader hdr;
+    hdr.magic = kDataMagic;
+    hdr.exposure_time_us = 500;
+    hdr.laser_on_time_us = 500;
+    hdr.data_type = mask;
+    hdr.number_encoders = num_encoders;
+    hdr.number_datagrams = datagrams;
+    hdr.start_column = 0;
+    hdr.end_column = static_cast<uint16_t>(columns - 1);
+
+    for (uint32_t p = 0; p < num_profiles; p++) {
+      hdr.sequence_number = p;
+
+      for (uint32_t pos = 0; pos < datagrams; pos++) {
+        uint32_t num_vals = columns / (datagrams * stride);
+        if ((total % datagrams) > pos) {
+          num_vals++;
+        }
+
+        std::vector<uint8_t> brightness_data;
+        std::vector<uint8_t> xy_data;
+        for (uint32_t n = 0; n < num_vals; n++) {
+          uint32_t col = (pos + n * datagrams) * stride;
+          int16_t x = 0;
+          int16_t y = 0;
+          uint8_t brightness = 0;
+          point(col, columns, &x, &y, &brightness);
+
+          brightness_data.push_back(brightness);
+          xy_data.push_back(static_cast<uint8_t>((x >> 8) & 0xFF));
+          xy_data.push_back(static_cast<uint8_t>(x & 0xFF));
+          xy_data.push_back(static_cast<uint8_t>((y >> 8) & 0xFF));
+          xy_data.push_back(static_cast<uint8_t>(y & 0xFF));
+        }
+
+        std::vector<uint8_t> data;
+        if (mask & DataType::Brightness) {
+          data.insert(data.end(), brightness_data.begin(),
+                      brightness_data.end());
+        }
+        data.insert(data.end(), xy_data.begin(), xy_data.end());
+
+        const uint32_t len = DatagramHeader::kSize + num_types * 2 +
+                             num_encoders * sizeof(int64_t) +
+                             static_cast<uint32_t>(data.size());
+        size_t offset = m_bytes.size();
+        m_bytes.resize(offset + sizeof(uint32_t) + len);
+        uint8_t *dst = &m_bytes[offset];
+
+        // messages are framed with their length, little-endian
+        memcpy(dst, &len, sizeof(uint32_t));
+        dst += sizeof(uint32_t);
+        m_messages.push_back(offset + sizeof(uint32_t));
+
+        hdr.data_length = static_cast<uint16_t>(data.size());
+        hdr.datagram_position = pos;
+        hdr.SerializeToBytes(dst);
+        dst += DatagramHeader::kSize;
+
+        for (uint32_t n = 0; n < num_types; n++) {
+          uint16_t step = htons(static_cast<uint16_t>(stride));
+          memcpy(dst, &step, sizeof(step));
+          dst += sizeof(step);
+        }
+
+        int64_t encoder = hostToNetwork<int64_t>(int64_t(p) * 100);
+        memcpy(dst, &encoder, sizeof(encoder));
+        dst += sizeof(encoder);
+
+        memcpy(dst, data.data(), data.size());
+      }
+    }
+
+    m_datagrams = datagrams;
+    NextTimestamps();
+  }
+
+  /**
+   * @brief Gives each profile of the batch a new timestamp, so that the
+   * batch can be sent again as new profiles.
+   */
+  void NextTimestamps()
+  {
+    for (uint32_t n = 0; n < m_messages.size(); n++) {
+      if (0 == (n % m_datagrams)) {
+        m_timestamp_ns += 1000000;
+      }
+
+      // timestamp is at byte offset 8 of the header
+      uint64_t ts = hostToNetwork<uint64_t>(m_timestamp_ns);
+      memcpy(&m_bytes[m_messages[n] + 8], &ts, sizeof(ts));
+    }
+  }
+
+  uint8_t *Data()
+  {
+    return m_bytes.data();
+  }
+
+  uint32_t Size() const
+  {
+    return static_cast<uint32_t>(m_bytes.size());
+  }
+
+  uint8_t *Message(uint32_t n, uint32_t *len)
+  {
+    const size_t offset = m_messages[n];
+    memcpy(len, &m_bytes[offset - sizeof(uint32_t)], sizeof(uint32_t));
+    return &m_bytes[offset];
+  }
+
+  uint32_t NumMessages() const
+  {
+    return static_cast<uint32_t>(m_messages.size());
+  }
+
+  uint32_t NumProfiles() const
+  {
+    return m_num_profiles;
+  }
+
+  // valid points in each profile
+  uint32_t ValidPoints() const
+  {
+    return m_valid_points;
+  }
+
+ private:
+  std::vector<uint8_t> m_bytes;
+  // byte offset of each message, past its length
+  std::vector<size_t> m_messages;
+  uint32_t m_num_profiles;
+  uint32_t m_datagrams;
+  uint32_t m_valid_points;
+  uint64_t m_timestamp_ns;
+};
+
+/**
+ * @brief Holds a scan head that is never connected, receiving data offline.
+ */
+class OfflineScanHead {
+ public:
+  OfflineScanHead(ScanManager &manager, uint32_t serial, uint32_t id)
+  {
+    jsDiscovered discovered;
+    memset(&discovered, 0, sizeof(discovered));
+    discovered.serial_number = serial;
+    discovered.type = JS_SCAN_HEAD_JS50WX;
+    discovered.firmware_version_major = API_VERSION_MAJOR;
+
+    m_scan_head.reset(new ScanHead(manager, discovered, id));
+  }
+
+  ScanHead *operator->()
+  {
+    return m_scan_head.get();
+  }
+
+  ScanHead *Get()
+  {
+    return m_scan_head.get();
+  }
+
+  /**
+   * @brief Hands all received profiles back to the scan head.
+   */
+  void Drain()
+  {
+    jsRawProfile *batch[kCopyBatchSize];
+    uint32_t n = 0;
+
+    while (0 != (n = m_scan_head->GetProfiles(batch, kCopyBatchSize))) {
+      m_scan_head->ReleaseProfiles(batch, n);
+    }
+  }
+
+ private:
+  std::unique_ptr<ScanHead> m_scan_head;
+};
+
+static bool IsSelected(const std::string &name, const std::string &filter)
+{
+  return filter.empty() || (std::string::npos != name.find(filter));
+}
+
+static void BenchDataPacket(uint64_t duration_ns, const std::string &filter)
+{
+  const std::string name = "DataPacket";
+  if (!IsSelected(name, filter)) {
+    return;
+  }
+
+  ProfileStream stream(JS_DATA_FORMAT_XY_BRIGHTNESS_FULL,
+                       JS_PROFILE_DATA_LEN, 4, 1);
+  Measurement m;
+  uint64_t sum = 0;
+
+  while (m.ns < duration_ns) {
+    const uint32_t iterations = 10000;
+    TimedSection t(m, iterations, 0);
+    for (uint32_t n = 0; n < iterations; n++) {
+      uint32_t len = 0;
+      uint8_t *msg = stream.Message(n % stream.NumMessages(), &len);
+      DataPacket packet(msg, len, 0);
+      sum += packet.GetPartNum() + packet.GetEncoderValues()[0] +
+             packet.GetFragmentLayout(DataType::XYData).offset;
+    }
+  }
+
+  _sink = sum;
+  PrintResult(name, m);
+}
+
+static void BenchProcessProfile(ScanManager &manager, jsDataFormat format,
+                                uint32_t datagrams, uint64_t duration_ns,
+                                const std::string &filter)
+{
+  const std::string name = std::string("ProcessProfile/") +
+                           FormatToString(format) + "/" +
+                           std::to_string(datagrams);
+  if (!IsSelected(name, filter)) {
+    return;
+  }
+
+  OfflineScanHead sh(manager, 1, 0);
+  sh->SetDataFormat(format);
+  sh->SetAlignment(2.5, 1.0, -0.5);
+  sh->StartScanningOffline();
+
+  ProfileStream stream(format, JS_PROFILE_DATA_LEN, datagrams,
+                       kProfilesPerBatch);
+  const uint64_t points =
+    uint64_t(stream.ValidPoints()) * stream.NumProfiles();
+  Measurement m;
+
+  while (m.ns < duration_ns) {
+    {
+      TimedSection t(m, stream.NumProfiles(), points);
+      sh->ReceiveData(stream.Data(), stream.Size());
+    }
+
+    sh.Drain();
+    stream.NextTimestamps();
+  }
+
+  sh->StopScanningOffline();
+  PrintResult(name, m);
+}
+
+static void BenchGetProfiles(ScanManager &manager, jsDataFormat format,
+                             uint64_t duration_ns, const std::string &filter)
+{
+  const std::string name =
+    std::string("GetProfiles/") + FormatToString(format);
+  if (!IsSelected(name, filter)) {
+    return;
+  }
+
+  OfflineScanHead sh(manager, 1, 0);
+  sh->SetDataFormat(format);
+  sh->StartScanningOffline();
+
+  ProfileStream stream(format, JS_PROFILE_DATA_LEN, 1, kProfilesPerBatch);
+  const uint64_t points =
+    uint64_t(stream.ValidPoints()) * stream.NumProfiles();
+  std::vector<jsProfile> profiles(kProfilesPerBatch);
+  Measurement m;
+
+  while (m.ns < duration_ns) {
+    sh->ReceiveData(stream.Data(), stream.Size());
+    stream.NextTimestamps();
+
+    // same as `jsScanHeadGetProfiles`
+    TimedSection t(m, stream.NumProfiles(), points);
+    jsRawProfile *batch[kCopyBatchSize];
+    uint32_t total = 0;
+    uint32_t n = 0;
+    while (0 != (n = sh->GetProfiles(batch, kCopyBatchSize))) {
+      for (uint32_t k = 0; k < n; k++) {
+        CopyProfileCompacted(batch[k], &profiles[total + k]);
+      }
+      sh->ReleaseProfiles(batch, n);
+      total += n;
+    }
+  }
+
+  _sink = profiles[0].data_len;
+  sh->StopScanningOffline();
+  PrintResult(name, m);
+}
+
+static void BenchCameraToMill(uint64_t duration_ns, const std::string &filter)
+{
+  const std::string name = "AlignmentParams::CameraToMill";
+  if (!IsSelected(name, filter)) {
+    return;
+  }
+
+  AlignmentParams alignment(1.0, 2.5, 1.0, -0.5);
+  std::vector<Point2D<int32_t>> points;
+  for (uint32_t c = 0; c < JS_PROFILE_DATA_LEN; c++) {
+    int16_t x = 0;
+    int16_t y = 0;
+    uint8_t brightness = 0;
+    SyntheticPoint(c, JS_PROFILE_DATA_LEN, &x, &y, &brightness);
+    points.push_back(Point2D<int32_t>(x, y));
+  }
+
+  Measurement m;
+  int64_t sum = 0;
+
+  while (m.ns < duration_ns) {
+    const uint32_t iterations = 100;
+    const uint64_t num = uint64_t(iterations) * points.size();
+    TimedSection t(m, num, num);
+    for (uint32_t n = 0; n < iterations; n++) {
+      for (auto const &p : points) {
+        Point2D<int32_t> q = alignment.CameraToMill(p);
+        sum += q.x + q.y;
+      }
+    }
+  }
+
+  _sink = static_cast<uint64_t>(sum);
+  PrintResult(name, m);
+}
+
+static void BenchPhaseTable(ScanManager &manager, uint32_t num_scan_heads,
+                            uint64_t duration_ns, const std::string &filter)
+{
+  const std::string name =
+    "PhaseTable::CalculatePhaseTable/" + std::to_string(num_scan_heads);
+  if (!IsSelected(name, filter)) {
+    return;
+  }
+
+  std::vector<std::unique_ptr<OfflineScanHead>> scan_heads;
+  for (uint32_t n = 0; n < num_scan_heads; n++) {
+    scan_heads.emplace_back(new OfflineScanHead(manager, n + 1, n));
+  }
+
+  // every scan head in every phase, alternating between its cameras, as many
+  // phases as a scan head allows
+  PhaseTable table;
+  const uint32_t num_phases = (*scan_heads[0])->GetMaxScanPairs();
+  for (uint32_t p = 0; p < num_phases; p++) {
+    table.CreatePhase();
+    for (auto &sh : scan_heads) {
+      jsCamera camera = (p % 2) ? JS_CAMERA_B : JS_CAMERA_A;
+      table.AddToLastPhaseEntry(sh->Get(), camera);
+    }
+  }
+
+  Measurement m;
+  uint64_t sum = 0;
+
+  while (m.ns < duration_ns) {
+    const uint32_t iterations = 10;
+    TimedSection t(m, iterations, 0);
+    for (uint32_t n = 0; n < iterations; n++) {
+      PhaseTableCalculated calculated = table.CalculatePhaseTable();
+      sum += calculated.total_duration_us;
+    }
+  }
+
+  _sink = sum;
+  PrintResult(name, m);
+}
+
+/**
+ * @brief An alignment to check, along with the kind of transform it should be
+ * classified as.
+ */
+struct CheckAlignment {
+  AlignmentType type;
+  double scale;
+  double roll;
+  double shift_x;
+  double shift_y;
+  jsCableOrientation cable;
+};
+
+static const char *AlignmentTypeToString(AlignmentType type)
+{
+  switch (type) {
+    case (AlignmentType::Identity):
+      return "identity";
+    case (AlignmentType::Shift):
+      return "shift";
+    case (AlignmentType::YawShift):
+      return "yaw_shift";
+    case (AlignmentType::General):
+      return "general";
+    default:
+      return "invalid";
+  }
+}
+
+static const char *KernelIsaToString(KernelIsa isa)
+{
+  switch (isa) {
+    case (KernelIsa::Scalar):
+      return "scalar";
+    case (KernelIsa::Sse41):
+      return "sse41";
+    case (KernelIsa::Avx2):
+      return "avx2";
+    default:
+      return "invalid";
+  }
+}
+
+/**
+ * @brief Alignments covering every kind of transform, with fixed cases for
+ * the edges and random shifts and rolls for the rest.
+ */
+static std::vector<CheckAlignment> CheckAlignments(std::mt19937 &rng)
+{
+  const jsCableOrientation down = JS_CABLE_ORIENTATION_DOWNSTREAM;
+  const jsCableOrientation up = JS_CABLE_ORIENTATION_UPSTREAM;
+  std::vector<CheckAlignment> alignments = {
+    {AlignmentType::Identity, 1.0, 0.0, 0.0, 0.0, down},
+    {AlignmentType::Shift, 1.0, 0.0, 2.5, -1.25, down},
+    {AlignmentType::Shift, 1.0, 0.0, 0.0123, -3.3337, down},
+    {AlignmentType::Shift, 1.0, 0.0, -0.0005, 0.0, down},
+    {AlignmentType::YawShift, 1.0, 0.0, 0.0, 0.0, up},
+    {AlignmentType::YawShift, 1.0, 0.0, 1.0, -0.5, up},
+    {AlignmentType::YawShift, 1.0, 0.0, -0.0123, 3.3337, up},
+    {AlignmentType::General, 1.0, 2.5, 1.0, -0.5, up},
+    {AlignmentType::General, 1.0, -45.0, 0.0, 0.0, down},
+    {AlignmentType::General, 25.4, 0.0, 0.0, 0.0, down},
+    {AlignmentType::General, 25.4, 180.0, -30.25, 12.7, up},
+  };
+
+  std::uniform_real_distribution<double> shift(-100.0, 100.0);
+  std::uniform_real_distribution<double> roll(-180.0, 180.0);
+  for (uint32_t n = 0; n < 8; n++) {
+    alignments.push_back({AlignmentType::Shift, 1.0, 0.0, shift(rng),
+                          shift(rng), down});
+    alignments.push_back({AlignmentType::YawShift, 1.0, 0.0, shift(rng),
+                          shift(rng), up});
+    alignments.push_back({AlignmentType::General, (n % 2) ? 25.4 : 1.0,
+                          roll(rng), shift(rng), shift(rng),
+                          (n % 4) ? up : down});
+  }
+
+  return alignments;
+}
+
+/**
+ * @brief Converts a point from camera to mill coordinates with double
+ * precision math, as the API did before switching to fixed point.
+ */
+static Point2D<int32_t> CameraToMillDouble(const CheckAlignment &a, int32_t x,
+                                           int32_t y)
+{
+  const double rho = kPi / 180.0;
+  const double yaw = (JS_CABLE_ORIENTATION_DOWNSTREAM == a.cable) ? 0.0 : 180.0;
+  const double cos_yaw = std::cos(yaw * rho);
+  const double sin_roll = std::sin(a.roll * rho);
+  const double cos_roll = std::cos(a.roll * rho);
+  const double xx = cos_yaw * cos_roll * a.scale;
+  const double xy = sin_roll * a.scale;
+  const double yx = cos_yaw * sin_roll * a.scale;
+  const double yy = cos_roll * a.scale;
+  const double xd = static_cast<double>(x);
+  const double yd = static_cast<double>(y);
+
+  double xm = (xd * xx) - (yd * xy) + (a.shift_x * 1000.0);
+  double ym = (xd * yx) + (yd * yy) + (a.shift_y * 1000.0);
+
+  return Point2D<int32_t>(static_cast<int32_t>(xm), static_cast<int32_t>(ym));
+}
+
+static bool PrintCheck(const std::string &name, uint64_t checked,
+                       uint64_t failures)
+{
+  if (0 == failures) {
+    printf("%-48s %12llu checked, ok\n", name.c_str(),
+           static_cast<unsigned long long>(checked));
+  } else {
+    printf("%-48s %12llu checked, %llu FAILED\n", name.c_str(),
+           static_cast<unsigned long long>(checked),
+           static_cast<unsigned long long>(failures));
+  }
+
+  return (0 == failures);
+}
+
+/**
+ * @brief Checks `AlignmentParams::CameraToMill` is within +/-1 of double
+ * precision math, across the whole range of values a scan head can send.
+ */
+static bool CheckCameraToMill(const std::vector<CheckAlignment> &alignments,
+                              std::mt19937 &rng)
+{
+  const AlignmentType types[] = {AlignmentType::Identity, AlignmentType::Shift,
+                                 AlignmentType::YawShift,
+                                 AlignmentType::General};
+  const int32_t edges[] = {-32767, -32766, -1001, -1000, -1, 0,
+                           1,      999,    1000,  32766, 32767};
+  std::uniform_int_distribution<int32_t> value(-32767, 32767);
+  bool is_ok = true;
+
+  for (auto type : types) {
+    uint64_t checked = 0;
+    uint64_t failures = 0;
+
+    for (auto const &a : alignments) {
+      if (type != a.type) {
+        continue;
+      }
+
+      AlignmentParams alignment(a.scale, a.roll, a.shift_x, a.shift_y,
+                                a.cable);
+      if (type != alignment.GetCameraToMillTransform().type) {
+        printf("alignment classified as %s, expected %s\n",
+               AlignmentTypeToString(alignment.GetCameraToMillTransform().type),
+               AlignmentTypeToString(type));
+        failures++;
+        continue;
+      }
+
+      std::vector<Point2D<int32_t>> points;
+      for (auto x : edges) {
+        for (auto y : edges) {
+          points.push_back(Point2D<int32_t>(x, y));
+        }
+      }
+      for (uint32_t n = 0; n < 100000; n++) {
+        points.push_back(Point2D<int32_t>(value(rng), value(rng)));
+      }
+
+      for (auto const &p : points) {
+        Point2D<int32_t> q = alignment.CameraToMill(p);
+        Point2D<int32_t> r = CameraToMillDouble(a, p.x, p.y);
+        checked++;
+
+        if ((1 < std::abs(q.x - r.x)) || (1 < std::abs(q.y - r.y))) {
+          if (0 == failures) {
+            printf("(%d, %d) converted to (%d, %d), expected (%d, %d)\n", p.x,
+                   p.y, q.x, q.y, r.x, r.y);
+          }
+          failures++;
+        }
+      }
+    }
+
+    std::string name = "CameraToMill/" + std::string(AlignmentTypeToString(type));
+    is_ok = PrintCheck(name, checked, failures) && is_ok;
+  }
+
+  return is_ok;
+}
+
+/**
+ * @brief Checks each `ProcessPointsXY` implementation supported by the CPU
+ * stores exactly what the plain C++ one does, for both destinations, and that
+ * the plain C++ one matches `AlignmentParams::CameraToMill`.
+ */
+static bool CheckProcessPointsXY(const std::vector<CheckAlignment> &alignments,
+                                 std::mt19937 &rng)
+{
+  // odd count so the implementations' handling of a partial block is checked
+  const uint32_t num = JS_PROFILE_DATA_LEN + 5;
+  const uint32_t incs[] = {1, 2};
+  const KernelIsa isas[] = {KernelIsa::Scalar, KernelIsa::Sse41,
+                            KernelIsa::Avx2};
+  const int16_t edges[] = {-32767, -32766, -1, 0, 1, 32766, 32767};
+  std::uniform_int_distribution<int32_t> value(-32767, 32767);
+  std::uniform_int_distribution<int32_t> byte(0, 255);
+  std::uniform_int_distribution<uint32_t> percent(0, 99);
+  bool is_ok = true;
+
+  // every few points invalid in X, Y or both, mixed among runs of valid ones
+  std::vector<uint8_t> xy(num * 4);
+  std::vector<uint8_t> brightness(num);
+  std::vector<Point2D<int32_t>> raw(num);
+  std::vector<bool> is_valid(num);
+  for (uint32_t n = 0; n < num; n++) {
+    int16_t x = (n < 49) ? edges[n % 7] : static_cast<int16_t>(value(rng));
+    int16_t y = (n < 49) ? edges[n / 7] : static_cast<int16_t>(value(rng));
+    uint32_t p = percent(rng);
+    if (10 > p) {
+      x = kInvalidXY;
+    } else if (15 > p) {
+      y = kInvalidXY;
+    } else if (20 > p) {
+      x = kInvalidXY;
+      y = kInvalidXY;
+    }
+
+    raw[n] = Point2D<int32_t>(x, y);
+    is_valid[n] = (kInvalidXY != x) && (kInvalidXY != y);
+    xy[n * 4 + 0] = static_cast<uint8_t>(static_cast<uint16_t>(x) >> 8);
+    xy[n * 4 + 1] = static_cast<uint8_t>(static_cast<uint16_t>(x) & 0xFF);
+    xy[n * 4 + 2] = static_cast<uint8_t>(static_cast<uint16_t>(y) >> 8);
+    xy[n * 4 + 3] = static_cast<uint8_t>(static_cast<uint16_t>(y) & 0xFF);
+    brightness[n] = static_cast<uint8_t>(byte(rng));
+  }
+
+  for (auto isa : isas) {
+    const std::string name =
+      std::string("ProcessPointsXY/") + KernelIsaToString(isa);
+    if (!IsKernelIsaSupported(isa)) {
+      printf("%-48s %12s\n", name.c_str(), "unsupported");
+      continue;
+    }
+
+    uint64_t checked = 0;
+    uint64_t failures = 0;
+
+    for (auto const &a : alignments) {
+      AlignmentParams alignment(a.scale, a.roll, a.shift_x, a.shift_y,
+                                a.cable);
+      const CameraToMillTransform &t = alignment.GetCameraToMillTransform();
+
+      for (auto inc : incs) {
+        for (uint32_t b = 0; b < 2; b++) {
+          const uint8_t *br = (0 == b) ? brightness.data() : nullptr;
+          const uint32_t len = num * inc;
+
+          // destinations start out filled the same for every implementation,
+          // so any point stored or skipped differently shows up
+          std::vector<jsProfileData> expected(len);
+          std::vector<jsProfileData> actual(len);
+          memset(expected.data(), 0x5A, len * sizeof(jsProfileData));
+          memset(actual.data(), 0x5A, len * sizeof(jsProfileData));
+          uint32_t expected_count = ProcessPointsXY(
+            KernelIsa::Scalar, xy.data(), br, num, t, expected.data(), inc);
+          uint32_t actual_count =
+            ProcessPointsXY(isa, xy.data(), br, num, t, actual.data(), inc);
+
+          std::vector<float> expected_x(len, 0.5f);
+          std::vector<float> expected_y(len, 0.5f);
+          std::vector<uint8_t> expected_b(len, 0x5A);
+          std::vector<float> actual_x(len, 0.5f);
+          std::vector<float> actual_y(len, 0.5f);
+          std::vector<uint8_t> actual_b(len, 0x5A);
+          uint32_t expected_arrays_count = ProcessPointsXY(
+            KernelIsa::Scalar, xy.data(), br, num, t, 0.001f,
+            expected_x.data(), expected_y.data(), expected_b.data(), inc);
+          uint32_t actual_arrays_count = ProcessPointsXY(
+            isa, xy.data(), br, num, t, 0.001f, actual_x.data(),
+            actual_y.data(), actual_b.data(), inc);
+
+          checked += num;
+          if ((expected_count != actual_count) ||
+              (expected_arrays_count != actual_arrays_count) ||
+              (0 != memcmp(expected.data(), actual.data(),
+                           len * sizeof(jsProfileData))) ||
+              (0 != memcmp(expected_x.data(), actual_x.data(),
+                           len * sizeof(float))) ||
+              (0 != memcmp(expected_y.data(), actual_y.data(),
+                           len * sizeof(float))) ||
+              (expected_b != actual_b)) {
+            failures++;
+          }
+
+          // only needs doing once, the others are checked against it
+          if (KernelIsa::Scalar != isa) {
+            continue;
+          }
+
+          for (uint32_t n = 0; n < num; n++) {
+            const jsProfileData &d = expected[n * inc];
+            const int32_t b_expected = ((nullptr == br) || (!is_valid[n]))
+                                         ? JS_PROFILE_DATA_INVALID_BRIGHTNESS
+                                         : brightness[n];
+
+            if (!is_valid[n]) {
+              // nothing may be left over from earlier use of the destination
+              if ((JS_PROFILE_DATA_INVALID_XY != d.x) ||
+                  (JS_PROFILE_DATA_INVALID_XY != d.y) ||
+                  (b_expected != d.brightness)) {
+                failures++;
+              }
+              continue;
+            }
+
+            Point2D<int32_t> p = alignment.CameraToMill(raw[n]);
+            if ((p.x != d.x) || (p.y != d.y) || (b_expected != d.brightness)) {
+              failures++;
+            }
+          }
+        }
+      }
+    }
+
+    is_ok = PrintCheck(name, checked, failures) && is_ok;
+  }
+
+  return is_ok;
+}
+
+/**
+ * @brief Checks profiles with a single valid point, assembled into pool
+ * storage that last held profiles full of valid points over a wider range of
+ * columns, hold only that point, for every data format, with and without
+ * compaction. Formats are run one after another on the same scan head so that
+ * storage last used with brightness is reused for formats without it.
+ */
+static bool CheckSparseProfiles(ScanManager &manager)
+{
+  const jsDataFormat formats[] = {
+    JS_DATA_FORMAT_XY_BRIGHTNESS_FULL, JS_DATA_FORMAT_XY_FULL,
+    JS_DATA_FORMAT_XY_BRIGHTNESS_HALF, JS_DATA_FORMAT_XY_HALF,
+    JS_DATA_FORMAT_XY_BRIGHTNESS_QUARTER, JS_DATA_FORMAT_XY_QUARTER};
+  const uint32_t datagram_counts[] = {1, 4};
+  const bool compactions[] = {false, true};
+  bool is_ok = true;
+
+  for (auto is_compact : compactions) {
+    manager.SetProfileCompaction(is_compact);
+    OfflineScanHead sh(manager, 1, 0);
+    jsScanHeadReceiveStatistics stats = sh->GetReceiveStatistics();
+    // enough profiles to cycle through every profile of the pool
+    const uint32_t batches =
+      (stats.profile_pool_capacity / kProfilesPerBatch) + 2;
+
+    for (auto format : formats) {
+      for (auto datagrams : datagram_counts) {
+        const std::string name = std::string("SparseProfile/") +
+                                 FormatToString(format) + "/" +
+                                 std::to_string(datagrams) +
+                                 (is_compact ? "/compact" : "");
+        const bool is_brightness =
+          (0 != (FormatToMask(format) & DataType::Brightness));
+        ProfileStream dense(format, JS_PROFILE_DATA_LEN, datagrams,
+                            kProfilesPerBatch, DensePoint);
+        ProfileStream sparse(format, kSparseColumns, datagrams,
+                             kProfilesPerBatch, SparsePoint);
+        jsRawProfile *batch[kCopyBatchSize];
+        uint64_t checked = 0;
+        uint64_t failures = 0;
+        uint32_t n = 0;
+
+        sh->SetDataFormat(format);
+        sh->StartScanningOffline();
+        for (uint32_t b = 0; b < batches; b++) {
+          sh->ReceiveData(dense.Data(), dense.Size());
+          dense.NextTimestamps();
+          sh.Drain();
+        }
+
+        // timestamps follow on from the dense profiles
+        for (uint32_t b = 0; b < batches + 1; b++) {
+          sparse.NextTimestamps();
+        }
+        sh->ReceiveData(sparse.Data(), sparse.Size());
+
+        while (0 != (n = sh->GetProfiles(batch, kCopyBatchSize))) {
+          for (uint32_t k = 0; k < n; k++) {
+            const jsRawProfile *raw = batch[k];
+            uint32_t valid = 0;
+            // uncompacted profiles always span the whole data array
+            bool is_expected =
+              is_compact || (JS_RAW_PROFILE_DATA_LEN == raw->data_len);
+
+            for (uint32_t c = 0; c < raw->data_len; c++) {
+              const jsProfileData &d = raw->data[c];
+              if ((JS_PROFILE_DATA_INVALID_XY == d.x) &&
+                  (JS_PROFILE_DATA_INVALID_XY == d.y)) {
+                is_expected = is_expected &&
+                              (JS_PROFILE_DATA_INVALID_BRIGHTNESS ==
+                               d.brightness);
+                continue;
+              }
+
+              int16_t x = 0;
+              int16_t y = 0;
+              uint8_t brightness = 0;
+              DensePoint(kSparseColumn, kSparseColumns, &x, &y, &brightness);
+              const int32_t b_expected =
+                is_brightness ? brightness : JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+              is_expected = is_expected && (b_expected == d.brightness) &&
+                            (is_compact || (kSparseColumn == c));
+              valid++;
+            }
+
+            jsProfile copy;
+            CopyProfileCompacted(raw, &copy);
+
+            checked++;
+            if ((!is_expected) || (1 != valid) || (1 != raw->data_valid_xy) ||
+                (1 != copy.data_len)) {
+              if (0 == failures) {
+                printf("profile has %u valid points, data_len %u, copied "
+                       "data_len %u\n",
+                       valid, raw->data_len, copy.data_len);
+              }
+              failures++;
+            }
+          }
+          sh->ReleaseProfiles(batch, n);
+        }
+
+        sh->StopScanningOffline();
+        is_ok = PrintCheck(name, checked, failures) && is_ok;
+      }
+    }
+  }
+
+  manager.SetProfileCompaction(false);
+  return is_ok;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t duration_ms = 500;
+  std::string filter;
+  bool is_check = false;
+
+  try {
+    cxxopts::Options options(argv[0], "Benchmarks API hot paths offline");
+
+    options.add_options()(
+      "t,time", "Time to run each benchmark in ms",
+      cxxopts::value<uint32_t>(duration_ms))(
+      "f,filter", "Only run benchmarks whose name contains this",
+      cxxopts::value<std::string>(filter))(
+      "c,check", "Check conversions are correct rather than benchmarking",
+      cxxopts::value<bool>(is_check))(
+      "h,help", "Print help");
+
+    auto parsed = options.parse(argc, argv);
+    if (parsed.count("help")) {
+      std::cout << options.help() << std::endl;
+      return 0;
+    }
+  } catch (const cxxopts::OptionException &e) {
+    std::cout << "error parsing options: " << e.what() << std::endl;
+    return 1;
+  }
+
+  if (is_check) {
+    // fixed seed so a failure can be reproduced
+    std::mt19937 rng(1);
+    std::vector<CheckAlignment> alignments = CheckAlignments(rng);
+    bool is_ok = CheckCameraToMill(alignments, rng);
+    is_ok = CheckProcessPointsXY(alignments, rng) && is_ok;
+
+    try {
+      ScanManager manager(JS_UNITS_INCHES);
+      is_ok = CheckSparseProfiles(manager) && is_ok;
+    } catch (std::exception &e) {
+      std::cout << "error: " << e.what() << std::endl;
+      return 1;
+    }
+
+    return is_ok ? 0 : 1;
+  }
+
+  const uint64_t duration_ns = uint64_t(duration_ms) * 1000000;
+  const jsDataFormat formats[] = {
+    JS_DATA_FORMAT_XY_BRIGHTNESS_FULL, JS_DATA_FORMAT_XY_BRIGHTNESS_HALF,
+    JS_DATA_FORMAT_XY_BRIGHTNESS_QUARTER, JS_DATA_FORMAT_XY_FULL,
+    JS_DATA_FORMAT_XY_HALF, JS_DATA_FORMAT_XY_QUARTER};
+  const uint32_t datagram_counts[] = {1, 2, 4, 8};
+  const uint32_t scan_head_counts[] = {8, 32, 128};
+
+  try {
+    ScanManager manager(JS_UNITS_INCHES);
+
+    PrintHeader();
+    BenchDataPacket(duration_ns, filter);
+    for (auto format : formats) {
+      for (auto datagrams : datagram_counts) {
+        BenchProcessProfile(manager, format, datagrams, duration_ns, filter);
+      }
+    }
+    for (auto format : formats) {
+      BenchGetProfiles(manager, format, duration_ns, filter);
+    }
+    BenchCameraToMill(duration_ns, filter);
+    for (auto num_scan_heads : scan_head_counts) {
+      BenchPhaseTable(manager, num_scan_heads, duration_ns, filter);
+    }
+  } catch (std::exception &e) {
+    std::cout << "error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
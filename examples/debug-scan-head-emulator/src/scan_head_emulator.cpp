@@ -0,0 +1,1127 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file scan_head_emulator.cpp
+ * @brief Emulates one or more JS-50 scan heads so that the API can be
+ * exercised and load tested without hardware. Each emulated scan head speaks
+ * the same protocol as the real one: it answers discovery broadcasts, accepts
+ * the control connection and streams synthetic profile data packets at the
+ * configured scan period.
+ *
+ * Each scan head listens on its own IP address. On Linux, any address in
+ * 127.0.0.0/8 can be used without further setup, but only addresses assigned
+ * to an interface are used by the API for discovery. To emulate 32 scan heads
+ * on one machine:
+ *
+ *   for n in $(seq 2 33); do sudo ip addr add 127.0.0.$n/8 dev lo; done
+ *   ./scan_head_emulator --ip 127.0.0.2 --count 32 --serial 90000
+ *
+ * Several emulator processes can be run side by side, each given different
+ * addresses and serial numbers; all of them answer discovery.
+ */
+
+#ifndef __linux__
+#error "the scan head emulator is only supported on Linux"
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// only the port definitions are needed, not the discovery client
+#define NO_PINCHOT_INTERFACE
+#include "BroadcastDiscover.hpp"
+#include "DatagramHeader.hpp"
+#include "NetworkTypes.hpp"
+#include "TcpSerializationHelpers.hpp"
+#include "Version.hpp"
+#include "joescan_pinchot.h"
+
+#include "MessageClient_generated.h"
+#include "MessageDiscoveryClient_generated.h"
+#include "MessageDiscoveryServer_generated.h"
+#include "MessageServer_generated.h"
+#include "ScanHeadSpecification_generated.h"
+#include "js50_spec_bin.h"
+
+#include "cxxopts.hpp"
+
+using namespace joescan;
+
+typedef schema::client::ScanHeadSpecificationT ScanHeadSpec;
+typedef schema::client::ScanConfigurationDataT ScanConfiguration;
+
+// server sends int16_t x/y data points; invalid is int16_t minimum
+static const int16_t kInvalidXY = -32768;
+// time to wait for the client to open the data connection after connecting
+static const int kDataConnectTimeoutMs = 5000;
+// how often blocking socket calls check if they should give up
+static const int kPollIntervalMs = 200;
+// the scan period is restarted instead of caught up if it falls this far
+// behind, such as when the client stops reading data
+static const uint64_t kMaxLagNs = 1000000000;
+
+static volatile std::sig_atomic_t _is_interrupted = 0;
+static const auto _epoch = std::chrono::steady_clock::now();
+
+static void SignalHandler(int sig)
+{
+  (void)sig;
+  _is_interrupted = 1;
+}
+
+/**
+ * @brief Time in nanoseconds since the emulator started, used as the global
+ * time of every emulated scan head.
+ */
+static uint64_t NowNs()
+{
+  auto elapsed = std::chrono::steady_clock::now() - _epoch;
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+static std::string IpToString(uint32_t ip)
+{
+  char str[INET_ADDRSTRLEN];
+  in_addr addr;
+  addr.s_addr = htonl(ip);
+  inet_ntop(AF_INET, &addr, str, sizeof(str));
+  return std::string(str);
+}
+
+/**
+ * @brief Opens a socket listening for TCP connections on a given address.
+ *
+ * @param ip The IP address to listen on, in host byte order.
+ * @param port The port to listen on.
+ * @return The listening socket, throws `std::runtime_error` on failure.
+ */
+static int ListenTCP(uint32_t ip, uint16_t port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (0 > fd) {
+    throw std::runtime_error(std::string("socket: ") + strerror(errno));
+  }
+
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(ip);
+  addr.sin_port = htons(port);
+
+  if ((0 != bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) ||
+      (0 != listen(fd, 1))) {
+    std::string e = "bind " + IpToString(ip) + ":" + std::to_string(port) +
+                    ": " + strerror(errno);
+    close(fd);
+    throw std::runtime_error(e);
+  }
+
+  return fd;
+}
+
+/**
+ * @brief Waits for a connection on a listening socket.
+ *
+ * @param fd The listening socket.
+ * @param timeout_ms Max time to wait for, or negative to wait until `keep`
+ * is cleared.
+ * @param keep Flag that is cleared to give up waiting.
+ * @return The connected socket, or negative value on timeout or failure.
+ */
+static int Accept(int fd, int timeout_ms, const std::atomic<bool> &keep)
+{
+  int waited_ms = 0;
+
+  while (keep && !_is_interrupted) {
+    pollfd pfd = {fd, POLLIN, 0};
+    int r = poll(&pfd, 1, kPollIntervalMs);
+    if (0 > r) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return -1;
+    } else if (0 < r) {
+      int conn = accept(fd, nullptr, nullptr);
+      if (0 <= conn) {
+        int one = 1;
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      }
+      return conn;
+    }
+
+    waited_ms += kPollIntervalMs;
+    if ((0 <= timeout_ms) && (waited_ms >= timeout_ms)) {
+      break;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * @brief Sends a whole buffer, waiting for room in the socket as needed.
+ *
+ * @param fd The connected socket.
+ * @param buf The bytes to send.
+ * @param len The number of bytes to send.
+ * @param keep Flag that is cleared to give up sending.
+ * @return Boolean `true` on success, `false` if the connection failed or
+ * sending was given up.
+ */
+static bool SendAll(int fd, const uint8_t *buf, size_t len,
+                    const std::atomic<bool> &keep)
+{
+  while ((0 != len) && keep) {
+    pollfd pfd = {fd, POLLOUT, 0};
+    int r = poll(&pfd, 1, kPollIntervalMs);
+    if (0 > r) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return false;
+    } else if (0 == r) {
+      // client isn't reading fast enough
+      continue;
+    }
+
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (0 > n) {
+      if ((EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno)) {
+        continue;
+      }
+      return false;
+    }
+
+    buf += n;
+    len -= static_cast<size_t>(n);
+  }
+
+  return (0 == len);
+}
+
+static bool RecvAll(int fd, uint8_t *buf, size_t len)
+{
+  while (0 != len) {
+    ssize_t n = recv(fd, buf, len, 0);
+    if (0 > n) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return false;
+    } else if (0 == n) {
+      // connection closed
+      return false;
+    }
+
+    buf += n;
+    len -= static_cast<size_t>(n);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Settings given on the command line that apply to every emulated
+ * scan head. Values left at zero follow what the client configures.
+ */
+struct EmulatorOptions {
+  schema::ScanHeadType type;
+  uint32_t period_us;
+  uint16_t data_type_mask;
+  uint32_t data_stride;
+  uint32_t datagrams;
+  uint32_t num_encoders;
+  int64_t encoder_ticks_per_s;
+  // time an object is in view and then out of view, zero if always in view
+  uint32_t presence_ms;
+};
+
+/**
+ * @brief Synthetic scan line seen by every camera: a curved surface spanning
+ * the camera's columns, like the top of a log.
+ */
+static void SyntheticPoint(uint32_t column, uint32_t columns, int16_t *x,
+                           int16_t *y, uint8_t *brightness)
+{
+  const double pi = 3.14159265358979323846;
+  double t = static_cast<double>(column) / columns;
+
+  *x = static_cast<int16_t>((static_cast<int32_t>(column) -
+                             static_cast<int32_t>(columns / 2)) * 20);
+  *y = static_cast<int16_t>(4000 + 6000 * std::sin(t * pi));
+  *brightness = static_cast<uint8_t>(80 + (column % 128));
+}
+
+/**
+ * @brief A camera and laser pair streamed while scanning along with the data
+ * of each of its datagrams, which never changes apart from the header.
+ */
+struct StreamPair {
+  uint8_t camera_port;
+  uint8_t laser_port;
+  uint16_t laser_on_time_us;
+  uint64_t end_offset_ns;
+  // data following the header of each datagram, with an object in view
+  std::vector<std::vector<uint8_t>> present;
+  // data following the header of each datagram, with nothing in view
+  std::vector<std::vector<uint8_t>> absent;
+};
+
+/**
+ * @brief The data format used while scanning, taken from the client's scan
+ * configuration and the emulator options.
+ */
+struct StreamFormat {
+  uint64_t period_ns;
+  uint16_t data_type_mask;
+  uint32_t stride;
+  uint32_t datagrams;
+  uint32_t num_encoders;
+  uint32_t columns;
+};
+
+class EmulatedScanHead {
+ public:
+  EmulatedScanHead(uint32_t serial, uint32_t ip, const EmulatorOptions &opts)
+    : m_opts(opts),
+      m_serial(serial),
+      m_ip(ip),
+      m_scan_head_id(0),
+      m_control_listen_fd(-1),
+      m_data_listen_fd(-1),
+      m_data_fd(-1),
+      m_is_running(false),
+      m_is_connected(false),
+      m_is_streaming(false),
+      m_profiles_sent(0),
+      m_packets_sent(0)
+  {
+    const unsigned char *bin = nullptr;
+    switch (opts.type) {
+      case (schema::ScanHeadType_JS50WSC):
+        bin = js50wsc_spec;
+        break;
+      case (schema::ScanHeadType_JS50X6B20):
+        bin = js50x6b20_spec;
+        break;
+      case (schema::ScanHeadType_JS50X6B30):
+        bin = js50x6b30_spec;
+        break;
+      case (schema::ScanHeadType_JS50WX):
+      default:
+        bin = js50wx_spec;
+        break;
+    }
+
+    schema::client::GetScanHeadSpecification(bin)->UnPackTo(&m_spec);
+  }
+
+  ~EmulatedScanHead()
+  {
+    Stop();
+  }
+
+  /**
+   * @brief Begins listening for the client on the scan head's address.
+   * Throws `std::runtime_error` if the ports can't be opened.
+   */
+  void Start()
+  {
+    m_control_listen_fd = ListenTCP(m_ip, kScanServerPort);
+    m_data_listen_fd = ListenTCP(m_ip, kScanServerStreamingTcpPort);
+    m_is_running = true;
+    m_control_thread = std::thread(&EmulatedScanHead::ControlMain, this);
+  }
+
+  void Stop()
+  {
+    if (!m_is_running) {
+      return;
+    }
+
+    m_is_running = false;
+    if (m_control_thread.joinable()) {
+      m_control_thread.join();
+    }
+
+    close(m_control_listen_fd);
+    close(m_data_listen_fd);
+  }
+
+  /**
+   * @brief Builds the reply to a discovery broadcast.
+   *
+   * @param builder The builder to hold the reply.
+   * @param client_ip The address the broadcast came from, in host byte order.
+   */
+  void BuildDiscoveryResponse(flatbuffers::FlatBufferBuilder &builder,
+                              uint32_t client_ip)
+  {
+    using namespace schema::server;
+
+    ScanHeadState state = m_is_streaming ? ScanHeadState_SCANNING :
+                          m_is_connected ? ScanHeadState_CONNECTED :
+                                           ScanHeadState_IDLE;
+
+    builder.Clear();
+    auto type_str = builder.CreateString(m_spec.product_str);
+    auto msg_offset = CreateMessageServerDiscovery(
+      builder, API_VERSION_MAJOR, API_VERSION_MINOR, API_VERSION_PATCH, 0, 0,
+      m_serial, m_opts.type, type_str, client_ip, m_ip, state);
+    builder.Finish(msg_offset);
+  }
+
+  uint32_t GetSerialNumber() const
+  {
+    return m_serial;
+  }
+
+  uint32_t GetIpAddress() const
+  {
+    return m_ip;
+  }
+
+  uint64_t GetProfilesSent() const
+  {
+    return m_profiles_sent;
+  }
+
+ private:
+  void ControlMain()
+  {
+    while (m_is_running && !_is_interrupted) {
+      int control_fd = Accept(m_control_listen_fd, -1, m_is_running);
+      if (0 > control_fd) {
+        continue;
+      }
+
+      // the client opens the data connection right after the control one
+      m_data_fd = Accept(m_data_listen_fd, kDataConnectTimeoutMs,
+                         m_is_running);
+      if (0 <= m_data_fd) {
+        m_is_connected = true;
+        Session(control_fd);
+        m_is_connected = false;
+        StopStreaming();
+        close(m_data_fd);
+        m_data_fd = -1;
+      }
+
+      close(control_fd);
+    }
+
+    StopStreaming();
+  }
+
+  /**
+   * @brief Handles control messages from a connected client until it
+   * disconnects or the emulator is stopped.
+   */
+  void Session(int control_fd)
+  {
+    std::vector<uint8_t> buf;
+
+    while (m_is_running && !_is_interrupted) {
+      pollfd pfd = {control_fd, POLLIN, 0};
+      int r = poll(&pfd, 1, kPollIntervalMs);
+      if (0 > r) {
+        if (EINTR == errno) {
+          continue;
+        }
+        return;
+      } else if (0 == r) {
+        continue;
+      }
+
+      // NOTE: message length is sent little-endian as to keep with approach
+      // used by Flatbuffers
+      uint32_t len = 0;
+      if (!RecvAll(control_fd, reinterpret_cast<uint8_t *>(&len),
+                   sizeof(len))) {
+        return;
+      }
+
+      buf.resize(len);
+      if ((0 != len) && !RecvAll(control_fd, &buf[0], len)) {
+        return;
+      }
+
+      auto verifier = flatbuffers::Verifier(buf.data(), len);
+      if (!schema::client::VerifyMessageClientBuffer(verifier)) {
+        std::cerr << m_serial << ": ignoring invalid message" << std::endl;
+        continue;
+      }
+
+      if (!HandleMessage(control_fd, buf.data())) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief Handles a single control message.
+   *
+   * @return Boolean `false` if the client disconnected.
+   */
+  bool HandleMessage(int control_fd, const uint8_t *buf)
+  {
+    using namespace schema::client;
+    auto msg = GetMessageClient(buf);
+
+    switch (msg->type()) {
+      case (MessageType_CONNECT): {
+        auto data = msg->data_as_ConnectData();
+        if (nullptr != data) {
+          m_scan_head_id = static_cast<uint8_t>(data->scan_head_id());
+          if (data->scan_head_serial() != m_serial) {
+            std::cerr << m_serial << ": client connected expecting serial "
+                      << data->scan_head_serial() << std::endl;
+          }
+        }
+        break;
+      }
+      case (MessageType_DISCONNECT):
+        return false;
+      case (MessageType_SCAN_CONFIGURATION): {
+        auto data = msg->data_as_ScanConfigurationData();
+        if (nullptr != data) {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_config.reset(data->UnPack());
+        }
+        break;
+      }
+      case (MessageType_WINDOW_CONFIGURATION):
+        // synthetic data ignores the scan window
+        break;
+      case (MessageType_SCAN_START):
+        StartStreaming();
+        break;
+      case (MessageType_SCAN_STOP):
+        StopStreaming();
+        break;
+      case (MessageType_STATUS_REQUEST):
+        return SendStatus(control_fd);
+      case (MessageType_KEEP_ALIVE):
+        break;
+      case (MessageType_IMAGE_REQUEST):
+        return SendImage(control_fd, msg->data_as_ImageRequestData());
+      case (MessageType_PROFILE_REQUEST):
+        return SendProfile(control_fd, msg->data_as_ProfileRequestData());
+      default:
+        break;
+    }
+
+    return true;
+  }
+
+  bool SendMessage(int fd, flatbuffers::FlatBufferBuilder &builder)
+  {
+    uint32_t len = builder.GetSize();
+    std::vector<uint8_t> buf(sizeof(len) + len);
+
+    // NOTE: sending little-endian as to keep with approach used by
+    // Flatbuffers; sent as one buffer since the client expects to read the
+    // message in one go
+    memcpy(&buf[0], &len, sizeof(len));
+    memcpy(&buf[sizeof(len)], builder.GetBufferPointer(), len);
+
+    return SendAll(fd, buf.data(), buf.size(), m_is_running);
+  }
+
+  int64_t EncoderValue(uint64_t timestamp_ns) const
+  {
+    return static_cast<int64_t>(static_cast<double>(timestamp_ns) * 1e-9 *
+                                m_opts.encoder_ticks_per_s);
+  }
+
+  bool IsObjectPresent(uint64_t timestamp_ns) const
+  {
+    if (0 == m_opts.presence_ms) {
+      return true;
+    }
+
+    return (0 == ((timestamp_ns / 1000000 / m_opts.presence_ms) % 2));
+  }
+
+  bool SendStatus(int fd)
+  {
+    using namespace schema::server;
+    const uint64_t now = NowNs();
+    StatusDataT data;
+
+    data.min_scan_period_ns = m_spec.min_scan_period_us * 1000;
+    data.global_time_ns = now;
+    data.num_packets_sent = static_cast<uint32_t>(m_packets_sent);
+    data.num_profiles_sent = static_cast<uint32_t>(m_profiles_sent);
+    for (uint32_t n = 0; n < m_opts.num_encoders; n++) {
+      data.encoders.push_back(EncoderValue(now));
+    }
+
+    const bool is_present = IsObjectPresent(now);
+    for (uint32_t port = 0; port < m_spec.number_of_cameras; port++) {
+      std::unique_ptr<CameraDataT> camera(new CameraDataT);
+      camera->port = port;
+      camera->pixels_in_window = is_present ? m_spec.max_camera_columns : 0;
+      camera->temperature = 40;
+      data.camera_data.push_back(std::move(camera));
+    }
+
+    flatbuffers::FlatBufferBuilder builder(512);
+    auto data_offset = StatusData::Pack(builder, &data);
+    auto msg_offset = CreateMessageServer(builder, MessageType_STATUS,
+                                          MessageData_StatusData,
+                                          data_offset.Union());
+    builder.Finish(msg_offset);
+
+    return SendMessage(fd, builder);
+  }
+
+  bool SendImage(int fd, const schema::client::ImageRequestData *req)
+  {
+    using namespace schema::server;
+    const uint64_t now = NowNs();
+    const uint32_t width = JS_CAMERA_IMAGE_DATA_MAX_WIDTH;
+    const uint32_t height = JS_CAMERA_IMAGE_DATA_MAX_HEIGHT;
+    ImageDataT data;
+
+    data.timestamp_ns = now;
+    if (nullptr != req) {
+      data.camera_port = req->camera_port();
+      data.laser_port = req->laser_port();
+      data.camera_exposure_ns = req->camera_exposure_ns();
+      data.laser_on_time_ns = req->laser_on_time_ns();
+    }
+    data.height = height;
+    data.width = width;
+    for (uint32_t n = 0; n < m_opts.num_encoders; n++) {
+      data.encoders.push_back(EncoderValue(now));
+    }
+
+    // dark image with the laser line drawn across it
+    data.pixels.assign(width * height, 8);
+    if (IsObjectPresent(now)) {
+      for (uint32_t col = 0; col < width; col++) {
+        int16_t x = 0;
+        int16_t y = 0;
+        uint8_t brightness = 0;
+        SyntheticPoint(col, width, &x, &y, &brightness);
+        uint32_t row = (static_cast<uint32_t>(y) * (height - 1)) / 10000;
+        data.pixels[row * width + col] = brightness;
+      }
+    }
+
+    flatbuffers::FlatBufferBuilder builder(width * height + 1024);
+    auto data_offset = ImageData::Pack(builder, &data);
+    auto msg_offset = CreateMessageServer(builder, MessageType_IMAGE,
+                                          MessageData_ImageData,
+                                          data_offset.Union());
+    builder.Finish(msg_offset);
+
+    return SendMessage(fd, builder);
+  }
+
+  bool SendProfile(int fd, const schema::client::ProfileRequestData *req)
+  {
+    using namespace schema::server;
+    const uint64_t now = NowNs();
+    const uint32_t columns = m_spec.max_camera_columns;
+    const bool is_present = IsObjectPresent(now);
+    ProfileDataT data;
+
+    data.timestamp_ns = now;
+    if (nullptr != req) {
+      data.camera_port = req->camera_port();
+      data.laser_port = req->laser_port();
+      data.camera_exposure_ns = req->camera_exposure_ns();
+      data.laser_on_time_ns = req->laser_on_time_ns();
+    }
+    for (uint32_t n = 0; n < m_opts.num_encoders; n++) {
+      data.encoders.push_back(EncoderValue(now));
+    }
+
+    for (uint32_t col = 0; col < columns; col++) {
+      int16_t x = kInvalidXY;
+      int16_t y = kInvalidXY;
+      uint8_t brightness = 0;
+      if (is_present) {
+        SyntheticPoint(col, columns, &x, &y, &brightness);
+        data.valid_points++;
+      }
+      data.points.push_back(ProfilePoint(x, y, brightness));
+    }
+
+    flatbuffers::FlatBufferBuilder builder(0x4000);
+    auto data_offset = ProfileData::Pack(builder, &data);
+    auto msg_offset = CreateMessageServer(builder, MessageType_PROFILE,
+                                          MessageData_ProfileData,
+                                          data_offset.Union());
+    builder.Finish(msg_offset);
+
+    return SendMessage(fd, builder);
+  }
+
+  /**
+   * @brief Gets the number of values of each data type a datagram holds, as
+   * the client computes it in `DataPacket`.
+   */
+  static uint32_t DatagramValues(const StreamFormat &fmt, uint32_t position)
+  {
+    const uint32_t total = fmt.columns / fmt.stride;
+    uint32_t num_vals = fmt.columns / (fmt.datagrams * fmt.stride);
+    if ((total % fmt.datagrams) > position) {
+      num_vals++;
+    }
+
+    return num_vals;
+  }
+
+  static std::vector<std::vector<uint8_t>> BuildDatagramData(
+    const StreamFormat &fmt, bool is_present)
+  {
+    std::vector<std::vector<uint8_t>> datagrams(fmt.datagrams);
+
+    for (uint32_t pos = 0; pos < fmt.datagrams; pos++) {
+      const uint32_t num_vals = DatagramValues(fmt, pos);
+      std::vector<uint8_t> brightness_data;
+      std::vector<uint8_t> xy_data;
+
+      for (uint32_t n = 0; n < num_vals; n++) {
+        // values are spread across datagrams so that losing one only lowers
+        // the resolution of the profile
+        uint32_t col = (pos + n * fmt.datagrams) * fmt.stride;
+        int16_t x = kInvalidXY;
+        int16_t y = kInvalidXY;
+        uint8_t brightness = 0;
+        if (is_present) {
+          SyntheticPoint(col, fmt.columns, &x, &y, &brightness);
+        }
+
+        brightness_data.push_back(brightness);
+        xy_data.push_back(static_cast<uint8_t>((x >> 8) & 0xFF));
+        xy_data.push_back(static_cast<uint8_t>(x & 0xFF));
+        xy_data.push_back(static_cast<uint8_t>((y >> 8) & 0xFF));
+        xy_data.push_back(static_cast<uint8_t>(y & 0xFF));
+      }
+
+      // data types are sent in order of their bit in the mask
+      std::vector<uint8_t> &dst = datagrams[pos];
+      if (fmt.data_type_mask & DataType::Brightness) {
+        dst.insert(dst.end(), brightness_data.begin(), brightness_data.end());
+      }
+      if (fmt.data_type_mask & DataType::XYData) {
+        dst.insert(dst.end(), xy_data.begin(), xy_data.end());
+      }
+    }
+
+    return datagrams;
+  }
+
+  void StartStreaming()
+  {
+    StopStreaming();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ((nullptr == m_config) ||
+        m_config->camera_laser_configurations.empty()) {
+      std::cerr << m_serial << ": scan started without a scan configuration"
+                << std::endl;
+      return;
+    }
+
+    StreamFormat fmt;
+    fmt.period_ns = (0 != m_opts.period_us) ?
+                    uint64_t(m_opts.period_us) * 1000 :
+                    m_config->scan_period_ns;
+    fmt.data_type_mask = (0 != m_opts.data_type_mask) ?
+                         m_opts.data_type_mask :
+                         static_cast<uint16_t>(m_config->data_type_mask);
+    fmt.data_type_mask &= (DataType::Brightness | DataType::XYData);
+    fmt.stride = (0 != m_opts.data_stride) ? m_opts.data_stride :
+                                             m_config->data_stride;
+    fmt.num_encoders = m_opts.num_encoders;
+    fmt.columns = m_spec.max_camera_columns;
+    if ((0 == fmt.period_ns) || (0 == fmt.stride) ||
+        (0 == (fmt.data_type_mask & DataType::XYData))) {
+      std::cerr << m_serial << ": unsupported scan configuration"
+                << std::endl;
+      return;
+    }
+
+    fmt.datagrams = m_opts.datagrams;
+    if (0 == fmt.datagrams) {
+      // split like the scan head, so each datagram fits an ethernet frame
+      const uint32_t num_types =
+        (fmt.data_type_mask & DataType::Brightness) ? 2 : 1;
+      const uint32_t overhead = DatagramHeader::kSize + num_types * 2 +
+                                fmt.num_encoders * sizeof(int64_t);
+      const uint32_t val_size = (2 == num_types) ? 5 : 4;
+      const uint32_t max_vals = (kMaxFramePayload - overhead) / val_size;
+      const uint32_t total = fmt.columns / fmt.stride;
+      fmt.datagrams = (total + max_vals - 1) / max_vals;
+    }
+
+    std::vector<StreamPair> pairs;
+    for (auto const &c : m_config->camera_laser_configurations) {
+      StreamPair pair;
+      pair.camera_port = static_cast<uint8_t>(c->camera_port);
+      pair.laser_port = static_cast<uint8_t>(c->laser_port);
+      pair.laser_on_time_us =
+        static_cast<uint16_t>(c->laser_on_time_def_ns / 1000);
+      pair.end_offset_ns = c->scan_end_offset_ns % fmt.period_ns;
+      pair.present = BuildDatagramData(fmt, true);
+      pair.absent = BuildDatagramData(fmt, false);
+      pairs.push_back(std::move(pair));
+    }
+
+    m_is_streaming = true;
+    m_stream_thread =
+      std::thread(&EmulatedScanHead::StreamMain, this, fmt, std::move(pairs));
+  }
+
+  void StopStreaming()
+  {
+    m_is_streaming = false;
+    if (m_stream_thread.joinable()) {
+      m_stream_thread.join();
+    }
+  }
+
+  /**
+   * @brief Sends a profile for every camera and laser pair each scan period
+   * until streaming is stopped.
+   */
+  void StreamMain(StreamFormat fmt, std::vector<StreamPair> pairs)
+  {
+    const uint32_t num_types =
+      (fmt.data_type_mask & DataType::Brightness) ? 2 : 1;
+    const uint32_t hdr_len = DatagramHeader::kSize + num_types * 2 +
+                             fmt.num_encoders * sizeof(int64_t);
+    std::vector<uint8_t> buf;
+    uint32_t sequence = 0;
+    uint64_t next_ns = NowNs();
+
+    while (m_is_streaming && !_is_interrupted) {
+      uint64_t now = NowNs();
+      if (now < next_ns) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(next_ns - now));
+      } else if ((now - next_ns) > kMaxLagNs) {
+        next_ns = now;
+      }
+
+      const uint64_t period_start_ns = next_ns;
+      const int64_t encoder = EncoderValue(period_start_ns);
+      const bool is_present = IsObjectPresent(period_start_ns);
+      next_ns += fmt.period_ns;
+      sequence++;
+
+      buf.clear();
+      for (auto const &pair : pairs) {
+        auto const &data = is_present ? pair.present : pair.absent;
+
+        DatagramHeader hdr;
+        hdr.magic = kDataMagic;
+        hdr.exposure_time_us = pair.laser_on_time_us;
+        hdr.scan_head_id = m_scan_head_id;
+        hdr.camera_port = pair.camera_port;
+        hdr.laser_port = pair.laser_port;
+        hdr.timestamp_ns = period_start_ns + pair.end_offset_ns;
+        hdr.laser_on_time_us = pair.laser_on_time_us;
+        hdr.data_type = fmt.data_type_mask;
+        hdr.number_encoders = static_cast<uint8_t>(fmt.num_encoders);
+        hdr.number_datagrams = fmt.datagrams;
+        hdr.start_column = 0;
+        hdr.end_column = static_cast<uint16_t>(fmt.columns - 1);
+        hdr.sequence_number = sequence;
+
+        for (uint32_t pos = 0; pos < fmt.datagrams; pos++) {
+          const uint32_t len = hdr_len + data[pos].size();
+          size_t offset = buf.size();
+          buf.resize(offset + sizeof(uint32_t) + len);
+          uint8_t *dst = &buf[offset];
+
+          // each datagram is framed with its length, little-endian
+          memcpy(dst, &len, sizeof(uint32_t));
+          dst += sizeof(uint32_t);
+
+          hdr.data_length = static_cast<uint16_t>(data[pos].size());
+          hdr.datagram_position = pos;
+          hdr.SerializeToBytes(dst);
+          dst += DatagramHeader::kSize;
+
+          // same step for every data type, in order of their bit
+          for (uint32_t n = 0; n < num_types; n++) {
+            uint16_t step = htons(static_cast<uint16_t>(fmt.stride));
+            memcpy(dst, &step, sizeof(step));
+            dst += sizeof(step);
+          }
+
+          for (uint32_t n = 0; n < fmt.num_encoders; n++) {
+            int64_t value = hostToNetwork<int64_t>(encoder);
+            memcpy(dst, &value, sizeof(value));
+            dst += sizeof(value);
+          }
+
+          memcpy(dst, data[pos].data(), data[pos].size());
+        }
+      }
+
+      if (!SendAll(m_data_fd, buf.data(), buf.size(), m_is_streaming)) {
+        break;
+      }
+
+      m_profiles_sent += pairs.size();
+      m_packets_sent += pairs.size() * fmt.datagrams;
+    }
+  }
+
+  EmulatorOptions m_opts;
+  ScanHeadSpec m_spec;
+  uint32_t m_serial;
+  uint32_t m_ip;
+  uint8_t m_scan_head_id;
+  int m_control_listen_fd;
+  int m_data_listen_fd;
+  int m_data_fd;
+  std::atomic<bool> m_is_running;
+  std::atomic<bool> m_is_connected;
+  std::atomic<bool> m_is_streaming;
+  std::atomic<uint64_t> m_profiles_sent;
+  std::atomic<uint64_t> m_packets_sent;
+  // guards the scan configuration
+  std::mutex m_mutex;
+  std::unique_ptr<ScanConfiguration> m_config;
+  std::thread m_control_thread;
+  std::thread m_stream_thread;
+};
+
+/**
+ * @brief Answers discovery broadcasts on behalf of every emulated scan head
+ * until the emulator is interrupted.
+ */
+static void DiscoveryMain(
+  std::vector<std::unique_ptr<EmulatedScanHead>> &scan_heads)
+{
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (0 > fd) {
+    std::cerr << "discovery disabled, socket: " << strerror(errno)
+              << std::endl;
+    return;
+  }
+
+  // every emulator process on the machine receives the broadcast
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(kBroadcastDiscoverPort);
+  if (0 != bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+    std::cerr << "discovery disabled, bind: " << strerror(errno) << std::endl;
+    close(fd);
+    return;
+  }
+
+  flatbuffers::FlatBufferBuilder builder(256);
+  uint8_t buf[256];
+
+  while (!_is_interrupted) {
+    pollfd pfd = {fd, POLLIN, 0};
+    if (0 >= poll(&pfd, 1, kPollIntervalMs)) {
+      continue;
+    }
+
+    sockaddr_in client;
+    socklen_t client_len = sizeof(client);
+    ssize_t r = recvfrom(fd, buf, sizeof(buf), 0,
+                         reinterpret_cast<sockaddr *>(&client), &client_len);
+    if (0 >= r) {
+      continue;
+    }
+
+    auto verifier = flatbuffers::Verifier(buf, static_cast<size_t>(r));
+    if (!schema::client::VerifyMessageClientDiscoveryBuffer(verifier)) {
+      continue;
+    }
+
+    const uint32_t client_ip = ntohl(client.sin_addr.s_addr);
+    for (auto &scan_head : scan_heads) {
+      scan_head->BuildDiscoveryResponse(builder, client_ip);
+      sendto(fd, builder.GetBufferPointer(), builder.GetSize(), 0,
+             reinterpret_cast<sockaddr *>(&client), client_len);
+    }
+  }
+
+  close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+  EmulatorOptions opts;
+  std::string ip_str = "127.0.0.2";
+  std::string type_str = "wx";
+  std::string format_str;
+  uint32_t count = 1;
+  uint32_t serial = 90000;
+  bool is_verbose = false;
+
+  opts.type = schema::ScanHeadType_JS50WX;
+  opts.period_us = 0;
+  opts.data_type_mask = 0;
+  opts.data_stride = 0;
+  opts.datagrams = 0;
+  opts.num_encoders = 1;
+  opts.encoder_ticks_per_s = 10000;
+  opts.presence_ms = 0;
+
+  try {
+    cxxopts::Options options(argv[0], "JS-50 scan head emulator");
+
+    options.add_options()(
+      "i,ip", "IP address of the first scan head",
+      cxxopts::value<std::string>(ip_str))(
+      "n,count", "Number of scan heads, on consecutive IP addresses",
+      cxxopts::value<uint32_t>(count))(
+      "s,serial", "Serial number of the first scan head",
+      cxxopts::value<uint32_t>(serial))(
+      "t,type", "wx, wsc, x6b20 or x6b30", cxxopts::value<std::string>(type_str))(
+      "p,period", "Scan period in us, overriding the client",
+      cxxopts::value<uint32_t>(opts.period_us))(
+      "f,format", "full, half, quarter, xy-full, xy-half or xy-quarter, "
+      "overriding the client", cxxopts::value<std::string>(format_str))(
+      "d,datagrams", "Datagrams per profile, 0 to fit ethernet frames",
+      cxxopts::value<uint32_t>(opts.datagrams))(
+      "e,encoders", "Number of encoder values sent",
+      cxxopts::value<uint32_t>(opts.num_encoders))(
+      "encoder-rate", "Encoder ticks per second",
+      cxxopts::value<int64_t>(opts.encoder_ticks_per_s))(
+      "presence", "ms an object is in then out of view, 0 for always",
+      cxxopts::value<uint32_t>(opts.presence_ms))(
+      "v,verbose", "Print profiles sent every second",
+      cxxopts::value<bool>(is_verbose))(
+      "h,help", "Print help");
+
+    auto parsed = options.parse(argc, argv);
+    if (parsed.count("help")) {
+      std::cout << options.help() << std::endl;
+      return 0;
+    }
+
+    if ("wx" == type_str) {
+      opts.type = schema::ScanHeadType_JS50WX;
+    } else if ("wsc" == type_str) {
+      opts.type = schema::ScanHeadType_JS50WSC;
+    } else if ("x6b20" == type_str) {
+      opts.type = schema::ScanHeadType_JS50X6B20;
+    } else if ("x6b30" == type_str) {
+      opts.type = schema::ScanHeadType_JS50X6B30;
+    } else {
+      std::cout << "invalid type: " << type_str << std::endl;
+      return 1;
+    }
+
+    if (!format_str.empty()) {
+      const bool is_xy_only = (0 == format_str.compare(0, 3, "xy-"));
+      const std::string stride_str =
+        is_xy_only ? format_str.substr(3) : format_str;
+
+      opts.data_type_mask = is_xy_only ?
+                            DataType::XYData :
+                            (DataType::XYData | DataType::Brightness);
+      if ("full" == stride_str) {
+        opts.data_stride = 1;
+      } else if ("half" == stride_str) {
+        opts.data_stride = 2;
+      } else if ("quarter" == stride_str) {
+        opts.data_stride = 4;
+      } else {
+        std::cout << "invalid format: " << format_str << std::endl;
+        return 1;
+      }
+    }
+
+    if (JS_ENCODER_MAX < opts.num_encoders) {
+      std::cout << "at most " << JS_ENCODER_MAX << " encoders" << std::endl;
+      return 1;
+    }
+  } catch (const cxxopts::OptionException &e) {
+    std::cout << "error parsing options: " << e.what() << std::endl;
+    return 1;
+  }
+
+  in_addr addr;
+  if (1 != inet_pton(AF_INET, ip_str.c_str(), &addr)) {
+    std::cout << "invalid IP address: " << ip_str << std::endl;
+    return 1;
+  }
+
+  std::signal(SIGINT, SignalHandler);
+  std::signal(SIGTERM, SignalHandler);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  std::vector<std::unique_ptr<EmulatedScanHead>> scan_heads;
+  try {
+    const uint32_t ip = ntohl(addr.s_addr);
+    for (uint32_t n = 0; n < count; n++) {
+      scan_heads.emplace_back(
+        new EmulatedScanHead(serial + n, ip + n, opts));
+      scan_heads.back()->Start();
+      std::cout << "scan head " << (serial + n) << " on "
+                << IpToString(ip + n) << std::endl;
+    }
+  } catch (const std::exception &e) {
+    std::cout << "failed to start: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::thread discovery_thread(DiscoveryMain, std::ref(scan_heads));
+
+  while (!_is_interrupted) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (is_verbose) {
+      for (auto const &scan_head : scan_heads) {
+        std::cout << scan_head->GetSerialNumber() << ": "
+                  << scan_head->GetProfilesSent() << " profiles sent"
+                  << std::endl;
+      }
+    }
+  }
+
+  discovery_thread.join();
+  for (auto &scan_head : scan_heads) {
+    scan_head->Stop();
+  }
+
+  return 0;
+}
@@ -18,8 +18,10 @@ AlignmentParams::AlignmentParams(double camera_to_mill_scale, double roll,
                                  m_roll(roll),
                                  m_camera_to_mill_scale(camera_to_mill_scale)
 {
-  SetShiftX(shift_x);
-  SetShiftY(shift_y);
+  m_shift_x = shift_x;
+  m_shift_x_1000 = shift_x * 1000.0;
+  m_shift_y = shift_y;
+  m_shift_y_1000 = shift_y * 1000.0;
   CalculateTransform();
 }
 
@@ -62,12 +64,19 @@ void AlignmentParams::SetShiftX(double shift_x)
 {
   m_shift_x = shift_x;
   m_shift_x_1000 = shift_x * 1000.0;
+  CalculateFixedPoint();
 }
 
 void AlignmentParams::SetShiftY(double shift_y)
 {
   m_shift_y = shift_y;
   m_shift_y_1000 = shift_y * 1000.0;
+  CalculateFixedPoint();
+}
+
+const CameraToMillTransform &AlignmentParams::GetCameraToMillTransform() const
+{
+  return m_camera_to_mill;
 }
 
 void AlignmentParams::CalculateTransform()
@@ -89,4 +98,46 @@ void AlignmentParams::CalculateTransform()
   m_mill_to_camera_xy = cos_neg_yaw * sin_neg_roll / m_camera_to_mill_scale;
   m_mill_to_camera_yx = sin_neg_roll / m_camera_to_mill_scale;
   m_mill_to_camera_yy = cos_neg_roll / m_camera_to_mill_scale;
+
+  CalculateFixedPoint();
+}
+
+void AlignmentParams::CalculateFixedPoint()
+{
+  CameraToMillTransform &t = m_camera_to_mill;
+  const double q24 = static_cast<double>(1 << t.kMatrixShift);
+  const double q16 = static_cast<double>(1 << t.kShiftFracBits);
+
+  t.xx = static_cast<int32_t>(std::llround(m_camera_to_mill_xx * q24));
+  t.xy = static_cast<int32_t>(std::llround(m_camera_to_mill_xy * q24));
+  t.yx = static_cast<int32_t>(std::llround(m_camera_to_mill_yx * q24));
+  t.yy = static_cast<int32_t>(std::llround(m_camera_to_mill_yy * q24));
+  t.shift_x = std::llround(m_shift_x_1000 * q24);
+  t.shift_y = std::llround(m_shift_y_1000 * q24);
+
+  // floor the Q16 value rather than truncate so the fraction is always added
+  const int64_t shift_x_q16 = std::llround(m_shift_x_1000 * q16);
+  const int64_t shift_y_q16 = std::llround(m_shift_y_1000 * q16);
+  const int64_t frac_mask = (1 << t.kShiftFracBits) - 1;
+  t.shift_x_whole = static_cast<int32_t>(
+    (shift_x_q16 - (shift_x_q16 & frac_mask)) / (frac_mask + 1));
+  t.shift_y_whole = static_cast<int32_t>(
+    (shift_y_q16 - (shift_y_q16 & frac_mask)) / (frac_mask + 1));
+  t.is_shift_x_frac = (0 != (shift_x_q16 & frac_mask));
+  t.is_shift_y_frac = (0 != (shift_y_q16 & frac_mask));
+
+  // only exact unit and zero values allow the matrix to be skipped; roll of
+  // zero with a scale of one is by far the most common alignment
+  const bool is_unit = (0.0 == m_camera_to_mill_xy) &&
+                       (0.0 == m_camera_to_mill_yx) &&
+                       (1.0 == m_camera_to_mill_yy);
+  const bool is_shifted = (0 != shift_x_q16) || (0 != shift_y_q16);
+
+  if (is_unit && (1.0 == m_camera_to_mill_xx)) {
+    t.type = is_shifted ? AlignmentType::Shift : AlignmentType::Identity;
+  } else if (is_unit && (-1.0 == m_camera_to_mill_xx)) {
+    t.type = AlignmentType::YawShift;
+  } else {
+    t.type = AlignmentType::General;
+  }
 }
@@ -13,6 +13,91 @@
 
 namespace joescan {
 
+/**
+ * @brief Classification of a camera to mill transform, allowing conversions
+ * to skip the work that has no effect on the result.
+ */
+enum class AlignmentType {
+  // points are unchanged
+  Identity,
+  // points are only shifted
+  Shift,
+  // X is mirrored, as for an upstream cable with no roll, then shifted
+  YawShift,
+  // full rotation, scale and shift
+  General,
+};
+
+/**
+ * @brief Fixed point form of the camera to mill coordinate transform. The
+ * matrix and shifts are held in Q24; for the add only alignment types, the
+ * shifts are also held in Q16 split into whole and fractional parts so the
+ * result can be truncated toward zero with integer math alone. Results are
+ * within +/-1 of converting with double precision math.
+ */
+struct CameraToMillTransform {
+  static const uint32_t kMatrixShift = 24;
+  static const uint32_t kShiftFracBits = 16;
+
+  AlignmentType type;
+  // NOTE: matrix values are limited to +/-128 to fit Q24 into 32 bits
+  int32_t xx;
+  int32_t xy;
+  int32_t yx;
+  int32_t yy;
+  int64_t shift_x;
+  int64_t shift_y;
+  // Q16 shift rounded down to a whole number
+  int32_t shift_x_whole;
+  int32_t shift_y_whole;
+  // set if the Q16 shift has a fractional part
+  bool is_shift_x_frac;
+  bool is_shift_y_frac;
+
+  /**
+   * Adds a shift split by whole and fractional part to a value, truncating
+   * toward zero as a conversion from floating point would.
+   */
+  static inline int32_t AddShift(int32_t v, int32_t whole, bool is_frac)
+  {
+    int32_t r = v + whole;
+    // the fraction pulls a negative result one closer to zero
+    return (is_frac && (0 > r)) ? r + 1 : r;
+  }
+
+  /**
+   * Divides a Q24 value, truncating toward zero.
+   */
+  static inline int32_t FromQ24(int64_t v)
+  {
+    return static_cast<int32_t>(v / (static_cast<int64_t>(1) << kMatrixShift));
+  }
+
+  inline Point2D<int32_t> Apply(int32_t x, int32_t y) const
+  {
+    switch (type) {
+      case AlignmentType::Identity:
+        return Point2D<int32_t>(x, y);
+      case AlignmentType::Shift:
+        return Point2D<int32_t>(AddShift(x, shift_x_whole, is_shift_x_frac),
+                                AddShift(y, shift_y_whole, is_shift_y_frac));
+      case AlignmentType::YawShift:
+        return Point2D<int32_t>(AddShift(-x, shift_x_whole, is_shift_x_frac),
+                                AddShift(y, shift_y_whole, is_shift_y_frac));
+      case AlignmentType::General:
+      default:
+        break;
+    }
+
+    int64_t xm = (static_cast<int64_t>(x) * xx) -
+                 (static_cast<int64_t>(y) * xy) + shift_x;
+    int64_t ym = (static_cast<int64_t>(x) * yx) +
+                 (static_cast<int64_t>(y) * yy) + shift_y;
+
+    return Point2D<int32_t>(FromQ24(xm), FromQ24(ym));
+  }
+};
+
 class AlignmentParams {
  public:
   /**
@@ -99,6 +184,13 @@ class AlignmentParams {
    */
   inline Point2D<int32_t> CameraToMill(int32_t x, int32_t y) const;
 
+  /**
+   * Obtain the fixed point transform used by `CameraToMill`.
+   *
+   * @return The camera to mill transform.
+   */
+  const CameraToMillTransform &GetCameraToMillTransform() const;
+
   /**
    * Convert XY profile data from mill coordinates to camera coordinates.
    *
@@ -118,7 +210,9 @@ class AlignmentParams {
 
  private:
   void CalculateTransform();
+  void CalculateFixedPoint();
 
+  CameraToMillTransform m_camera_to_mill;
   jsCableOrientation m_cable;
   double m_roll;
   double m_shift_x;
@@ -147,22 +241,7 @@ inline Point2D<int32_t> AlignmentParams::CameraToMill(Point2D<int32_t> p) const
 inline Point2D<int32_t> AlignmentParams::CameraToMill(int32_t x,
                                                       int32_t y) const
 {
-  // static cast int32_t fields to doubles before doing our math
-  double xd = static_cast<double>(x);
-  double yd = static_cast<double>(y);
-
-  // now calculate the mill values for both X and Y
-  double xm = (xd * m_camera_to_mill_xx) - (yd * m_camera_to_mill_xy) +
-              m_shift_x_1000;
-
-  double ym = (xd * m_camera_to_mill_yx) + (yd * m_camera_to_mill_yy) +
-              m_shift_y_1000;
-
-  // now convert back to int32_t values
-  int32_t xi = static_cast<int32_t>(xm);
-  int32_t yi = static_cast<int32_t>(ym);
-
-  return Point2D<int32_t>(xi, yi);
+  return m_camera_to_mill.Apply(x, y);
 }
 
 inline Point2D<int32_t> AlignmentParams::MillToCamera(Point2D<int32_t> p) const
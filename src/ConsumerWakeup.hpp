@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_CONSUMER_WAKEUP_H
+#define JOESCAN_CONSUMER_WAKEUP_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+
+namespace joescan {
+
+/**
+ * @brief The `ConsumerWakeup` class lets a consumer thread block until a
+ * producer has made enough data available. Unlike a bare condition variable,
+ * the producer side is a couple of atomic operations unless a consumer is
+ * actually parked, so producers never take a lock in the common case. Any
+ * number of consumers may wait at once, each for its own count.
+ */
+class ConsumerWakeup {
+ public:
+  ConsumerWakeup() : m_parked(0), m_count(UINT32_MAX)
+  {
+  }
+
+  /**
+   * Blocks the calling thread until `available` reports at least `count`
+   * elements or the timeout expires.
+   *
+   * @param count The number of elements to wait for.
+   * @param available Function returning the number of elements available.
+   * @param timeout_us The max time to wait for in microseconds.
+   * @return The number of elements available when the wait finished.
+   */
+  template <typename Fn>
+  uint32_t WaitFor(uint32_t count, Fn available, uint32_t timeout_us)
+  {
+    uint32_t n = available();
+    if (n >= count) {
+      return n;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::microseconds(timeout_us);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // the producer wakes everyone once the smallest count parked is reached;
+    // it must be visible before the producer can observe a parked consumer
+    auto iter = m_counts.insert(count);
+    m_count.store(*m_counts.begin(), std::memory_order_seq_cst);
+    m_parked.fetch_add(1, std::memory_order_seq_cst);
+
+    while ((n = available()) < count) {
+      if (std::cv_status::timeout == m_cv.wait_until(lock, deadline)) {
+        n = available();
+        break;
+      }
+    }
+
+    m_parked.fetch_sub(1, std::memory_order_seq_cst);
+    m_counts.erase(iter);
+    m_count.store(m_counts.empty() ? UINT32_MAX : *m_counts.begin(),
+                  std::memory_order_seq_cst);
+
+    return n;
+  }
+
+  /**
+   * Wakes up any consumer parked in `WaitFor` if enough elements are now
+   * available. Must be called by the producer after publishing new elements.
+   *
+   * @param available Function returning the number of elements available;
+   * only called if a consumer is parked.
+   */
+  template <typename Fn>
+  void Notify(Fn available)
+  {
+    // pairs with the parked counter increment in `WaitFor`; either we see the
+    // parked consumer or it sees the newly published elements
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (0 == m_parked.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    if (available() < m_count.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    {
+      // taking the lock guarantees the consumer is either waiting on the
+      // condition variable or has yet to check the available count
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_cv.notify_all();
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  // counts waited for by the parked consumers, guarded by `m_mutex`
+  std::multiset<uint32_t> m_counts;
+  std::atomic<uint32_t> m_parked;
+  // smallest of `m_counts`, read by the producer without the lock
+  std::atomic<uint32_t> m_count;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_CONSUMER_WAKEUP_H
@@ -5,10 +5,6 @@
  * root for license information.
  */
 
-#include <bitset>
-#include <map>
-#include <stdexcept>
-
 #include "DataPacket.hpp"
 #include "TcpSerializationHelpers.hpp"
 
@@ -51,45 +47,54 @@ DataPacket::DataPacket(uint8_t *bytes, uint32_t num_bytes,
   m_hdr.end_column = ntohs(pu16[17]);
   m_hdr.sequence_number = ntohl(pu32[9]);
 
-  std::bitset<8 * sizeof(uint16_t)> contents_bits(m_hdr.data_type);
-  m_num_content_types = static_cast<int>(contents_bits.count());
+  m_num_content_types = 0;
+  for (uint32_t bits = m_hdr.data_type; 0 != bits; bits &= bits - 1) {
+    m_num_content_types++;
+  }
 
   unsigned int offset = DatagramHeader::kSize;
   const uint32_t encoder_offset = offset + (m_num_content_types * 2);
   unsigned int data_offset = encoder_offset + (m_hdr.number_encoders * 8);
 
+  // never trust the wire to stay within the bounds of the encoder array
+  m_num_encoders = m_hdr.number_encoders;
+  if (JS_ENCODER_MAX < m_num_encoders) {
+    m_num_encoders = JS_ENCODER_MAX;
+  }
+
   int64_t *p_enc = reinterpret_cast<int64_t *>(&bytes[encoder_offset]);
-  for (uint32_t i = 0; i < m_hdr.number_encoders; i++) {
-    m_encoders.push_back(hostToNetwork<int64_t>(*p_enc++));
+  for (uint32_t i = 0; i < m_num_encoders; i++) {
+    m_encoders[i] = hostToNetwork<int64_t>(*p_enc++);
   }
 
-  for (int i = 1; i <= m_hdr.data_type; i <<= 1) {
-    if ((m_hdr.data_type & i) != 0) {
-      FragmentLayout layout;
-      DataType data_type = static_cast<DataType>(i);
-      layout.step = ntohs(*(reinterpret_cast<uint16_t *>(&bytes[offset])));
-      layout.offset = data_offset;
-
-      // All processed data types are sent in datagrams which must fit within
-      // an ethernet frame. If multiple datagrams are required for a profile,
-      // the data will be distributed among the datagrams such that if we
-      // lose a datagram, we lose resolution, but won't have large holes in
-      // the data.
-      auto num_cols = m_hdr.end_column - m_hdr.start_column + 1;
-      layout.num_vals = num_cols / (m_hdr.number_datagrams * layout.step);
-      // If the data doesn't divide evenly into the DataPackets, each
-      // DataPacket starting from the first will have 1 additional value of
-      // the type in question.
-      if (((num_cols / layout.step) % m_hdr.number_datagrams) >
-          m_hdr.datagram_position) {
-        layout.num_vals++;
-      }
-      layout.payload_size = GetSizeFor(data_type) * layout.num_vals;
-
-      data_offset += layout.payload_size;
-      offset += sizeof(uint16_t);
-      fragment_layouts[data_type] = layout;
+  const uint32_t num_cols = m_hdr.end_column - m_hdr.start_column + 1;
+  for (uint32_t n = 0; n < kMaxDataTypes; n++) {
+    DataType data_type = static_cast<DataType>(1 << n);
+    if (0 == (m_hdr.data_type & data_type)) {
+      continue;
     }
+
+    FragmentLayout &layout = m_layouts[n];
+    layout.step = ntohs(*(reinterpret_cast<uint16_t *>(&bytes[offset])));
+    layout.offset = data_offset;
+
+    // All processed data types are sent in datagrams which must fit within
+    // an ethernet frame. If multiple datagrams are required for a profile,
+    // the data will be distributed among the datagrams such that if we
+    // lose a datagram, we lose resolution, but won't have large holes in
+    // the data.
+    layout.num_vals = num_cols / (m_hdr.number_datagrams * layout.step);
+    // If the data doesn't divide evenly into the DataPackets, each
+    // DataPacket starting from the first will have 1 additional value of
+    // the type in question.
+    if (((num_cols / layout.step) % m_hdr.number_datagrams) >
+        m_hdr.datagram_position) {
+      layout.num_vals++;
+    }
+    layout.payload_size = GetSizeFor(data_type) * layout.num_vals;
+
+    data_offset += layout.payload_size;
+    offset += sizeof(uint16_t);
   }
 }
 
@@ -141,7 +146,7 @@ int DataPacket::GetPayloadLength() const
 
 uint8_t DataPacket::NumEncoderVals() const
 {
-  return m_hdr.number_encoders;
+  return static_cast<uint8_t>(m_num_encoders);
 }
 
 uint16_t DataPacket::GetContents() const
@@ -154,7 +159,7 @@ int DataPacket::GetNumContentTypes() const
   return m_num_content_types;
 }
 
-std::vector<int64_t> DataPacket::GetEncoderValues() const
+const int64_t *DataPacket::GetEncoderValues() const
 {
   return m_encoders;
 }
@@ -8,23 +8,33 @@
 #ifndef JOESCAN_DATA_PACKET_H
 #define JOESCAN_DATA_PACKET_H
 
-#include <map>
-#include <memory>
-#include <vector>
+#include <cstdint>
 
 #include "NetworkTypes.hpp"
 #include "joescan_pinchot.h"
 
 namespace joescan {
+// NOTE: no default member initializers so arrays of layouts stay trivially
+// constructible; use `FragmentLayout()` to get a zeroed layout
 struct FragmentLayout {
-  unsigned int step = 0;
-  unsigned int num_vals = 0;
-  unsigned int offset = 0;
-  unsigned int payload_size = 0;
+  unsigned int step;
+  unsigned int num_vals;
+  unsigned int offset;
+  unsigned int payload_size;
 };
 
+/**
+ * @brief The `DataPacket` class is a view over the raw bytes of a profile
+ * data message received from a scan head. The header is decoded up front along
+ * with the location of each data type within the message; no memory is
+ * allocated and the bytes themselves are not copied, so they must outlive the
+ * `DataPacket` object.
+ */
 class DataPacket {
  public:
+  // one layout per bit of the `DataType` bit field
+  static const uint32_t kMaxDataTypes = 8 * sizeof(uint16_t);
+
   DataPacket() = default;
   DataPacket(uint8_t *bytes, uint32_t num_bytes, uint64_t received_timestamp);
   DataPacket(const DataPacket &other) = default;
@@ -62,7 +72,13 @@ class DataPacket {
   inline uint16_t GetStartColumn() const;
   inline uint16_t GetEndColumn() const;
 
-  std::vector<int64_t> GetEncoderValues() const;
+  /**
+   * Gets the encoder values sent with the packet. The number of values is
+   * given by `NumEncoderVals`.
+   *
+   * @return Pointer to the encoder values.
+   */
+  const int64_t *GetEncoderValues() const;
   uint16_t GetLaserOnTime() const;
   uint16_t GetExposureTime() const;
 
@@ -70,24 +86,42 @@ class DataPacket {
   uint8_t *GetRawBytes(uint32_t *byte_len) const;
 
  private:
-  std::map<DataType, FragmentLayout> fragment_layouts;
+  static inline uint32_t DataTypeToIndex(DataType type);
+
+  // only entries for data types set in `m_hdr.data_type` are initialized
+  FragmentLayout m_layouts[kMaxDataTypes];
   DatagramHeader m_hdr;
   uint8_t *m_raw;
   uint32_t m_raw_len;
   int m_num_content_types;
-  std::vector<int64_t> m_encoders;
+  // number of encoder values, limited to what `m_encoders` can hold
+  uint32_t m_num_encoders;
+  int64_t m_encoders[JS_ENCODER_MAX];
 
   friend struct ProfileBuilder;
+  friend struct ProfileSoABuilder;
 };
 
+inline uint32_t DataPacket::DataTypeToIndex(DataType type)
+{
+  // callers pass a single known type, so this folds to a constant
+  uint32_t idx = 0;
+  uint32_t bits = static_cast<uint32_t>(type);
+  while (1 < bits) {
+    bits >>= 1;
+    idx++;
+  }
+
+  return idx;
+}
+
 inline FragmentLayout DataPacket::GetFragmentLayout(DataType type) const
 {
-  auto iter = fragment_layouts.find(type);
-  if (iter != fragment_layouts.end()) {
-    return iter->second;
+  if (0 == (m_hdr.data_type & type)) {
+    return FragmentLayout();
   }
 
-  return FragmentLayout();
+  return m_layouts[DataTypeToIndex(type)];
 }
 
 inline uint16_t DataPacket::GetStartColumn() const
@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "FrameAssembler.hpp"
+#include "ScanHead.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace joescan;
+
+FrameAssembler::FrameAssembler()
+  : m_timeout(0),
+    m_window_ns(0),
+    m_last_sequence(0),
+    m_is_last_sequence_valid(false)
+{
+}
+
+FrameAssembler::~FrameAssembler()
+{
+  Clear();
+}
+
+std::vector<FrameAssembler::Element>
+FrameAssembler::GetElements(PhaseTableCalculated &table)
+{
+  std::vector<Element> elements;
+
+  for (auto &phase : table.phases) {
+    for (auto &el : phase.elements) {
+      Element element;
+      element.scan_head = el.scan_head;
+      element.scan_head_id = el.scan_head->GetId();
+      element.camera = el.camera;
+      element.laser = el.laser;
+
+      bool is_listed = false;
+      for (auto const &listed : elements) {
+        if ((listed.scan_head == element.scan_head) &&
+            (listed.camera == element.camera) &&
+            (listed.laser == element.laser)) {
+          is_listed = true;
+          break;
+        }
+      }
+
+      if (!is_listed) {
+        elements.push_back(element);
+      }
+    }
+  }
+
+  return elements;
+}
+
+void FrameAssembler::Configure(const std::vector<Element> &elements,
+                               uint32_t period_us, uint32_t timeout_us)
+{
+  Clear();
+
+  m_elements = elements;
+  m_element_index.clear();
+  m_scan_heads.clear();
+  // frame size may have changed, spare profile arrays are of the old size
+  m_spare.clear();
+
+  for (uint32_t n = 0; n < m_elements.size(); n++) {
+    Element &el = m_elements[n];
+    m_element_index[ElementKey(el.scan_head_id, el.camera, el.laser)] = n;
+    m_scan_heads[el.scan_head_id] = el.scan_head;
+  }
+
+  m_timeout = std::chrono::microseconds(timeout_us);
+  m_window_ns = static_cast<uint64_t>(period_us) * 1000;
+}
+
+uint32_t FrameAssembler::GetFrameSize() const
+{
+  return static_cast<uint32_t>(m_elements.size());
+}
+
+uint32_t FrameAssembler::Poll()
+{
+  auto now = std::chrono::steady_clock::now();
+  jsRawProfile *batch[kDrainBatchSize];
+
+  // only take what is queued now so a fast producer can't keep us here
+  uint32_t remaining = AvailableProfiles();
+  while (0 != remaining) {
+    uint32_t total = 0;
+
+    for (auto const &pair : m_scan_heads) {
+      uint32_t n = pair.second->GetProfiles(batch, kDrainBatchSize);
+      for (uint32_t m = 0; m < n; m++) {
+        Add(batch[m], now);
+      }
+      total += n;
+    }
+
+    if (0 == total) {
+      break;
+    }
+    remaining = (total < remaining) ? remaining - total : 0;
+  }
+
+  // frames are handed out in order, a frame finished ahead of an older one
+  // waits until the older one completes or times out
+  const uint32_t frame_size = GetFrameSize();
+  while (!m_pending.empty()) {
+    Frame &frame = m_pending.front();
+    if ((frame_size != frame.received) && (now < frame.deadline)) {
+      break;
+    }
+
+    FinishOldest();
+  }
+
+  return static_cast<uint32_t>(m_ready.size());
+}
+
+uint32_t FrameAssembler::AvailableProfiles() const
+{
+  uint32_t total = 0;
+
+  for (auto const &pair : m_scan_heads) {
+    total += pair.second->AvailableProfiles();
+  }
+
+  return total;
+}
+
+std::chrono::steady_clock::time_point FrameAssembler::GetDeadline() const
+{
+  if (m_pending.empty()) {
+    return std::chrono::steady_clock::time_point::max();
+  }
+
+  return m_pending.front().deadline;
+}
+
+bool FrameAssembler::Pop(jsFrameInfo *info, jsRawProfile **profiles)
+{
+  if (m_ready.empty()) {
+    return false;
+  }
+
+  Frame &frame = m_ready.front();
+  const uint32_t frame_size = static_cast<uint32_t>(frame.profiles.size());
+  for (uint32_t n = 0; n < frame_size; n++) {
+    profiles[n] = frame.profiles[n];
+  }
+
+  info->timestamp_ns = frame.timestamp_ns;
+  info->sequence_number = frame.sequence_number;
+  info->num_profiles = frame_size;
+  info->num_missing = frame_size - frame.received;
+
+  Recycle(frame);
+  m_ready.pop_front();
+
+  return true;
+}
+
+int FrameAssembler::Release(jsRawProfile **profiles, uint32_t count)
+{
+  for (uint32_t n = 0; n < count; n++) {
+    if ((nullptr != profiles[n]) &&
+        (m_scan_heads.end() == m_scan_heads.find(profiles[n]->scan_head_id))) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+  }
+
+  int r = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    if (nullptr == profiles[n]) {
+      continue;
+    }
+
+    ScanHead *scan_head = m_scan_heads[profiles[n]->scan_head_id];
+    if (0 != scan_head->ReleaseProfiles(&profiles[n], 1)) {
+      r = JS_ERROR_INVALID_ARGUMENT;
+    }
+  }
+
+  return r;
+}
+
+void FrameAssembler::Clear()
+{
+  for (auto &frame : m_pending) {
+    uint32_t len = static_cast<uint32_t>(frame.profiles.size());
+    Release(frame.profiles.data(), len);
+    Recycle(frame);
+  }
+  m_pending.clear();
+
+  for (auto &frame : m_ready) {
+    uint32_t len = static_cast<uint32_t>(frame.profiles.size());
+    Release(frame.profiles.data(), len);
+    Recycle(frame);
+  }
+  m_ready.clear();
+
+  m_is_last_sequence_valid = false;
+}
+
+void FrameAssembler::Add(jsRawProfile *profile,
+                         std::chrono::steady_clock::time_point now)
+{
+  ElementKey key(profile->scan_head_id, profile->camera, profile->laser);
+  auto iter = m_element_index.find(key);
+  if (m_element_index.end() == iter) {
+    // not scanned as part of the phase table
+    Drop(profile);
+    return;
+  }
+
+  const uint32_t idx = iter->second;
+  const uint32_t sequence = profile->sequence_number;
+  const uint64_t timestamp = profile->timestamp_ns;
+
+  for (auto &frame : m_pending) {
+    if (sequence != frame.sequence_number) {
+      continue;
+    }
+
+    uint64_t delta = (timestamp > frame.timestamp_ns) ?
+                     timestamp - frame.timestamp_ns :
+                     frame.timestamp_ns - timestamp;
+    if (delta >= m_window_ns) {
+      continue;
+    }
+
+    if (nullptr != frame.profiles[idx]) {
+      // element already has a profile for this frame
+      Drop(profile);
+      return;
+    }
+
+    frame.profiles[idx] = profile;
+    frame.received++;
+    if (timestamp < frame.timestamp_ns) {
+      frame.timestamp_ns = timestamp;
+    }
+    return;
+  }
+
+  // sequence numbers are compared with wrap around in mind
+  if (m_is_last_sequence_valid &&
+      (0 >= static_cast<int32_t>(sequence - m_last_sequence))) {
+    // arrived after its frame was already handed out
+    Drop(profile);
+    return;
+  }
+
+  if (kMaxPendingFrames <= m_pending.size()) {
+    FinishOldest();
+  }
+
+  Frame frame;
+  if (m_spare.empty()) {
+    frame.profiles.resize(m_elements.size());
+  } else {
+    frame = std::move(m_spare.back());
+    m_spare.pop_back();
+  }
+
+  std::fill(frame.profiles.begin(), frame.profiles.end(), nullptr);
+  frame.profiles[idx] = profile;
+  frame.timestamp_ns = timestamp;
+  frame.sequence_number = sequence;
+  frame.received = 1;
+  frame.deadline = now + m_timeout;
+
+  // keep frames in sequence order; almost always goes at the back
+  auto pos = m_pending.end();
+  while ((m_pending.begin() != pos) &&
+         (0 < static_cast<int32_t>(std::prev(pos)->sequence_number -
+                                   sequence))) {
+    pos--;
+  }
+  m_pending.insert(pos, std::move(frame));
+}
+
+void FrameAssembler::FinishOldest()
+{
+  Frame &frame = m_pending.front();
+  m_last_sequence = frame.sequence_number;
+  m_is_last_sequence_valid = true;
+
+  m_ready.push_back(std::move(frame));
+  m_pending.pop_front();
+}
+
+void FrameAssembler::Recycle(Frame &frame)
+{
+  m_spare.push_back(std::move(frame));
+}
+
+void FrameAssembler::Drop(jsRawProfile *profile)
+{
+  auto iter = m_scan_heads.find(profile->scan_head_id);
+  if (m_scan_heads.end() != iter) {
+    iter->second->ReleaseProfiles(&profile, 1);
+  }
+}
@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_FRAME_ASSEMBLER_H
+#define JOESCAN_FRAME_ASSEMBLER_H
+
+#include "PhaseTable.hpp"
+#include "joescan_pinchot.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace joescan {
+class ScanHead;
+
+/**
+ * @brief The `FrameAssembler` class groups the profiles taken by every scan
+ * head, camera and laser element of the phase table during one scan period
+ * into a frame. Profiles are matched up by their sequence number, with their
+ * timestamps having to fall within one scan period of each other.
+ *
+ * Frames are handed out in order. A frame is ready once it holds a profile for
+ * every element or once its completeness timeout expires, in which case the
+ * missing elements are left empty. Profiles are pulled from the profile queues
+ * of the scan heads by the consumer, so nothing is added to the receive path;
+ * only one consumer thread may use the assembler at a time.
+ */
+class FrameAssembler {
+ public:
+  // frames waiting on profiles before the oldest is handed out incomplete
+  static const uint32_t kMaxPendingFrames = 64;
+  // profiles taken from a scan head at a time; keeps the heads in step so
+  // one with a backlog doesn't push out the frames the others are filling
+  static const uint32_t kDrainBatchSize = 8;
+
+  struct Element {
+    ScanHead *scan_head;
+    uint32_t scan_head_id;
+    jsCamera camera;
+    jsLaser laser;
+  };
+
+  struct Frame {
+    // indexed by element, `nullptr` for elements missing from the frame
+    std::vector<jsRawProfile *> profiles;
+    uint64_t timestamp_ns;
+    uint32_t sequence_number;
+    uint32_t received;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  FrameAssembler();
+  ~FrameAssembler();
+
+  /**
+   * Lists the elements making up a frame, in the order their profiles are
+   * placed in the frame: by phase, then as inserted into the phase. A camera
+   * and laser pair scanned in more than one phase is only listed once.
+   *
+   * @param table The phase table the scan system is scanning with.
+   * @return The elements of a frame.
+   */
+  static std::vector<Element> GetElements(PhaseTableCalculated &table);
+
+  /**
+   * Sets up the elements making up a frame. Any frames held are cleared.
+   *
+   * @param elements The elements of a frame, as given by `GetElements`.
+   * @param period_us The scan period in microseconds.
+   * @param timeout_us Time in microseconds to wait for a frame to complete.
+   */
+  void Configure(const std::vector<Element> &elements, uint32_t period_us,
+                 uint32_t timeout_us);
+
+  /**
+   * Returns the number of elements, and so profiles, that make up a frame.
+   *
+   * @return The frame size.
+   */
+  uint32_t GetFrameSize() const;
+
+  /**
+   * Takes all profiles queued by the scan heads and sorts them into frames,
+   * then hands out frames that are complete or have timed out.
+   *
+   * @return The number of frames ready to be read.
+   */
+  uint32_t Poll();
+
+  /**
+   * Returns the number of profiles queued by the scan heads of the frame.
+   *
+   * @return The number of profiles waiting to be sorted into frames.
+   */
+  uint32_t AvailableProfiles() const;
+
+  /**
+   * Returns the time by which the oldest frame in progress times out, which
+   * is the soonest a frame can be ready without more profiles arriving.
+   *
+   * @return The deadline or `time_point::max()` if no frame is in progress.
+   */
+  std::chrono::steady_clock::time_point GetDeadline() const;
+
+  /**
+   * Takes the oldest ready frame. The profiles of the frame must be handed
+   * back with `Release` once the caller is done with them.
+   *
+   * @param info Pointer to be updated with information about the frame.
+   * @param profiles Array to be filled with pointers to the profiles of the
+   * frame, with `nullptr` for missing elements.
+   * @return Boolean `true` if a frame was taken, `false` if none are ready.
+   */
+  bool Pop(jsFrameInfo *info, jsRawProfile **profiles);
+
+  /**
+   * Hands profiles taken with `Pop` back to their scan heads.
+   *
+   * @param profiles Array of pointers to profile data; `nullptr` is skipped.
+   * @param count The number of profiles in the array.
+   * @return `0` on success or `JS_ERROR_INVALID_ARGUMENT` if a profile did not
+   * come from a scan head of the frame.
+   */
+  int Release(jsRawProfile **profiles, uint32_t count);
+
+  /**
+   * Hands the profiles of all frames held back to their scan heads.
+   */
+  void Clear();
+
+ private:
+  typedef std::tuple<uint32_t, jsCamera, jsLaser> ElementKey;
+
+  void Add(jsRawProfile *profile, std::chrono::steady_clock::time_point now);
+  void FinishOldest();
+  void Recycle(Frame &frame);
+  void Drop(jsRawProfile *profile);
+
+  std::map<ElementKey, uint32_t> m_element_index;
+  std::vector<Element> m_elements;
+  std::map<uint32_t, ScanHead *> m_scan_heads;
+  std::deque<Frame> m_pending;
+  std::deque<Frame> m_ready;
+  // frames no longer in use, kept so their profile arrays aren't reallocated
+  std::vector<Frame> m_spare;
+  std::chrono::microseconds m_timeout;
+  uint64_t m_window_ns;
+  uint32_t m_last_sequence;
+  bool m_is_last_sequence_valid;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_FRAME_ASSEMBLER_H
@@ -0,0 +1,320 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "IoUring.hpp"
+
+#ifdef JOESCAN_HAVE_IO_URING
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace joescan;
+
+// NOTE: ring indexes are shared with the kernel; use GCC atomic builtins on
+// the mapped memory since it isn't declared as `std::atomic`
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static int _io_uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int _io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+                           uint32_t flags, void *arg, size_t arg_size)
+{
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, arg, arg_size));
+}
+
+static int _io_uring_register(int fd, uint32_t opcode, void *arg,
+                              uint32_t nr_args)
+{
+  return static_cast<int>(
+    syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+IoUring::IoUring()
+  : m_fd(-1),
+    m_ring_ptr(MAP_FAILED),
+    m_ring_size(0),
+    m_sqes(nullptr),
+    m_sqes_size(0),
+    m_sq_head(nullptr),
+    m_sq_tail(nullptr),
+    m_sq_array(nullptr),
+    m_sq_mask(0),
+    m_sq_entries(0),
+    m_sqe_tail(0),
+    m_cq_head(nullptr),
+    m_cq_tail(nullptr),
+    m_cqes(nullptr),
+    m_cq_mask(0),
+    m_buf_ring(nullptr),
+    m_buf_ring_size(0),
+    m_bufs(nullptr),
+    m_buf_size(0),
+    m_buf_mask(0),
+    m_buf_group(0)
+{
+}
+
+IoUring::~IoUring()
+{
+  Close();
+}
+
+bool IoUring::IsSupported()
+{
+  static const bool is_supported = []() {
+    IoUring ring;
+    if (0 != ring.Init(4)) {
+      return false;
+    }
+
+    if (0 != ring.SetupBufferRing(0, 1, 64)) {
+      return false;
+    }
+
+    // multishot receive came after provided buffer rings; the only reliable
+    // check is to arm one and see that it completes with data and stays armed
+    int fds[2];
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+      return false;
+    }
+
+    bool is_multishot = false;
+    struct io_uring_sqe *sqe = ring.GetSqe();
+    if (nullptr != sqe) {
+      sqe->opcode = IORING_OP_RECV;
+      sqe->fd = fds[0];
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = 0;
+
+      const uint8_t probe = 0;
+      struct io_uring_cqe *cqe = nullptr;
+      if ((1 == write(fds[1], &probe, sizeof(probe))) &&
+          (0 == ring.SubmitAndWait(1, 1000)) && ring.PeekCqe(&cqe)) {
+        is_multishot = (0 < cqe->res) && (cqe->flags & IORING_CQE_F_MORE);
+        ring.SeenCqe();
+      }
+    }
+
+    // closing the ring cancels the receive before the sockets go away
+    ring.Close();
+    close(fds[0]);
+    close(fds[1]);
+
+    return is_multishot;
+  }();
+
+  return is_supported;
+}
+
+int IoUring::Init(uint32_t entries)
+{
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  m_fd = _io_uring_setup(entries, &p);
+  if (0 > m_fd) {
+    return -errno;
+  }
+
+  // rely on waiting with a timeout and a single mapping for both queues
+  const uint32_t features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG;
+  if (features != (p.features & features)) {
+    Close();
+    return -ENOSYS;
+  }
+
+  size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  m_ring_size = (sq_size > cq_size) ? sq_size : cq_size;
+  m_ring_ptr = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == m_ring_ptr) {
+    int r = -errno;
+    Close();
+    return r;
+  }
+
+  m_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+  if (MAP_FAILED == sqes) {
+    int r = -errno;
+    Close();
+    return r;
+  }
+  m_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+  uint8_t *ring = static_cast<uint8_t *>(m_ring_ptr);
+  m_sq_head = reinterpret_cast<uint32_t *>(ring + p.sq_off.head);
+  m_sq_tail = reinterpret_cast<uint32_t *>(ring + p.sq_off.tail);
+  m_sq_array = reinterpret_cast<uint32_t *>(ring + p.sq_off.array);
+  m_sq_mask = *reinterpret_cast<uint32_t *>(ring + p.sq_off.ring_mask);
+  m_sq_entries = p.sq_entries;
+  m_sqe_tail = *m_sq_tail;
+
+  m_cq_head = reinterpret_cast<uint32_t *>(ring + p.cq_off.head);
+  m_cq_tail = reinterpret_cast<uint32_t *>(ring + p.cq_off.tail);
+  m_cqes = reinterpret_cast<struct io_uring_cqe *>(ring + p.cq_off.cqes);
+  m_cq_mask = *reinterpret_cast<uint32_t *>(ring + p.cq_off.ring_mask);
+
+  return 0;
+}
+
+void IoUring::Close()
+{
+  // closing the ring cancels all outstanding requests and unregisters buffers
+  if (0 <= m_fd) {
+    close(m_fd);
+    m_fd = -1;
+  }
+
+  if (nullptr != m_sqes) {
+    munmap(m_sqes, m_sqes_size);
+    m_sqes = nullptr;
+  }
+
+  if (MAP_FAILED != m_ring_ptr) {
+    munmap(m_ring_ptr, m_ring_size);
+    m_ring_ptr = MAP_FAILED;
+  }
+
+  if (nullptr != m_buf_ring) {
+    munmap(m_buf_ring, m_buf_ring_size);
+    m_buf_ring = nullptr;
+  }
+
+  delete[] m_bufs;
+  m_bufs = nullptr;
+}
+
+struct io_uring_sqe *IoUring::GetSqe()
+{
+  uint32_t head = LOAD_ACQUIRE(m_sq_head);
+
+  if (m_sq_entries <= (m_sqe_tail - head)) {
+    return nullptr;
+  }
+
+  uint32_t idx = m_sqe_tail & m_sq_mask;
+  struct io_uring_sqe *sqe = &m_sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  m_sq_array[idx] = idx;
+  m_sqe_tail++;
+
+  return sqe;
+}
+
+int IoUring::SubmitAndWait(uint32_t wait_nr, int timeout_ms)
+{
+  uint32_t to_submit = m_sqe_tail - *m_sq_tail;
+  uint32_t flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+
+  STORE_RELEASE(m_sq_tail, m_sqe_tail);
+
+  memset(&arg, 0, sizeof(arg));
+  arg.sigmask_sz = _NSIG / 8;
+  if (0 <= timeout_ms) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+  }
+
+  int r = _io_uring_enter(m_fd, to_submit, wait_nr, flags, &arg, sizeof(arg));
+
+  return (0 > r) ? -errno : 0;
+}
+
+bool IoUring::PeekCqe(struct io_uring_cqe **cqe)
+{
+  uint32_t head = *m_cq_head;
+
+  if (head == LOAD_ACQUIRE(m_cq_tail)) {
+    return false;
+  }
+
+  *cqe = &m_cqes[head & m_cq_mask];
+  return true;
+}
+
+void IoUring::SeenCqe()
+{
+  STORE_RELEASE(m_cq_head, *m_cq_head + 1);
+}
+
+int IoUring::SetupBufferRing(uint16_t group, uint32_t num_bufs,
+                             uint32_t buf_size)
+{
+  // ring memory must be page aligned; anonymous mapping guarantees this
+  m_buf_ring_size = num_bufs * sizeof(struct io_uring_buf);
+  void *ring = mmap(nullptr, m_buf_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == ring) {
+    return -errno;
+  }
+  m_buf_ring = static_cast<struct io_uring_buf *>(ring);
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(m_buf_ring);
+  reg.ring_entries = num_bufs;
+  reg.bgid = group;
+
+  if (0 > _io_uring_register(m_fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+    int r = -errno;
+    munmap(m_buf_ring, m_buf_ring_size);
+    m_buf_ring = nullptr;
+    return r;
+  }
+
+  m_bufs = new uint8_t[static_cast<size_t>(num_bufs) * buf_size];
+  m_buf_size = buf_size;
+  m_buf_mask = num_bufs - 1;
+  m_buf_group = group;
+
+  for (uint32_t n = 0; n < num_bufs; n++) {
+    struct io_uring_buf *buf = &m_buf_ring[n];
+    buf->addr = reinterpret_cast<uint64_t>(GetBuffer(static_cast<uint16_t>(n)));
+    buf->len = buf_size;
+    buf->bid = static_cast<uint16_t>(n);
+  }
+  // ring tail overlays the first buffer entry's reserved field
+  STORE_RELEASE(&m_buf_ring[0].resv, static_cast<uint16_t>(num_bufs));
+
+  return 0;
+}
+
+uint8_t *IoUring::GetBuffer(uint16_t bid)
+{
+  return &m_bufs[static_cast<size_t>(bid) * m_buf_size];
+}
+
+void IoUring::RecycleBuffer(uint16_t bid)
+{
+  uint16_t tail = m_buf_ring[0].resv;
+  struct io_uring_buf *buf = &m_buf_ring[tail & m_buf_mask];
+
+  buf->addr = reinterpret_cast<uint64_t>(GetBuffer(bid));
+  buf->len = m_buf_size;
+  buf->bid = bid;
+  STORE_RELEASE(&m_buf_ring[0].resv, static_cast<uint16_t>(tail + 1));
+}
+
+#endif // JOESCAN_HAVE_IO_URING
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_IO_URING_H
+#define JOESCAN_IO_URING_H
+
+// io_uring support requires kernel headers new enough to provide multishot
+// receive and provided buffer rings (Linux 6.0 or newer)
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define JOESCAN_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef JOESCAN_HAVE_IO_URING
+
+#include <cstddef>
+#include <cstdint>
+
+namespace joescan {
+
+/**
+ * @brief The `IoUring` class is a minimal wrapper around the Linux io_uring
+ * system calls, covering just what is needed to receive data from sockets:
+ * submitting requests, reaping completions, and a provided buffer ring that
+ * the kernel picks receive buffers from. Not thread safe; a ring should only
+ * be used by the thread that created it.
+ */
+class IoUring {
+ public:
+  IoUring();
+  ~IoUring();
+
+  /**
+   * Checks if the running kernel supports the io_uring features used by this
+   * class. The result is determined once and cached.
+   *
+   * @return Boolean `true` if supported, `false` otherwise.
+   */
+  static bool IsSupported();
+
+  /**
+   * Creates the ring.
+   *
+   * @param entries The number of submission queue entries.
+   * @return `0` on success, negative `errno` value on error.
+   */
+  int Init(uint32_t entries);
+
+  /**
+   * Destroys the ring, cancelling any outstanding requests.
+   */
+  void Close();
+
+  /**
+   * Gets a cleared submission queue entry to fill in. The entry is submitted
+   * on the next call to `SubmitAndWait`.
+   *
+   * @return Pointer to the entry or `nullptr` if the queue is full.
+   */
+  struct io_uring_sqe *GetSqe();
+
+  /**
+   * Submits all pending entries and waits for completions.
+   *
+   * @param wait_nr The number of completions to wait for.
+   * @param timeout_ms The max time to wait for or negative to wait forever.
+   * @return `0` on success, negative `errno` value on error; `-ETIME` if the
+   * timeout expired.
+   */
+  int SubmitAndWait(uint32_t wait_nr, int timeout_ms);
+
+  /**
+   * Gets the next completion, if any. Must be followed by `SeenCqe` once the
+   * completion has been handled.
+   *
+   * @param cqe Pointer to be updated with the completion.
+   * @return Boolean `true` if a completion was returned, `false` otherwise.
+   */
+  bool PeekCqe(struct io_uring_cqe **cqe);
+
+  /**
+   * Marks the completion returned by `PeekCqe` as consumed.
+   */
+  void SeenCqe();
+
+  /**
+   * Allocates and registers a ring of buffers the kernel will choose from when
+   * completing requests flagged with `IOSQE_BUFFER_SELECT`.
+   *
+   * @param group The buffer group ID to register the buffers under.
+   * @param num_bufs The number of buffers; must be a power of two.
+   * @param buf_size The size of each buffer in bytes.
+   * @return `0` on success, negative `errno` value on error.
+   */
+  int SetupBufferRing(uint16_t group, uint32_t num_bufs, uint32_t buf_size);
+
+  /**
+   * Gets the memory of a provided buffer.
+   *
+   * @param bid The buffer ID reported in the completion flags.
+   * @return Pointer to the buffer.
+   */
+  uint8_t *GetBuffer(uint16_t bid);
+
+  /**
+   * Hands a provided buffer back to the kernel once its data has been used.
+   *
+   * @param bid The buffer ID reported in the completion flags.
+   */
+  void RecycleBuffer(uint16_t bid);
+
+ private:
+  int m_fd;
+
+  void *m_ring_ptr;
+  size_t m_ring_size;
+  struct io_uring_sqe *m_sqes;
+  size_t m_sqes_size;
+
+  uint32_t *m_sq_head;
+  uint32_t *m_sq_tail;
+  uint32_t *m_sq_array;
+  uint32_t m_sq_mask;
+  uint32_t m_sq_entries;
+  // entries handed out by `GetSqe` but not yet made visible to the kernel
+  uint32_t m_sqe_tail;
+
+  uint32_t *m_cq_head;
+  uint32_t *m_cq_tail;
+  struct io_uring_cqe *m_cqes;
+  uint32_t m_cq_mask;
+
+  // NOTE: `struct io_uring_buf_ring` is not used directly since some kernel
+  // headers declare its buffer array in a way that is offset when compiled as
+  // C++; the ring is simply an array of `struct io_uring_buf`
+  struct io_uring_buf *m_buf_ring;
+  size_t m_buf_ring_size;
+  uint8_t *m_bufs;
+  uint32_t m_buf_size;
+  uint32_t m_buf_mask;
+  uint16_t m_buf_group;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_HAVE_IO_URING
+
+#endif // JOESCAN_IO_URING_H
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "PresenceGate.hpp"
+
+using namespace joescan;
+
+PresenceGate::PresenceGate()
+  : m_held_begin(0),
+    m_held_count(0),
+    m_gap(0),
+    m_post_remaining(0),
+    m_open_points(0),
+    m_close_points(0),
+    m_pre_roll(0),
+    m_post_roll(0),
+    m_is_open(false),
+    m_gated(0)
+{
+}
+
+void PresenceGate::Configure(uint32_t open_points, uint32_t close_points,
+                             uint32_t pre_roll, uint32_t post_roll)
+{
+  m_held_begin = 0;
+  m_held_count = 0;
+  m_gap = 0;
+  m_post_remaining = 0;
+  m_open_points = open_points;
+  m_close_points = close_points;
+  m_pre_roll = (kMaxPreRoll < pre_roll) ? kMaxPreRoll : pre_roll;
+  m_post_roll = post_roll;
+  m_is_open = false;
+}
+
+uint32_t PresenceGate::Add(jsRawProfile *profile, jsRawProfile **out,
+                           jsRawProfile **dropped)
+{
+  *dropped = nullptr;
+
+  if (0 == m_open_points) {
+    out[0] = profile;
+    return 1;
+  }
+
+  const uint32_t valid = profile->data_valid_xy;
+
+  if (m_is_open) {
+    if (valid >= m_close_points) {
+      m_post_remaining = m_post_roll;
+      out[0] = profile;
+      return 1;
+    }
+
+    if (0 != m_post_remaining) {
+      m_post_remaining--;
+      out[0] = profile;
+      return 1;
+    }
+
+    m_is_open = false;
+  } else if (valid >= m_open_points) {
+    m_is_open = true;
+    m_post_remaining = m_post_roll;
+
+    uint32_t n = TakeHeld(out);
+    out[n++] = profile;
+    out[0]->gap_profiles = m_gap;
+    m_gap = 0;
+    return n;
+  }
+
+  // gate is closed, hold on to the profile in case presence starts soon
+  if (0 == m_pre_roll) {
+    *dropped = profile;
+  } else {
+    if (m_pre_roll == m_held_count) {
+      *dropped = m_held[m_held_begin];
+      m_held_begin = (m_held_begin + 1) % kMaxPreRoll;
+      m_held_count--;
+    }
+
+    m_held[(m_held_begin + m_held_count) % kMaxPreRoll] = profile;
+    m_held_count++;
+  }
+
+  if (nullptr != *dropped) {
+    m_gap++;
+    m_gated.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return 0;
+}
+
+uint32_t PresenceGate::Clear(jsRawProfile **held)
+{
+  uint32_t n = TakeHeld(held);
+
+  m_gap = 0;
+  m_post_remaining = 0;
+  m_is_open = false;
+
+  return n;
+}
+
+uint64_t PresenceGate::GetGatedCount() const
+{
+  return m_gated.load(std::memory_order_relaxed);
+}
+
+void PresenceGate::ResetStatistics()
+{
+  m_gated.store(0, std::memory_order_relaxed);
+}
+
+uint32_t PresenceGate::TakeHeld(jsRawProfile **out)
+{
+  uint32_t n = m_held_count;
+
+  for (uint32_t m = 0; m < n; m++) {
+    out[m] = m_held[(m_held_begin + m) % kMaxPreRoll];
+  }
+
+  m_held_begin = 0;
+  m_held_count = 0;
+
+  return n;
+}
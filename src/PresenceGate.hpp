@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PRESENCE_GATE_H
+#define JOESCAN_PRESENCE_GATE_H
+
+#include "joescan_pinchot.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace joescan {
+
+/**
+ * @brief The `PresenceGate` class discards the profiles of one camera and
+ * laser pair while nothing is in the scan window, judged by the number of
+ * valid points. The gate opens once a profile has at least the open count of
+ * valid points and closes once profiles fall below the close count, giving
+ * hysteresis so noise around a single threshold doesn't toggle it.
+ *
+ * A number of profiles taken right before the gate opens are held back and
+ * passed on with the profile that opened it (pre-roll), and a number of
+ * profiles are still passed on after presence ends (post-roll). The first
+ * profile passed on after the gate was closed records how many profiles were
+ * discarded in its `gap_profiles` field. Only the thread assembling profiles
+ * may use the gate, apart from reading the statistics.
+ */
+class PresenceGate {
+ public:
+  static const uint32_t kMaxPreRoll = JS_PRESENCE_GATE_PRE_ROLL_MAX;
+
+  PresenceGate();
+
+  /**
+   * Sets how profiles are gated. Must only be called when no profiles are
+   * held, such as after `Clear`.
+   *
+   * @param open_points Valid points needed to open the gate, `0` to pass all
+   * profiles through.
+   * @param close_points Valid points below which the gate closes.
+   * @param pre_roll Profiles passed on from before the gate opens.
+   * @param post_roll Profiles passed on after the gate would close.
+   */
+  void Configure(uint32_t open_points, uint32_t close_points,
+                 uint32_t pre_roll, uint32_t post_roll);
+
+  /**
+   * Adds the next profile assembled for the camera and laser pair.
+   *
+   * @param profile Pointer to the newly assembled profile.
+   * @param out Array to be filled with the profiles to pass on, oldest
+   * first; must hold at least `kMaxPreRoll + 1` pointers.
+   * @param dropped Pointer to be set to a profile discarded, which the caller
+   * must return to the pool, or `nullptr`.
+   * @return The number of profiles placed in `out`.
+   */
+  uint32_t Add(jsRawProfile *profile, jsRawProfile **out,
+               jsRawProfile **dropped);
+
+  /**
+   * Closes the gate and gives up the profiles held for pre-roll.
+   *
+   * @param held Array to be filled with the profiles held, to be returned to
+   * the pool; must hold at least `kMaxPreRoll` pointers.
+   * @return The number of profiles placed in `held`.
+   */
+  uint32_t Clear(jsRawProfile **held);
+
+  uint64_t GetGatedCount() const;
+  void ResetStatistics();
+
+ private:
+  uint32_t TakeHeld(jsRawProfile **out);
+
+  // ring of profiles held for pre-roll, oldest at `m_held_begin`
+  jsRawProfile *m_held[kMaxPreRoll];
+  uint32_t m_held_begin;
+  uint32_t m_held_count;
+  // profiles discarded since a profile was last passed on
+  uint64_t m_gap;
+  uint32_t m_post_remaining;
+  uint32_t m_open_points;
+  uint32_t m_close_points;
+  uint32_t m_pre_roll;
+  uint32_t m_post_roll;
+  bool m_is_open;
+  std::atomic<uint64_t> m_gated;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_PRESENCE_GATE_H
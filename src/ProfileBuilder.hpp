@@ -8,24 +8,92 @@
 #ifndef JOESCAN_PROFILE_BUILDER_H
 #define JOESCAN_PROFILE_BUILDER_H
 
-#include <cassert>
-#include <memory>
+#include <cstring>
+#include <limits>
 
 #include "DataPacket.hpp"
 #include "NetworkTypes.hpp"
 #include "Point2D.hpp"
+#include "ProfileKernels.hpp"
 #include "joescan_pinchot.h"
 
 namespace joescan {
+/**
+ * Gets the range of data array entries a profile can receive data in, from
+ * the start and end columns and X/Y step sent with each of its packets.
+ *
+ * @param packet Any packet of the profile.
+ * @param len The length of the profile data array.
+ * @param start Set to the first entry that can receive data.
+ * @param end Set to one past the last entry that can receive data.
+ * @return Boolean `true` on success, `false` if the range can't be determined
+ * and the whole array needs to be considered.
+ */
+inline bool GetProfileDataRange(const DataPacket &packet, uint32_t len,
+                                uint32_t *start, uint32_t *end)
+{
+  const uint32_t first = packet.GetStartColumn();
+  const uint32_t last = packet.GetEndColumn();
+  const uint32_t step = packet.GetFragmentLayout(DataType::XYData).step;
+
+  if ((0 == step) || (last < first) || (len <= last)) {
+    return false;
+  }
+
+  // columns are divided among packets by step, any left over are never sent
+  const uint32_t num_vals = (last - first + 1) / step;
+  if (0 == num_vals) {
+    return false;
+  }
+
+  *start = first;
+  *end = first + (num_vals - 1) * step + 1;
+
+  return true;
+}
+
 struct ProfileBuilder {
-  ProfileBuilder() : raw(nullptr)
+  // parts of a profile that can be tracked in `parts_received`
+  static const uint32_t kMaxTrackedParts = 64;
+
+  ProfileBuilder()
+    : raw(nullptr),
+      data_stride(1),
+      data_start(0),
+      part_step(0),
+      parts_expected(0),
+      parts_received(0),
+      is_filled(true)
   {
   }
 
-  ProfileBuilder(jsCamera camera, jsLaser laser, DataPacket& packet,
-                 jsDataFormat format)
+  /**
+   * Begins assembly of a profile. Entries of the data array are not marked
+   * invalid up front; `data_len` is limited to the columns the scan head
+   * sends, each packet received writes every entry it covers, invalid points
+   * included, and once assembly is done, `Fill` or `Compact` only touch the
+   * entries outside of those columns and of packets that never arrived. Should the range of columns not be
+   * known, the whole array is marked invalid here instead.
+   *
+   * Only entries that can receive data for the data format, every `stride`
+   * entries, are marked invalid; the entries in between are left alone when
+   * the caller knows they already hold invalid values from the last time the
+   * profile was assembled.
+   *
+   * @param profile Pointer to the profile to assemble into.
+   * @param camera The camera of the profile.
+   * @param laser The laser of the profile.
+   * @param packet The first packet received for the profile.
+   * @param format The data format of the profile.
+   * @param stride The step between entries that can hold data.
+   * @param is_clean Boolean `true` if entries between each `stride` already
+   * hold invalid values, `false` to initialize the whole data array.
+   */
+  ProfileBuilder(jsRawProfile *profile, jsCamera camera, jsLaser laser,
+                 DataPacket& packet, jsDataFormat format, uint32_t stride,
+                 bool is_clean)
   {
-    raw = std::make_shared<jsRawProfile>();
+    raw = profile;
     raw->scan_head_id = packet.m_hdr.scan_head_id;
     raw->camera = camera;
     raw->laser = laser;
@@ -34,24 +102,36 @@ struct ProfileBuilder {
     raw->sequence_number = packet.m_hdr.sequence_number;
     raw->laser_on_time_us = packet.m_hdr.laser_on_time_us;
     raw->format = format;
-    raw->data_len = JS_RAW_PROFILE_DATA_LEN;
     raw->data_valid_brightness = 0;
     raw->data_valid_xy = 0;
-    raw->num_encoder_values = 0;
+    raw->gap_profiles = 0;
+    raw->num_encoder_values = packet.m_num_encoders;
 
-#ifdef _DEBUG
-    assert(packet.m_encoders.size() < JS_ENCODER_MAX);
-#endif
-
-    for (uint32_t n = 0; n < packet.m_encoders.size(); n++) {
+    for (uint32_t n = 0; n < packet.m_num_encoders; n++) {
       raw->encoder_values[n] = packet.m_encoders[n];
-      raw->num_encoder_values++;
     }
 
-    for (uint32_t n = 0; n < JS_RAW_PROFILE_DATA_LEN; n++) {
-      raw->data[n].x = JS_PROFILE_DATA_INVALID_XY;
-      raw->data[n].y = JS_PROFILE_DATA_INVALID_XY;
-      raw->data[n].brightness = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+    data_stride = stride;
+    parts_expected = packet.GetNumParts();
+    parts_received = 0;
+    part_step = packet.GetFragmentLayout(DataType::XYData).step;
+
+    uint32_t end = 0;
+    if (is_clean && (kMaxTrackedParts >= parts_expected) &&
+        GetProfileDataRange(packet, JS_RAW_PROFILE_DATA_LEN, &data_start,
+                            &end)) {
+      raw->data_len = end;
+      is_filled = false;
+      return;
+    }
+
+    raw->data_len = JS_RAW_PROFILE_DATA_LEN;
+    data_start = 0;
+    is_filled = true;
+
+    const uint32_t step = is_clean ? stride : 1;
+    for (uint32_t n = 0; n < JS_RAW_PROFILE_DATA_LEN; n += step) {
+      SetInvalid(n);
     }
   }
 
@@ -84,12 +164,256 @@ struct ProfileBuilder {
     raw->data_valid_brightness++;
   }
 
+  /**
+   * Converts and inserts X/Y points, and optionally brightness, as sent by
+   * the scan head. See `ProcessPointsXY`.
+   */
+  inline void InsertPoints(uint32_t part, uint32_t idx, uint32_t inc,
+                           const uint8_t *xy, const uint8_t *brightness,
+                           uint32_t num, const CameraToMillTransform &t)
+  {
+    uint32_t valid =
+      ProcessPointsXY(xy, brightness, num, t, &raw->data[idx], inc);
+
+    if (kMaxTrackedParts > part) {
+      parts_received |= (1ull << part);
+    }
+
+    raw->data_valid_xy += valid;
+    if (nullptr != brightness) {
+      raw->data_valid_brightness += valid;
+    }
+  }
+
+  /**
+   * Moves the valid points of the profile to the front of the data array, in
+   * order, leaving `data_len` as the number of valid points. This is the same
+   * layout `jsProfile` uses, so the profile can be converted with a single
+   * copy.
+   *
+   * @param stride The step between entries that can hold data.
+   */
+  inline void Compact(uint32_t stride)
+  {
+    FillMissingParts();
+
+    if (raw->data_valid_xy == raw->data_len) {
+      // every entry is valid, nothing to move
+      return;
+    }
+
+    uint32_t len = 0;
+    for (uint32_t n = data_start; n < raw->data_len; n += stride) {
+      if ((JS_PROFILE_DATA_INVALID_XY != raw->data[n].x) ||
+          (JS_PROFILE_DATA_INVALID_XY != raw->data[n].y)) {
+        raw->data[len++] = raw->data[n];
+      }
+    }
+
+    raw->data_len = len;
+    raw->data_valid_xy = len;
+  }
+
+  /**
+   * Marks every entry that did not receive data as invalid and extends
+   * `data_len` to the whole data array, giving the layout documented for
+   * `jsRawProfile`.
+   */
+  inline void Fill()
+  {
+    if (is_filled) {
+      return;
+    }
+
+    for (uint32_t n = 0; n < data_start; n += data_stride) {
+      SetInvalid(n);
+    }
+
+    FillMissingParts();
+
+    // entries past the scan window may hold points from the last time the
+    // profile was assembled with a wider window
+    const uint32_t end = raw->data_len;
+    for (uint32_t n = (end + data_stride - 1) / data_stride * data_stride;
+         n < JS_RAW_PROFILE_DATA_LEN; n += data_stride) {
+      SetInvalid(n);
+    }
+
+    raw->data_len = JS_RAW_PROFILE_DATA_LEN;
+    is_filled = true;
+  }
+
   inline bool IsEmpty()
   {
     return (nullptr == raw) ? true : false;
   }
 
-  std::shared_ptr<jsRawProfile> raw;
+  jsRawProfile *raw;
+  // step between entries that can hold data for the data format
+  uint32_t data_stride;
+  // first entry that can hold data
+  uint32_t data_start;
+  // each packet holds every `parts_expected` value starting `part * step`
+  // entries after `data_start`
+  uint32_t part_step;
+  uint32_t parts_expected;
+  // bit per packet that inserted points
+  uint64_t parts_received;
+  // set once every entry not holding data is marked invalid
+  bool is_filled;
+
+ private:
+  inline void SetInvalid(uint32_t idx)
+  {
+    raw->data[idx].x = JS_PROFILE_DATA_INVALID_XY;
+    raw->data[idx].y = JS_PROFILE_DATA_INVALID_XY;
+    raw->data[idx].brightness = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+  }
+
+  inline void FillMissingParts()
+  {
+    if (is_filled) {
+      return;
+    }
+
+    const uint32_t inc = parts_expected * part_step;
+    for (uint32_t p = 0; p < parts_expected; p++) {
+      if (0 != (parts_received & (1ull << p))) {
+        continue;
+      }
+
+      for (uint32_t n = data_start + p * part_step; n < raw->data_len;
+           n += inc) {
+        SetInvalid(n);
+      }
+    }
+  }
+};
+
+/**
+ * @brief Assembles profile data directly into a `jsProfileSoA`. While being
+ * assembled, points are held at the array index of their camera column, with
+ * invalid points marked by a NaN X value; `Compact` moves the valid points to
+ * the front once all packets have been received.
+ */
+struct ProfileSoABuilder {
+  // profile X/Y values are in 1/1000 scan system units
+  static constexpr float kScale = 0.001f;
+
+  ProfileSoABuilder() : profile(nullptr), data_start(0), data_end(0)
+  {
+  }
+
+  /**
+   * Begins assembly of a profile. Only entries that can receive data, every
+   * `stride` entries within the columns sent by the scan head, are
+   * initialized since `Compact` never looks at the others.
+   *
+   * @param p Pointer to the profile to assemble into.
+   * @param camera The camera of the profile.
+   * @param laser The laser of the profile.
+   * @param packet The first packet received for the profile.
+   * @param format The data format of the profile.
+   * @param stride The step between entries that can hold data.
+   */
+  ProfileSoABuilder(jsProfileSoA *p, jsCamera camera, jsLaser laser,
+                    DataPacket &packet, jsDataFormat format, uint32_t stride)
+  {
+    profile = p;
+    profile->scan_head_id = packet.m_hdr.scan_head_id;
+    profile->camera = camera;
+    profile->laser = laser;
+    profile->timestamp_ns = packet.m_hdr.timestamp_ns;
+    profile->flags = packet.m_hdr.flags;
+    profile->sequence_number = packet.m_hdr.sequence_number;
+    profile->laser_on_time_us = packet.m_hdr.laser_on_time_us;
+    profile->format = format;
+    // counts valid points until compacted
+    profile->data_len = 0;
+    profile->num_encoder_values = packet.m_num_encoders;
+
+    for (uint32_t n = 0; n < packet.m_num_encoders; n++) {
+      profile->encoder_values[n] = packet.m_encoders[n];
+    }
+
+    if (!GetProfileDataRange(packet, JS_PROFILE_DATA_LEN, &data_start,
+                             &data_end)) {
+      data_start = 0;
+      data_end = JS_PROFILE_DATA_LEN;
+    }
+
+    const float invalid = std::numeric_limits<float>::quiet_NaN();
+    if (1 == stride) {
+      for (uint32_t n = data_start; n < data_end; n++) {
+        profile->x[n] = invalid;
+      }
+
+      memset(&profile->brightness[data_start],
+             JS_PROFILE_DATA_INVALID_BRIGHTNESS, data_end - data_start);
+    } else {
+      for (uint32_t n = data_start; n < data_end; n += stride) {
+        profile->x[n] = invalid;
+        profile->brightness[n] = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+      }
+    }
+  }
+
+  inline void SetPacketInfo(uint32_t received, uint32_t expected)
+  {
+    profile->packets_received = received;
+    profile->packets_expected = expected;
+  }
+
+  /**
+   * Converts and inserts X/Y points, and optionally brightness, as sent by
+   * the scan head. See `ProcessPointsXY`.
+   */
+  inline void InsertPoints(uint32_t idx, uint32_t inc, const uint8_t *xy,
+                           const uint8_t *brightness, uint32_t num,
+                           const CameraToMillTransform &t)
+  {
+    profile->data_len +=
+      ProcessPointsXY(xy, brightness, num, t, kScale, &profile->x[idx],
+                      &profile->y[idx], &profile->brightness[idx], inc);
+  }
+
+  /**
+   * Moves the valid points of the profile to the front of the arrays, in
+   * order, leaving `data_len` as the number of valid points.
+   *
+   * @param stride The step between entries that can hold data.
+   */
+  inline void Compact(uint32_t stride)
+  {
+    if ((0 == data_start) && (1 == stride) &&
+        (data_end == profile->data_len)) {
+      // every entry is valid, nothing to move
+      return;
+    }
+
+    uint32_t len = 0;
+    for (uint32_t n = data_start; n < data_end; n += stride) {
+      // NaN never compares equal to itself
+      if (profile->x[n] == profile->x[n]) {
+        profile->x[len] = profile->x[n];
+        profile->y[len] = profile->y[n];
+        profile->brightness[len] = profile->brightness[n];
+        len++;
+      }
+    }
+
+    profile->data_len = len;
+  }
+
+  inline bool IsEmpty()
+  {
+    return (nullptr == profile) ? true : false;
+  }
+
+  jsProfileSoA *profile;
+  // range of entries that can hold data
+  uint32_t data_start;
+  uint32_t data_end;
 };
 } // namespace joescan
 
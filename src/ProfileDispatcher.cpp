@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileDispatcher.hpp"
+#include "ScanHead.hpp"
+
+using namespace joescan;
+
+ProfileDispatcher::ProfileDispatcher() : m_is_running(false)
+{
+}
+
+ProfileDispatcher::~ProfileDispatcher()
+{
+  Stop();
+}
+
+void ProfileDispatcher::AddScanHead(ScanHead *scan_head)
+{
+  m_scan_heads.push_back(scan_head);
+}
+
+int ProfileDispatcher::Start()
+{
+  m_is_running = true;
+  std::thread thread(&ProfileDispatcher::DispatchMain, this);
+  m_thread = std::move(thread);
+
+  return 0;
+}
+
+void ProfileDispatcher::Stop()
+{
+  m_is_running = false;
+  // `Pending` reports work once stopped so the thread stops waiting
+  Notify();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+
+  m_scan_heads.clear();
+}
+
+void ProfileDispatcher::Notify()
+{
+  m_wakeup.Notify([this]() { return Pending(); });
+}
+
+void ProfileDispatcher::DispatchMain()
+{
+  while (m_is_running) {
+    m_wakeup.WaitFor(1, [this]() { return Pending(); }, kWaitTimeoutUs);
+    while (0 != DispatchAll()) {
+    }
+  }
+
+  // profiles handed over right before stopping still get dispatched
+  while (0 != DispatchAll()) {
+  }
+}
+
+uint32_t ProfileDispatcher::DispatchAll()
+{
+  uint32_t total = 0;
+
+  for (auto const &scan_head : m_scan_heads) {
+    total += scan_head->DispatchProfiles();
+  }
+
+  return total;
+}
+
+uint32_t ProfileDispatcher::Pending() const
+{
+  if (!m_is_running) {
+    return 1;
+  }
+
+  uint32_t total = 0;
+  for (auto const &scan_head : m_scan_heads) {
+    total += scan_head->PendingDispatch();
+  }
+
+  return total;
+}
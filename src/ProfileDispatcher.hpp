@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_DISPATCHER_H
+#define JOESCAN_PROFILE_DISPATCHER_H
+
+#include "ConsumerWakeup.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+class ScanHead;
+
+/**
+ * @brief The `ProfileDispatcher` class runs a single thread that invokes the
+ * profile callbacks registered with any number of scan heads, taking the work
+ * off of the thread receiving their scan data. Scan heads hand completed
+ * profiles over through a lock-free queue and the dispatcher returns them to
+ * the scan head once the callback is done.
+ */
+class ProfileDispatcher {
+ public:
+  ProfileDispatcher();
+  ~ProfileDispatcher();
+
+  /**
+   * Adds a scan head to be serviced. Must be called before `Start`.
+   *
+   * @param scan_head Pointer to the scan head.
+   */
+  void AddScanHead(ScanHead *scan_head);
+
+  /**
+   * Starts the dispatcher thread.
+   *
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int Start();
+
+  /**
+   * Stops the dispatcher thread once every profile handed over has been
+   * dispatched, and forgets all scan heads added to it.
+   */
+  void Stop();
+
+  /**
+   * Wakes up the dispatcher thread. Called by a scan head after handing over
+   * a profile.
+   */
+  void Notify();
+
+ private:
+  // safety net in case a wake up is ever missed
+  static const uint32_t kWaitTimeoutUs = 100000;
+
+  void DispatchMain();
+  uint32_t DispatchAll();
+  uint32_t Pending() const;
+
+  std::vector<ScanHead *> m_scan_heads;
+  ConsumerWakeup m_wakeup;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_PROFILE_DISPATCHER_H
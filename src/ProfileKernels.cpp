@@ -0,0 +1,650 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileKernels.hpp"
+
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define JOESCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows any instruction set to be used without enabling it; GCC and
+// Clang need each function using them to be marked
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET(x) __attribute__((target(x)))
+#else
+#define TARGET(x)
+#endif
+
+using namespace joescan;
+
+// server sends int16_t x/y data points; invalid is int16_t minimum
+static const int16_t kInvalidXY = -32768;
+// points handled per iteration by the vectorized implementations
+static const uint32_t kPointsPerBlock = 8;
+
+/**
+ * Destination storing points into `jsProfileData` elements.
+ */
+struct ProfileDataDst {
+  jsProfileData *data;
+  uint32_t inc;
+
+  inline ProfileDataDst Offset(uint32_t n) const
+  {
+    ProfileDataDst dst = {&data[n * inc], inc};
+    return dst;
+  }
+
+  inline void StorePoint(uint32_t n, int32_t x, int32_t y) const
+  {
+    data[n * inc].x = x;
+    data[n * inc].y = y;
+  }
+
+  inline void StoreBrightness(uint32_t n, uint8_t brightness) const
+  {
+    data[n * inc].brightness = static_cast<int32_t>(brightness);
+  }
+
+  inline void StoreNoBrightness(uint32_t n) const
+  {
+    data[n * inc].brightness = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+  }
+
+  inline void StoreInvalid(uint32_t n) const
+  {
+    data[n * inc].x = JS_PROFILE_DATA_INVALID_XY;
+    data[n * inc].y = JS_PROFILE_DATA_INVALID_XY;
+    data[n * inc].brightness = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+  }
+};
+
+/**
+ * Destination storing points into separate X, Y and brightness arrays.
+ */
+struct ProfileArraysDst {
+  float *x;
+  float *y;
+  uint8_t *brightness;
+  uint32_t inc;
+  float scale;
+
+  inline ProfileArraysDst Offset(uint32_t n) const
+  {
+    ProfileArraysDst dst = {&x[n * inc], &y[n * inc], &brightness[n * inc],
+                            inc, scale};
+    return dst;
+  }
+
+  inline void StorePoint(uint32_t n, int32_t xv, int32_t yv) const
+  {
+    x[n * inc] = static_cast<float>(xv) * scale;
+    y[n * inc] = static_cast<float>(yv) * scale;
+  }
+
+  inline void StoreBrightness(uint32_t n, uint8_t b) const
+  {
+    brightness[n * inc] = b;
+  }
+
+  inline void StoreNoBrightness(uint32_t n) const
+  {
+    brightness[n * inc] = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+  }
+
+  inline void StoreInvalid(uint32_t n) const
+  {
+    x[n * inc] = std::numeric_limits<float>::quiet_NaN();
+    y[n * inc] = std::numeric_limits<float>::quiet_NaN();
+    brightness[n * inc] = JS_PROFILE_DATA_INVALID_BRIGHTNESS;
+  }
+};
+
+/**
+ * Stores a block of already converted points, marking those not set in the
+ * valid mask as invalid.
+ */
+template <typename Dst>
+static inline uint32_t StoreBlock(const int32_t *x, const int32_t *y,
+                                  uint32_t valid, const uint8_t *brightness,
+                                  uint32_t num, const Dst &dst)
+{
+  const uint32_t all = (1 << num) - 1;
+  uint32_t count = 0;
+
+  if (all == valid) {
+    // typical case, avoid testing each point
+    for (uint32_t n = 0; n < num; n++) {
+      dst.StorePoint(n, x[n], y[n]);
+    }
+
+    if (nullptr != brightness) {
+      for (uint32_t n = 0; n < num; n++) {
+        dst.StoreBrightness(n, brightness[n]);
+      }
+    } else {
+      for (uint32_t n = 0; n < num; n++) {
+        dst.StoreNoBrightness(n);
+      }
+    }
+
+    return num;
+  }
+
+  for (uint32_t n = 0; n < num; n++) {
+    if (valid & (1 << n)) {
+      dst.StorePoint(n, x[n], y[n]);
+      if (nullptr != brightness) {
+        dst.StoreBrightness(n, brightness[n]);
+      } else {
+        dst.StoreNoBrightness(n);
+      }
+      count++;
+    } else {
+      dst.StoreInvalid(n);
+    }
+  }
+
+  return count;
+}
+
+template <typename Dst>
+static uint32_t ProcessPointsXYScalar(const uint8_t *xy,
+                                      const uint8_t *brightness, uint32_t num,
+                                      const CameraToMillTransform &t,
+                                      const Dst &dst)
+{
+  uint32_t count = 0;
+
+  for (uint32_t n = 0; n < num; n++) {
+    int16_t x_raw = static_cast<int16_t>((xy[0] << 8) | xy[1]);
+    int16_t y_raw = static_cast<int16_t>((xy[2] << 8) | xy[3]);
+    xy += 4;
+
+    if ((kInvalidXY != x_raw) && (kInvalidXY != y_raw)) {
+      Point2D<int32_t> p = t.Apply(x_raw, y_raw);
+
+      dst.StorePoint(n, p.x, p.y);
+      if (nullptr != brightness) {
+        dst.StoreBrightness(n, brightness[n]);
+      } else {
+        dst.StoreNoBrightness(n);
+      }
+      count++;
+    } else {
+      dst.StoreInvalid(n);
+    }
+  }
+
+  return count;
+}
+
+#ifdef JOESCAN_X86
+/**
+ * Adds a split shift to four values, see `CameraToMillTransform::AddShift`.
+ */
+TARGET("sse4.1")
+static inline __m128i AddShift4(__m128i v, __m128i whole, bool is_frac)
+{
+  __m128i r = _mm_add_epi32(v, whole);
+  if (is_frac) {
+    // comparison yields -1 for negative results, pulling them toward zero
+    r = _mm_sub_epi32(r, _mm_cmpgt_epi32(_mm_setzero_si128(), r));
+  }
+
+  return r;
+}
+
+/**
+ * Divides two Q24 values, truncating toward zero, and packs the results into
+ * the low two 32-bit lanes.
+ */
+TARGET("sse4.1")
+static inline __m128i FromQ24x2(__m128i v)
+{
+  // no 64-bit arithmetic shift; bias negative values so a logical shift
+  // truncates toward zero, the low 32 bits are the same either way
+  const __m128i bias =
+    _mm_set1_epi64x((1 << CameraToMillTransform::kMatrixShift) - 1);
+  __m128i sign =
+    _mm_shuffle_epi32(_mm_srai_epi32(v, 31), _MM_SHUFFLE(3, 3, 1, 1));
+  v = _mm_add_epi64(v, _mm_and_si128(sign, bias));
+  v = _mm_srli_epi64(v, CameraToMillTransform::kMatrixShift);
+
+  return _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * Applies the general Q24 transform to four points.
+ */
+TARGET("sse4.1")
+static inline void Transform4(__m128i x, __m128i y,
+                              const CameraToMillTransform &t, __m128i *x_out,
+                              __m128i *y_out)
+{
+  // multiplies use the low 32 bits of each 64-bit lane
+  const __m128i xx = _mm_set1_epi64x(t.xx);
+  const __m128i xy = _mm_set1_epi64x(t.xy);
+  const __m128i yx = _mm_set1_epi64x(t.yx);
+  const __m128i yy = _mm_set1_epi64x(t.yy);
+  const __m128i sx = _mm_set1_epi64x(t.shift_x);
+  const __m128i sy = _mm_set1_epi64x(t.shift_y);
+  __m128i xm[2];
+  __m128i ym[2];
+
+  for (uint32_t k = 0; k < 2; k++) {
+    __m128i x64 = _mm_cvtepi32_epi64(x);
+    __m128i y64 = _mm_cvtepi32_epi64(y);
+    __m128i xv = _mm_add_epi64(
+      _mm_sub_epi64(_mm_mul_epi32(x64, xx), _mm_mul_epi32(y64, xy)), sx);
+    __m128i yv = _mm_add_epi64(
+      _mm_add_epi64(_mm_mul_epi32(x64, yx), _mm_mul_epi32(y64, yy)), sy);
+
+    xm[k] = FromQ24x2(xv);
+    ym[k] = FromQ24x2(yv);
+    x = _mm_srli_si128(x, 8);
+    y = _mm_srli_si128(y, 8);
+  }
+
+  *x_out = _mm_unpacklo_epi64(xm[0], xm[1]);
+  *y_out = _mm_unpacklo_epi64(ym[0], ym[1]);
+}
+
+template <typename Dst>
+TARGET("sse4.1")
+static uint32_t ProcessPointsXYSse41(const uint8_t *xy,
+                                     const uint8_t *brightness, uint32_t num,
+                                     const CameraToMillTransform &t,
+                                     const Dst &dst)
+{
+  // swaps the bytes of each 16-bit value
+  const __m128i swap = _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5,
+                                    2, 3, 0, 1);
+  const __m128i invalid = _mm_set1_epi32(kInvalidXY);
+  const __m128i sx = _mm_set1_epi32(t.shift_x_whole);
+  const __m128i sy = _mm_set1_epi32(t.shift_y_whole);
+  alignas(16) int32_t x_out[kPointsPerBlock];
+  alignas(16) int32_t y_out[kPointsPerBlock];
+  uint32_t count = 0;
+  uint32_t n = 0;
+
+  for (; (n + kPointsPerBlock) <= num; n += kPointsPerBlock) {
+    uint32_t valid = 0;
+
+    for (uint32_t m = 0; m < kPointsPerBlock; m += 4) {
+      __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(&xy[(n + m) * 4]));
+      // after swapping, each 32-bit lane holds X in the low half and Y in the
+      // high half; shift to sign extend each into its own lane
+      v = _mm_shuffle_epi8(v, swap);
+      __m128i x = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+      __m128i y = _mm_srai_epi32(v, 16);
+
+      __m128i bad = _mm_or_si128(_mm_cmpeq_epi32(x, invalid),
+                                 _mm_cmpeq_epi32(y, invalid));
+      valid |= (~_mm_movemask_ps(_mm_castsi128_ps(bad)) & 0xF) << m;
+
+      switch (t.type) {
+        case AlignmentType::Identity:
+          break;
+        case AlignmentType::YawShift:
+          x = _mm_sub_epi32(_mm_setzero_si128(), x);
+          // fall through
+        case AlignmentType::Shift:
+          x = AddShift4(x, sx, t.is_shift_x_frac);
+          y = AddShift4(y, sy, t.is_shift_y_frac);
+          break;
+        case AlignmentType::General:
+        default:
+          Transform4(x, y, t, &x, &y);
+          break;
+      }
+
+      _mm_store_si128(reinterpret_cast<__m128i *>(&x_out[m]), x);
+      _mm_store_si128(reinterpret_cast<__m128i *>(&y_out[m]), y);
+    }
+
+    count += StoreBlock(x_out, y_out, valid,
+                        (nullptr != brightness) ? &brightness[n] : nullptr,
+                        kPointsPerBlock, dst.Offset(n));
+  }
+
+  count += ProcessPointsXYScalar(
+    &xy[n * 4], (nullptr != brightness) ? &brightness[n] : nullptr, num - n, t,
+    dst.Offset(n));
+
+  return count;
+}
+
+/**
+ * Adds a split shift to eight values, see `CameraToMillTransform::AddShift`.
+ */
+TARGET("avx2")
+static inline __m256i AddShift8(__m256i v, __m256i whole, bool is_frac)
+{
+  __m256i r = _mm256_add_epi32(v, whole);
+  if (is_frac) {
+    // comparison yields -1 for negative results, pulling them toward zero
+    r = _mm256_sub_epi32(r, _mm256_cmpgt_epi32(_mm256_setzero_si256(), r));
+  }
+
+  return r;
+}
+
+/**
+ * Divides four Q24 values, truncating toward zero, and packs the results.
+ */
+TARGET("avx2")
+static inline __m128i FromQ24x4(__m256i v)
+{
+  // no 64-bit arithmetic shift; bias negative values so a logical shift
+  // truncates toward zero, the low 32 bits are the same either way
+  const __m256i bias =
+    _mm256_set1_epi64x((1 << CameraToMillTransform::kMatrixShift) - 1);
+  const __m256i pack = _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0);
+  __m256i sign =
+    _mm256_shuffle_epi32(_mm256_srai_epi32(v, 31), _MM_SHUFFLE(3, 3, 1, 1));
+  v = _mm256_add_epi64(v, _mm256_and_si256(sign, bias));
+  v = _mm256_srli_epi64(v, CameraToMillTransform::kMatrixShift);
+
+  return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, pack));
+}
+
+/**
+ * Applies the general Q24 transform to eight points.
+ */
+TARGET("avx2")
+static inline void Transform8(__m256i x, __m256i y,
+                              const CameraToMillTransform &t, __m256i *x_out,
+                              __m256i *y_out)
+{
+  // multiplies use the low 32 bits of each 64-bit lane
+  const __m256i xx = _mm256_set1_epi64x(t.xx);
+  const __m256i xy = _mm256_set1_epi64x(t.xy);
+  const __m256i yx = _mm256_set1_epi64x(t.yx);
+  const __m256i yy = _mm256_set1_epi64x(t.yy);
+  const __m256i sx = _mm256_set1_epi64x(t.shift_x);
+  const __m256i sy = _mm256_set1_epi64x(t.shift_y);
+  __m128i xm[2];
+  __m128i ym[2];
+
+  for (uint32_t k = 0; k < 2; k++) {
+    __m128i x4 = (0 == k) ? _mm256_castsi256_si128(x)
+                          : _mm256_extracti128_si256(x, 1);
+    __m128i y4 = (0 == k) ? _mm256_castsi256_si128(y)
+                          : _mm256_extracti128_si256(y, 1);
+    __m256i x64 = _mm256_cvtepi32_epi64(x4);
+    __m256i y64 = _mm256_cvtepi32_epi64(y4);
+    __m256i xv = _mm256_add_epi64(
+      _mm256_sub_epi64(_mm256_mul_epi32(x64, xx), _mm256_mul_epi32(y64, xy)),
+      sx);
+    __m256i yv = _mm256_add_epi64(
+      _mm256_add_epi64(_mm256_mul_epi32(x64, yx), _mm256_mul_epi32(y64, yy)),
+      sy);
+
+    xm[k] = FromQ24x4(xv);
+    ym[k] = FromQ24x4(yv);
+  }
+
+  *x_out = _mm256_inserti128_si256(_mm256_castsi128_si256(xm[0]), xm[1], 1);
+  *y_out = _mm256_inserti128_si256(_mm256_castsi128_si256(ym[0]), ym[1], 1);
+}
+
+template <typename Dst>
+TARGET("avx2")
+static uint32_t ProcessPointsXYAvx2(const uint8_t *xy,
+                                    const uint8_t *brightness, uint32_t num,
+                                    const CameraToMillTransform &t,
+                                    const Dst &dst)
+{
+  // swaps the bytes of each 16-bit value; shuffle works within 128-bit halves
+  const __m256i swap = _mm256_set_epi8(
+    14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+    14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+  const __m256i invalid = _mm256_set1_epi32(kInvalidXY);
+  const __m256i sx = _mm256_set1_epi32(t.shift_x_whole);
+  const __m256i sy = _mm256_set1_epi32(t.shift_y_whole);
+  alignas(32) int32_t x_out[kPointsPerBlock];
+  alignas(32) int32_t y_out[kPointsPerBlock];
+  uint32_t count = 0;
+  uint32_t n = 0;
+
+  for (; (n + kPointsPerBlock) <= num; n += kPointsPerBlock) {
+    __m256i v =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&xy[n * 4]));
+    // after swapping, each 32-bit lane holds X in the low half and Y in the
+    // high half; shift to sign extend each into its own lane
+    v = _mm256_shuffle_epi8(v, swap);
+    __m256i x = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+    __m256i y = _mm256_srai_epi32(v, 16);
+
+    __m256i bad = _mm256_or_si256(_mm256_cmpeq_epi32(x, invalid),
+                                  _mm256_cmpeq_epi32(y, invalid));
+    uint32_t valid = ~_mm256_movemask_ps(_mm256_castsi256_ps(bad)) & 0xFF;
+    if (0 == valid) {
+      // nothing to convert, the points only need marking invalid
+      StoreBlock(x_out, y_out, valid, nullptr, kPointsPerBlock,
+                 dst.Offset(n));
+      continue;
+    }
+
+    switch (t.type) {
+      case AlignmentType::Identity:
+        break;
+      case AlignmentType::YawShift:
+        x = _mm256_sub_epi32(_mm256_setzero_si256(), x);
+        // fall through
+      case AlignmentType::Shift:
+        x = AddShift8(x, sx, t.is_shift_x_frac);
+        y = AddShift8(y, sy, t.is_shift_y_frac);
+        break;
+      case AlignmentType::General:
+      default:
+        Transform8(x, y, t, &x, &y);
+        break;
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i *>(x_out), x);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(y_out), y);
+
+    count += StoreBlock(x_out, y_out, valid,
+                        (nullptr != brightness) ? &brightness[n] : nullptr,
+                        kPointsPerBlock, dst.Offset(n));
+  }
+
+  count += ProcessPointsXYScalar(
+    &xy[n * 4], (nullptr != brightness) ? &brightness[n] : nullptr, num - n, t,
+    dst.Offset(n));
+
+  return count;
+}
+
+static bool IsAvx2Supported()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (7 > info[0]) {
+    return false;
+  }
+
+  // OS must save the upper halves of the AVX registers on context switch
+  __cpuid(info, 1);
+  const int osxsave_avx = (1 << 27) | (1 << 28);
+  if ((osxsave_avx != (info[2] & osxsave_avx)) ||
+      (0x6 != (_xgetbv(0) & 0x6))) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (0 != (info[1] & (1 << 5)));
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool IsSse41Supported()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (0 != (info[2] & (1 << 19)));
+#else
+  return __builtin_cpu_supports("sse4.1");
+#endif
+}
+#endif // JOESCAN_X86
+
+template <typename Dst>
+struct ProcessPointsXYFn {
+  typedef uint32_t (*Type)(const uint8_t *, const uint8_t *, uint32_t,
+                           const CameraToMillTransform &, const Dst &);
+};
+
+template <typename Dst>
+static typename ProcessPointsXYFn<Dst>::Type GetProcessPointsXY(KernelIsa isa)
+{
+  switch (isa) {
+#ifdef JOESCAN_X86
+    case KernelIsa::Avx2:
+      return ProcessPointsXYAvx2<Dst>;
+    case KernelIsa::Sse41:
+      return ProcessPointsXYSse41<Dst>;
+#endif
+    case KernelIsa::Scalar:
+    default:
+      break;
+  }
+
+  return ProcessPointsXYScalar<Dst>;
+}
+
+static KernelIsa SelectKernelIsa()
+{
+  if (IsKernelIsaSupported(KernelIsa::Avx2)) {
+    return KernelIsa::Avx2;
+  }
+
+  if (IsKernelIsaSupported(KernelIsa::Sse41)) {
+    return KernelIsa::Sse41;
+  }
+
+  return KernelIsa::Scalar;
+}
+
+bool joescan::IsKernelIsaSupported(KernelIsa isa)
+{
+  switch (isa) {
+#ifdef JOESCAN_X86
+    case KernelIsa::Avx2:
+      return IsAvx2Supported();
+    case KernelIsa::Sse41:
+      return IsSse41Supported();
+#endif
+    case KernelIsa::Scalar:
+      return true;
+    default:
+      break;
+  }
+
+  return false;
+}
+
+uint32_t joescan::ProcessPointsXY(const uint8_t *xy, const uint8_t *brightness,
+                                  uint32_t num, const CameraToMillTransform &t,
+                                  jsProfileData *dst, uint32_t inc)
+{
+  static const ProcessPointsXYFn<ProfileDataDst>::Type fn =
+    GetProcessPointsXY<ProfileDataDst>(SelectKernelIsa());
+  const ProfileDataDst d = {dst, inc};
+
+  return fn(xy, brightness, num, t, d);
+}
+
+uint32_t joescan::ProcessPointsXY(const uint8_t *xy, const uint8_t *brightness,
+                                  uint32_t num, const CameraToMillTransform &t,
+                                  float scale, float *x_dst, float *y_dst,
+                                  uint8_t *brightness_dst, uint32_t inc)
+{
+  static const ProcessPointsXYFn<ProfileArraysDst>::Type fn =
+    GetProcessPointsXY<ProfileArraysDst>(SelectKernelIsa());
+  const ProfileArraysDst d = {x_dst, y_dst, brightness_dst, inc, scale};
+
+  return fn(xy, brightness, num, t, d);
+}
+
+uint32_t joescan::ProcessPointsXY(KernelIsa isa, const uint8_t *xy,
+                                  const uint8_t *brightness, uint32_t num,
+                                  const CameraToMillTransform &t,
+                                  jsProfileData *dst, uint32_t inc)
+{
+  const ProfileDataDst d = {dst, inc};
+  return GetProcessPointsXY<ProfileDataDst>(isa)(xy, brightness, num, t, d);
+}
+
+uint32_t joescan::ProcessPointsXY(KernelIsa isa, const uint8_t *xy,
+                                  const uint8_t *brightness, uint32_t num,
+                                  const CameraToMillTransform &t, float scale,
+                                  float *x_dst, float *y_dst,
+                                  uint8_t *brightness_dst, uint32_t inc)
+{
+  const ProfileArraysDst d = {x_dst, y_dst, brightness_dst, inc, scale};
+  return GetProcessPointsXY<ProfileArraysDst>(isa)(xy, brightness, num, t, d);
+}
+
+void joescan::CopyProfileCompacted(const jsRawProfile *src, jsProfile *dst)
+{
+  dst->scan_head_id = src->scan_head_id;
+  dst->camera = src->camera;
+  dst->laser = src->laser;
+  dst->timestamp_ns = src->timestamp_ns;
+  dst->flags = src->flags;
+  dst->sequence_number = src->sequence_number;
+  dst->laser_on_time_us = src->laser_on_time_us;
+  dst->format = src->format;
+  dst->packets_received = src->packets_received;
+  dst->packets_expected = src->packets_expected;
+  dst->gap_profiles = src->gap_profiles;
+  dst->num_encoder_values = src->num_encoder_values;
+  memcpy(dst->encoder_values, src->encoder_values,
+         src->num_encoder_values * sizeof(uint64_t));
+
+  if (src->data_len == src->data_valid_xy) {
+    // every entry is valid, as is the case for compacted profiles
+    memcpy(dst->data, src->data, src->data_len * sizeof(jsProfileData));
+    dst->data_len = src->data_len;
+    return;
+  }
+
+  uint32_t stride = 1;
+  if ((JS_DATA_FORMAT_XY_BRIGHTNESS_HALF == src->format) ||
+      (JS_DATA_FORMAT_XY_HALF == src->format)) {
+    stride = 2;
+  } else if ((JS_DATA_FORMAT_XY_BRIGHTNESS_QUARTER == src->format) ||
+             (JS_DATA_FORMAT_XY_QUARTER == src->format)) {
+    stride = 4;
+  }
+
+  uint32_t len = 0;
+  for (uint32_t n = 0; n < src->data_len; n += stride) {
+    if ((JS_PROFILE_DATA_INVALID_XY != src->data[n].x) ||
+        (JS_PROFILE_DATA_INVALID_XY != src->data[n].y)) {
+      // Note: Only need to check X/Y since we only support data types with
+      // X/Y coordinates alone or X/Y coordinates with brightness.
+      dst->data[len++] = src->data[n];
+    }
+  }
+  dst->data_len = len;
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_KERNELS_H
+#define JOESCAN_PROFILE_KERNELS_H
+
+#include <cstdint>
+
+#include "AlignmentParams.hpp"
+#include "joescan_pinchot.h"
+
+namespace joescan {
+
+/**
+ * Converts X/Y points sent by the scan head into mill coordinates and stores
+ * them into profile data. Points are sent as big-endian `int16_t` pairs, with
+ * either value being `int16_t` minimum marking the point as invalid. Invalid
+ * points are stored with `JS_PROFILE_DATA_INVALID_XY` and
+ * `JS_PROFILE_DATA_INVALID_BRIGHTNESS`, as is the brightness of every point if
+ * brightness was not sent, so nothing is left over from earlier use of the
+ * destination.
+ *
+ * On x86, the fastest implementation supported by the CPU (AVX2, SSE4.1, or
+ * plain C++) is selected the first time this is called. All implementations
+ * use the fixed point transform and produce bit identical results to
+ * `AlignmentParams::CameraToMill`, skipping the matrix for alignments that
+ * only shift or mirror points.
+ *
+ * @param xy Pointer to the X/Y pairs as received.
+ * @param brightness Pointer to brightness values, one per point, or `nullptr`
+ * if brightness was not sent.
+ * @param num The number of points.
+ * @param t The camera to mill transform to apply.
+ * @param dst Pointer to where the first point is stored.
+ * @param inc The number of `jsProfileData` elements between points in `dst`.
+ * @return The number of valid points stored.
+ */
+uint32_t ProcessPointsXY(const uint8_t *xy, const uint8_t *brightness,
+                         uint32_t num, const CameraToMillTransform &t,
+                         jsProfileData *dst, uint32_t inc);
+
+/**
+ * Same as above, but stores points into separate X, Y and brightness arrays,
+ * with X and Y scaled into floating point. Invalid points are stored with NaN
+ * X and Y values.
+ *
+ * @param xy Pointer to the X/Y pairs as received.
+ * @param brightness Pointer to brightness values, one per point, or `nullptr`
+ * if brightness was not sent.
+ * @param num The number of points.
+ * @param t The camera to mill transform to apply.
+ * @param scale Factor to multiply the converted X and Y values by.
+ * @param x_dst Pointer to where the first X value is stored.
+ * @param y_dst Pointer to where the first Y value is stored.
+ * @param brightness_dst Pointer to where the first brightness value is stored.
+ * @param inc The number of elements between points in the destinations.
+ * @return The number of valid points stored.
+ */
+uint32_t ProcessPointsXY(const uint8_t *xy, const uint8_t *brightness,
+                         uint32_t num, const CameraToMillTransform &t,
+                         float scale, float *x_dst, float *y_dst,
+                         uint8_t *brightness_dst, uint32_t inc);
+
+/**
+ * @brief Implementations of `ProcessPointsXY`, so that a particular one can be
+ * run rather than the fastest the CPU supports.
+ */
+enum class KernelIsa {
+  // plain C++, always supported
+  Scalar,
+  // x86 SSE4.1
+  Sse41,
+  // x86 AVX2
+  Avx2,
+};
+
+/**
+ * Checks if an implementation of `ProcessPointsXY` can run on this CPU.
+ *
+ * @param isa The implementation to check.
+ * @return Boolean `true` if supported, `false` otherwise.
+ */
+bool IsKernelIsaSupported(KernelIsa isa);
+
+/**
+ * Same as `ProcessPointsXY` storing into profile data, but always using the
+ * given implementation. Used to check implementations against each other.
+ *
+ * @param isa The implementation to use; must be supported by the CPU.
+ */
+uint32_t ProcessPointsXY(KernelIsa isa, const uint8_t *xy,
+                         const uint8_t *brightness, uint32_t num,
+                         const CameraToMillTransform &t, jsProfileData *dst,
+                         uint32_t inc);
+
+/**
+ * Same as `ProcessPointsXY` storing into separate arrays, but always using the
+ * given implementation. Used to check implementations against each other.
+ *
+ * @param isa The implementation to use; must be supported by the CPU.
+ */
+uint32_t ProcessPointsXY(KernelIsa isa, const uint8_t *xy,
+                         const uint8_t *brightness, uint32_t num,
+                         const CameraToMillTransform &t, float scale,
+                         float *x_dst, float *y_dst, uint8_t *brightness_dst,
+                         uint32_t inc);
+
+/**
+ * Copies a profile out to a user's `jsProfile`, moving the valid points to
+ * the start of the data array. Profiles with only valid points, such as those
+ * compacted while being assembled, are copied as is.
+ *
+ * @param src The profile to copy.
+ * @param dst The profile to copy into.
+ */
+void CopyProfileCompacted(const jsRawProfile *src, jsProfile *dst);
+
+} // namespace joescan
+
+#endif // JOESCAN_PROFILE_KERNELS_H
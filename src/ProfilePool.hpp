@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_POOL_H
+#define JOESCAN_PROFILE_POOL_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "SpscQueue.hpp"
+#include "joescan_pinchot.h"
+
+namespace joescan {
+
+/**
+ * @brief The `ProfilePool` class holds a fixed number of preallocated
+ * profile objects, typically `jsRawProfile`. Profiles are taken from the pool
+ * when assembly of a new profile begins and are returned once the consumer is
+ * done with them, so that no heap allocations are made while scanning.
+ *
+ * The pool is lock-free: `Acquire` and `Recycle` may only be called from the
+ * thread assembling profiles, while `Release` may only be called by one
+ * consumer thread at a time.
+ */
+template <typename T>
+class ProfilePool {
+ public:
+  /**
+   * Initializes a `ProfilePool` object.
+   *
+   * @param capacity The total number of profiles to preallocate.
+   */
+  ProfilePool(uint32_t capacity);
+
+  /**
+   * Reallocates the pool to hold a new number of profiles. Must only be
+   * called once every profile has been returned and no thread is using the
+   * pool; the pool is left unchanged if allocation fails.
+   *
+   * @param capacity The total number of profiles to preallocate.
+   */
+  void Reset(uint32_t capacity);
+
+  /**
+   * Takes a free profile from the pool. Producer only.
+   *
+   * @return Pointer to a free profile or `nullptr` if the pool is exhausted.
+   */
+  T *Acquire();
+
+  /**
+   * Returns a profile previously obtained with `Acquire` back to the pool.
+   * Consumer only.
+   *
+   * @param profile Pointer to the profile to return.
+   */
+  void Release(T *profile);
+
+  /**
+   * Returns a profile that never made it to the consumer back to the pool.
+   * Producer only.
+   *
+   * @param profile Pointer to the profile to return.
+   */
+  void Recycle(T *profile);
+
+  /**
+   * Gets the total number of profiles held by the pool.
+   *
+   * @return The pool capacity.
+   */
+  uint32_t GetCapacity() const;
+
+  /**
+   * Gets the number of profiles currently taken from the pool.
+   *
+   * @return The number of profiles in use.
+   */
+  uint32_t GetInUse() const;
+
+  /**
+   * Gets the largest number of profiles that have been in use at once since
+   * the last call to `ResetStatistics`.
+   *
+   * @return The high water mark of the pool.
+   */
+  uint32_t GetHighWaterMark() const;
+
+  /**
+   * Gets the number of times `Acquire` failed due to the pool being empty
+   * since the last call to `ResetStatistics`.
+   *
+   * @return The number of failed acquisitions.
+   */
+  uint64_t GetExhaustedCount() const;
+
+  /**
+   * Resets the high water mark and exhausted count of the pool.
+   */
+  void ResetStatistics();
+
+  /**
+   * Checks if a profile is part of the storage held by the pool. Pointers
+   * into the middle of a profile are not considered part of the pool.
+   *
+   * @param profile Pointer to the profile to check.
+   * @return Boolean `true` if the profile belongs to the pool.
+   */
+  bool IsFromPool(const T *profile) const;
+
+  /**
+   * Gets the position of a profile within the storage held by the pool, for
+   * callers keeping their own bookkeeping alongside each profile.
+   *
+   * @param profile Pointer to a profile belonging to the pool.
+   * @return Index of the profile, less than `GetCapacity`.
+   */
+  uint32_t IndexOf(const T *profile) const;
+
+ private:
+  std::unique_ptr<T[]> m_profiles;
+  // profiles handed back by the consumer
+  SpscQueue<T *> m_free;
+  // profiles recycled by the producer, only touched by the producer
+  std::vector<T *> m_recycled;
+  uint32_t m_capacity;
+  std::atomic<uint32_t> m_in_use;
+  std::atomic<uint32_t> m_high_water;
+  std::atomic<uint64_t> m_exhausted;
+};
+
+template <typename T>
+ProfilePool<T>::ProfilePool(uint32_t capacity)
+  : m_free(capacity),
+    m_capacity(capacity),
+    m_in_use(0),
+    m_high_water(0),
+    m_exhausted(0)
+{
+  // NOTE: array is default initialized on purpose; profile data is written
+  // when assembly begins so there is no need to touch the memory up front
+  m_profiles.reset(new T[capacity]);
+  m_recycled.reserve(capacity);
+
+  for (uint32_t n = 0; n < capacity; n++) {
+    m_free.Push(&m_profiles[n]);
+  }
+}
+
+template <typename T>
+void ProfilePool<T>::Reset(uint32_t capacity)
+{
+  assert(0 == GetInUse());
+
+  std::unique_ptr<T[]> profiles(new T[capacity]);
+  m_recycled.reserve(capacity);
+  m_free.Reset(capacity);
+
+  m_profiles = std::move(profiles);
+  m_recycled.clear();
+  m_capacity = capacity;
+  m_in_use.store(0, std::memory_order_relaxed);
+  m_high_water.store(0, std::memory_order_relaxed);
+  m_exhausted.store(0, std::memory_order_relaxed);
+
+  for (uint32_t n = 0; n < capacity; n++) {
+    m_free.Push(&m_profiles[n]);
+  }
+}
+
+template <typename T>
+T *ProfilePool<T>::Acquire()
+{
+  T *profile = nullptr;
+
+  if (!m_recycled.empty()) {
+    profile = m_recycled.back();
+    m_recycled.pop_back();
+  } else if (!m_free.Pop(&profile)) {
+    m_exhausted.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  uint32_t in_use = m_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (in_use > m_high_water.load(std::memory_order_relaxed)) {
+    m_high_water.store(in_use, std::memory_order_relaxed);
+  }
+
+  return profile;
+}
+
+template <typename T>
+void ProfilePool<T>::Release(T *profile)
+{
+  if (nullptr == profile) {
+    return;
+  }
+
+  assert(IsFromPool(profile));
+
+  m_in_use.fetch_sub(1, std::memory_order_relaxed);
+  // queue holds every profile of the pool, can never be full
+  m_free.Push(profile);
+}
+
+template <typename T>
+void ProfilePool<T>::Recycle(T *profile)
+{
+  if (nullptr == profile) {
+    return;
+  }
+
+  assert(IsFromPool(profile));
+
+  m_in_use.fetch_sub(1, std::memory_order_relaxed);
+  // vector never grows beyond capacity reserved in constructor
+  m_recycled.push_back(profile);
+}
+
+template <typename T>
+uint32_t ProfilePool<T>::GetCapacity() const
+{
+  return m_capacity;
+}
+
+template <typename T>
+uint32_t ProfilePool<T>::GetInUse() const
+{
+  return m_in_use.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+uint32_t ProfilePool<T>::GetHighWaterMark() const
+{
+  return m_high_water.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+uint64_t ProfilePool<T>::GetExhaustedCount() const
+{
+  return m_exhausted.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+void ProfilePool<T>::ResetStatistics()
+{
+  m_high_water.store(m_in_use.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  m_exhausted.store(0, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool ProfilePool<T>::IsFromPool(const T *profile) const
+{
+  if ((profile < &m_profiles[0]) || (profile >= &m_profiles[m_capacity])) {
+    return false;
+  }
+
+  // must point to the start of a profile, not somewhere inside of one
+  const uintptr_t offset = reinterpret_cast<uintptr_t>(profile) -
+                           reinterpret_cast<uintptr_t>(&m_profiles[0]);
+  return (0 == (offset % sizeof(T)));
+}
+
+template <typename T>
+uint32_t ProfilePool<T>::IndexOf(const T *profile) const
+{
+  assert(IsFromPool(profile));
+
+  return static_cast<uint32_t>(profile - &m_profiles[0]);
+}
+
+} // namespace joescan
+
+#endif // JOESCAN_PROFILE_POOL_H
@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileResampler.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace joescan;
+
+ProfileResampler::ProfileResampler()
+  : m_held(nullptr),
+    m_position(0),
+    m_has_position(false),
+    m_ticks(0),
+    m_encoder(JS_ENCODER_MAIN),
+    m_mode(JS_RESAMPLE_MODE_NEAREST),
+    m_is_column_indexed(true),
+    m_dropped(0)
+{
+}
+
+void ProfileResampler::Configure(jsEncoder encoder, uint32_t ticks_per_slice,
+                                 jsResampleMode mode, bool is_column_indexed)
+{
+  m_held = nullptr;
+  m_has_position = false;
+  m_ticks = ticks_per_slice;
+  m_encoder = encoder;
+  m_mode = mode;
+  m_is_column_indexed = is_column_indexed;
+}
+
+jsRawProfile *ProfileResampler::Add(jsRawProfile *profile,
+                                    jsRawProfile **dropped)
+{
+  *dropped = nullptr;
+
+  if ((0 == m_ticks) ||
+      (static_cast<uint32_t>(m_encoder) >= profile->num_encoder_values)) {
+    // nothing to resample by, pass the profile through
+    return profile;
+  }
+
+  int64_t position = profile->encoder_values[m_encoder];
+  if (!m_has_position) {
+    m_held = profile;
+    m_position = position;
+    m_has_position = true;
+    return nullptr;
+  }
+
+  int64_t slice = Slice(position);
+  int64_t slice_last = Slice(m_position);
+  if (slice == slice_last) {
+    // no boundary crossed; the new profile is closer to the next boundary
+    // in the direction of travel than the one held
+    if (nullptr != m_held) {
+      *dropped = m_held;
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      // profiles gated out ahead of the dropped one are now ahead of this one
+      profile->gap_profiles += m_held->gap_profiles;
+    }
+    m_held = profile;
+    m_position = position;
+    return nullptr;
+  }
+
+  // if several boundaries were crossed, profiles are spaced further apart
+  // than a slice; resample at the boundary closest to the new profile
+  int64_t boundary = (slice > slice_last) ? slice * m_ticks :
+                                            (slice + 1) * m_ticks;
+  jsRawProfile *out = nullptr;
+
+  if (nullptr == m_held) {
+    // profile before the boundary already went out for the last slice
+    out = profile;
+  } else if ((JS_RESAMPLE_MODE_LINEAR == m_mode) && m_is_column_indexed) {
+    // the held profile is written over, it is not needed past this slice
+    Interpolate(m_held, profile, boundary);
+    out = m_held;
+    m_held = profile;
+  } else if (std::llabs(boundary - m_position) <=
+             std::llabs(position - boundary)) {
+    out = m_held;
+    m_held = profile;
+  } else {
+    *dropped = m_held;
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    profile->gap_profiles += m_held->gap_profiles;
+    out = profile;
+    m_held = nullptr;
+  }
+
+  m_position = position;
+
+  return out;
+}
+
+jsRawProfile *ProfileResampler::Clear()
+{
+  jsRawProfile *held = m_held;
+
+  m_held = nullptr;
+  m_has_position = false;
+
+  return held;
+}
+
+uint64_t ProfileResampler::GetDroppedCount() const
+{
+  return m_dropped.load(std::memory_order_relaxed);
+}
+
+void ProfileResampler::ResetStatistics()
+{
+  m_dropped.store(0, std::memory_order_relaxed);
+}
+
+int64_t ProfileResampler::Slice(int64_t position) const
+{
+  // round towards negative infinity so slices are evenly sized across zero
+  return (0 <= position) ? position / m_ticks :
+                           -((m_ticks - 1 - position) / m_ticks);
+}
+
+void ProfileResampler::Interpolate(jsRawProfile *dst, const jsRawProfile *next,
+                                   int64_t boundary)
+{
+  const int64_t position = dst->encoder_values[m_encoder];
+  const int64_t span = next->encoder_values[m_encoder] - position;
+  // span can't be zero, the profiles are in different slices
+  const double t = static_cast<double>(boundary - position) / span;
+  const bool is_next_nearer = (0.5 < t);
+
+  const uint32_t len =
+    (dst->data_len > next->data_len) ? dst->data_len : next->data_len;
+  uint32_t valid_xy = 0;
+  uint32_t valid_brightness = 0;
+
+  for (uint32_t n = 0; n < len; n++) {
+    jsProfileData a = {JS_PROFILE_DATA_INVALID_XY, JS_PROFILE_DATA_INVALID_XY,
+                       JS_PROFILE_DATA_INVALID_BRIGHTNESS};
+    jsProfileData b = a;
+    // entries past `data_len` are undefined
+    if (n < dst->data_len) {
+      a = dst->data[n];
+    }
+    if (n < next->data_len) {
+      b = next->data[n];
+    }
+
+    jsProfileData p = is_next_nearer ? b : a;
+    if ((JS_PROFILE_DATA_INVALID_XY != a.x) &&
+        (JS_PROFILE_DATA_INVALID_XY != b.x)) {
+      p.x = a.x + static_cast<int32_t>(std::lround(t * (b.x - int64_t(a.x))));
+      p.y = a.y + static_cast<int32_t>(std::lround(t * (b.y - int64_t(a.y))));
+    }
+    if ((JS_PROFILE_DATA_INVALID_BRIGHTNESS != a.brightness) &&
+        (JS_PROFILE_DATA_INVALID_BRIGHTNESS != b.brightness)) {
+      p.brightness = a.brightness +
+        static_cast<int32_t>(std::lround(t * (b.brightness - a.brightness)));
+    }
+
+    if (JS_PROFILE_DATA_INVALID_XY != p.x) {
+      valid_xy++;
+    }
+    if (JS_PROFILE_DATA_INVALID_BRIGHTNESS != p.brightness) {
+      valid_brightness++;
+    }
+    dst->data[n] = p;
+  }
+
+  dst->data_len = len;
+  dst->data_valid_xy = valid_xy;
+  dst->data_valid_brightness = valid_brightness;
+
+  uint64_t ts = dst->timestamp_ns;
+  int64_t ts_delta = static_cast<int64_t>(next->timestamp_ns - ts);
+  dst->timestamp_ns = ts + std::llround(t * ts_delta);
+
+  for (uint32_t n = 0; n < dst->num_encoder_values; n++) {
+    int64_t delta = next->encoder_values[n] - dst->encoder_values[n];
+    dst->encoder_values[n] += std::llround(t * delta);
+  }
+  dst->encoder_values[m_encoder] = boundary;
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_RESAMPLER_H
+#define JOESCAN_PROFILE_RESAMPLER_H
+
+#include "joescan_pinchot.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace joescan {
+
+/**
+ * @brief The `ProfileResampler` class turns the profiles of one camera and
+ * laser pair, taken at uneven spacing as the conveyor speed varies, into one
+ * profile per fixed number of encoder ticks. Slices are aligned to multiples
+ * of the tick count so that every scan head resampling with the same spacing
+ * produces profiles at the same positions.
+ *
+ * The last profile taken is held until the next one shows whether it is the
+ * nearest to a slice boundary; profiles that are not the nearest to any
+ * boundary are dropped. Only the thread assembling profiles may use the
+ * resampler, apart from reading the statistics.
+ */
+class ProfileResampler {
+ public:
+  ProfileResampler();
+
+  /**
+   * Sets how profiles are resampled. Must only be called when no profile is
+   * held, such as after `Clear`.
+   *
+   * @param encoder The encoder whose values profiles are resampled by.
+   * @param ticks_per_slice Encoder ticks between output profiles or `0` to
+   * pass all profiles through.
+   * @param mode How a profile is produced for each slice.
+   * @param is_column_indexed Boolean `true` if profile data is held at the
+   * index of its camera column, allowing profiles to be interpolated.
+   */
+  void Configure(jsEncoder encoder, uint32_t ticks_per_slice,
+                 jsResampleMode mode, bool is_column_indexed);
+
+  /**
+   * Adds the next profile assembled for the camera and laser pair.
+   *
+   * @param profile Pointer to the newly assembled profile.
+   * @param dropped Pointer to be set to a profile no longer needed, which the
+   * caller must return to the pool, or `nullptr`.
+   * @return Pointer to the profile for a slice boundary just crossed or
+   * `nullptr` if no profile is ready.
+   */
+  jsRawProfile *Add(jsRawProfile *profile, jsRawProfile **dropped);
+
+  /**
+   * Forgets the resampling position and gives up the profile held, if any.
+   *
+   * @return Pointer to the profile held, to be returned to the pool, or
+   * `nullptr`.
+   */
+  jsRawProfile *Clear();
+
+  uint64_t GetDroppedCount() const;
+  void ResetStatistics();
+
+ private:
+  int64_t Slice(int64_t position) const;
+  void Interpolate(jsRawProfile *dst, const jsRawProfile *next,
+                   int64_t boundary);
+
+  // profile taken last, unless it already went out for a slice
+  jsRawProfile *m_held;
+  // encoder position of the profile taken last
+  int64_t m_position;
+  bool m_has_position;
+  int64_t m_ticks;
+  jsEncoder m_encoder;
+  jsResampleMode m_mode;
+  bool m_is_column_indexed;
+  std::atomic<uint64_t> m_dropped;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_PROFILE_RESAMPLER_H
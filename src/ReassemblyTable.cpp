@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ReassemblyTable.hpp"
+
+using namespace joescan;
+
+ReassemblyTable::ReassemblyTable()
+  : m_last_slot(nullptr),
+    m_in_use(0),
+    m_packet_count(0),
+    m_completed(0),
+    m_evicted(0),
+    m_reordered(0)
+{
+  for (uint32_t n = 0; n < kMaxSlots; n++) {
+    m_slots[n].is_in_use = false;
+  }
+}
+
+ReassemblyTable::Slot *ReassemblyTable::Find(uint32_t source,
+                                             uint64_t timestamp)
+{
+  // fast path, most packets belong to the same profile as the last one
+  if ((nullptr != m_last_slot) && m_last_slot->is_in_use &&
+      (source == m_last_slot->source) &&
+      (timestamp == m_last_slot->timestamp)) {
+    return m_last_slot;
+  }
+
+  if (0 == m_in_use) {
+    return nullptr;
+  }
+
+  for (uint32_t n = 0; n < kMaxSlots; n++) {
+    Slot *slot = &m_slots[n];
+    if (slot->is_in_use && (source == slot->source) &&
+        (timestamp == slot->timestamp)) {
+      return slot;
+    }
+  }
+
+  return nullptr;
+}
+
+ReassemblyTable::Slot *ReassemblyTable::FindStale()
+{
+  if (0 == m_in_use) {
+    return nullptr;
+  }
+
+  for (uint32_t n = 0; n < kMaxSlots; n++) {
+    Slot *slot = &m_slots[n];
+    if (slot->is_in_use &&
+        (kMaxAgePackets < (m_packet_count - slot->last_packet))) {
+      return slot;
+    }
+  }
+
+  return nullptr;
+}
+
+ReassemblyTable::Slot *ReassemblyTable::FindOldest()
+{
+  Slot *oldest = nullptr;
+
+  for (uint32_t n = 0; n < kMaxSlots; n++) {
+    Slot *slot = &m_slots[n];
+    if (!slot->is_in_use) {
+      continue;
+    }
+
+    if ((nullptr == oldest) || (slot->last_packet < oldest->last_packet)) {
+      oldest = slot;
+    }
+  }
+
+  return oldest;
+}
+
+ReassemblyTable::Slot *ReassemblyTable::Insert(uint32_t source,
+                                               uint64_t timestamp,
+                                               uint32_t packets_expected)
+{
+  if (kMaxSlots == m_in_use) {
+    return nullptr;
+  }
+
+  for (uint32_t n = 0; n < kMaxSlots; n++) {
+    Slot *slot = &m_slots[n];
+    if (!slot->is_in_use) {
+      slot->is_in_use = true;
+      slot->source = source;
+      slot->timestamp = timestamp;
+      slot->packets_received = 0;
+      slot->packets_expected = packets_expected;
+      slot->last_packet = m_packet_count;
+      m_in_use++;
+      return slot;
+    }
+  }
+
+  return nullptr;
+}
+
+bool ReassemblyTable::AddPacket(Slot *slot)
+{
+  if ((slot != m_last_slot) && (0 != slot->packets_received)) {
+    m_reordered.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  m_last_slot = slot;
+  slot->last_packet = ++m_packet_count;
+  slot->packets_received++;
+
+  return (slot->packets_received >= slot->packets_expected);
+}
+
+void ReassemblyTable::Remove(Slot *slot, bool is_complete)
+{
+  if (is_complete) {
+    m_completed.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    m_evicted.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  slot->profile = ProfileBuilder();
+  slot->profile_soa = ProfileSoABuilder();
+  slot->is_in_use = false;
+  m_in_use--;
+}
+
+uint64_t ReassemblyTable::GetCompletedCount() const
+{
+  return m_completed.load(std::memory_order_relaxed);
+}
+
+uint64_t ReassemblyTable::GetEvictedCount() const
+{
+  return m_evicted.load(std::memory_order_relaxed);
+}
+
+uint64_t ReassemblyTable::GetReorderedCount() const
+{
+  return m_reordered.load(std::memory_order_relaxed);
+}
+
+void ReassemblyTable::ResetStatistics()
+{
+  m_completed = 0;
+  m_evicted = 0;
+  m_reordered = 0;
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_REASSEMBLY_TABLE_H
+#define JOESCAN_REASSEMBLY_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "ProfileBuilder.hpp"
+
+namespace joescan {
+
+/**
+ * @brief The `ReassemblyTable` class tracks the profiles of a scan head that
+ * are partway through being assembled from their data packets. A scan head
+ * with several camera and laser pairs can interleave the packets of different
+ * profiles, so each profile in flight gets its own slot, keyed by the packet
+ * source and timestamp, and is finished once all of its packets arrive.
+ *
+ * Slots that stop receiving packets are evicted so the table can't fill up
+ * with profiles that will never complete. Only the thread assembling profiles
+ * may use the table, apart from reading the statistics.
+ */
+class ReassemblyTable {
+ public:
+  // more than enough for every camera and laser pair of a scan head
+  static const uint32_t kMaxSlots = 8;
+  // packets received for other profiles before a slot is considered stale
+  static const uint32_t kMaxAgePackets = 256;
+
+  struct Slot {
+    // only the builder for the profile layout in use is set
+    ProfileBuilder profile;
+    ProfileSoABuilder profile_soa;
+    jsCamera camera;
+    jsLaser laser;
+    uint32_t source;
+    uint64_t timestamp;
+    uint32_t packets_received;
+    uint32_t packets_expected;
+    // packet count when the slot last received a packet
+    uint64_t last_packet;
+    bool is_in_use;
+  };
+
+  ReassemblyTable();
+
+  /**
+   * Looks up the slot assembling a given profile.
+   *
+   * @param source The source ID of the packet.
+   * @param timestamp The timestamp of the packet.
+   * @return Pointer to the slot or `nullptr` if the profile is not in flight.
+   */
+  Slot *Find(uint32_t source, uint64_t timestamp);
+
+  /**
+   * Finds a slot that has not received a packet in `kMaxAgePackets` packets.
+   *
+   * @return Pointer to the slot or `nullptr` if none are stale.
+   */
+  Slot *FindStale();
+
+  /**
+   * Finds the slot that has gone the longest without receiving a packet.
+   *
+   * @return Pointer to the slot or `nullptr` if no slots are in use.
+   */
+  Slot *FindOldest();
+
+  /**
+   * Claims a free slot for a new profile. The caller sets the builder for the
+   * profile layout in use.
+   *
+   * @param source The source ID of the first packet received.
+   * @param timestamp The timestamp of the first packet received.
+   * @param packets_expected The number of packets making up the profile.
+   * @return Pointer to the slot or `nullptr` if all slots are in use.
+   */
+  Slot *Insert(uint32_t source, uint64_t timestamp, uint32_t packets_expected);
+
+  /**
+   * Marks that a packet has been added to the profile of a slot.
+   *
+   * @param slot Pointer to the slot.
+   * @return Boolean `true` if the profile now holds all its packets.
+   */
+  bool AddPacket(Slot *slot);
+
+  /**
+   * Frees a slot once its profile has been handed off.
+   *
+   * @param slot Pointer to the slot.
+   * @param is_complete Boolean `true` if all packets of the profile were
+   * received, `false` if the slot is being evicted.
+   */
+  void Remove(Slot *slot, bool is_complete);
+
+  /**
+   * Frees all slots without counting them, returning each profile held to
+   * the caller.
+   *
+   * @param fn Called with each slot in use before it is freed.
+   */
+  template <typename Fn>
+  void Clear(Fn fn);
+
+  uint64_t GetCompletedCount() const;
+  uint64_t GetEvictedCount() const;
+  uint64_t GetReorderedCount() const;
+  void ResetStatistics();
+
+ private:
+  Slot m_slots[kMaxSlots];
+  // slot that received the last packet; a packet for a profile already in
+  // flight going to another slot means profiles were interleaved
+  Slot *m_last_slot;
+  uint32_t m_in_use;
+  uint64_t m_packet_count;
+  std::atomic<uint64_t> m_completed;
+  std::atomic<uint64_t> m_evicted;
+  std::atomic<uint64_t> m_reordered;
+};
+
+template <typename Fn>
+void ReassemblyTable::Clear(Fn fn)
+{
+  for (uint32_t n = 0; n < kMaxSlots; n++) {
+    Slot *slot = &m_slots[n];
+    if (slot->is_in_use) {
+      fn(slot);
+      slot->profile = ProfileBuilder();
+      slot->profile_soa = ProfileSoABuilder();
+      slot->is_in_use = false;
+    }
+  }
+
+  m_last_slot = nullptr;
+  m_in_use = 0;
+  m_packet_count = 0;
+}
+
+} // namespace joescan
+
+#endif // JOESCAN_REASSEMBLY_TABLE_H
@@ -0,0 +1,385 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifdef __linux__
+
+#include "ReceiveReactor.hpp"
+#include "ScanHead.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace joescan;
+
+ReceiveReactor::ReceiveReactor(jsReceiveMode mode)
+  : m_is_running(false),
+    m_is_keep_alive_enabled(false),
+    m_is_keep_alive_pending(false),
+    m_mode(mode),
+    m_epoll_fd(-1),
+    m_event_fd(-1),
+    m_is_multishot(true)
+{
+#ifndef JOESCAN_HAVE_IO_URING
+  // built without io_uring support
+  m_mode = JS_RECEIVE_MODE_REACTOR;
+#endif
+}
+
+ReceiveReactor::~ReceiveReactor()
+{
+  Stop();
+}
+
+void ReceiveReactor::AddScanHead(ScanHead *scan_head)
+{
+  m_scan_heads.push_back(scan_head);
+}
+
+int ReceiveReactor::Start()
+{
+  // used to kick the reactor out of waiting when stopping
+  m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (0 > m_event_fd) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  int r = 0;
+#ifdef JOESCAN_HAVE_IO_URING
+  if (JS_RECEIVE_MODE_IO_URING == m_mode) {
+    r = StartIoUring();
+  } else {
+    r = StartEpoll();
+  }
+#else
+  r = StartEpoll();
+#endif
+
+  if (0 != r) {
+    Stop();
+    return r;
+  }
+
+  m_is_running = true;
+  std::thread thread(&ReceiveReactor::ReactorMain, this);
+  m_thread = std::move(thread);
+
+  return 0;
+}
+
+void ReceiveReactor::Stop()
+{
+  m_is_running = false;
+  m_is_keep_alive_enabled = false;
+
+  if (m_thread.joinable()) {
+    Wake();
+    m_thread.join();
+  }
+
+#ifdef JOESCAN_HAVE_IO_URING
+  // cancels any receives still posted
+  m_ring.Close();
+#endif
+
+  if (0 <= m_event_fd) {
+    close(m_event_fd);
+    m_event_fd = -1;
+  }
+
+  if (0 <= m_epoll_fd) {
+    close(m_epoll_fd);
+    m_epoll_fd = -1;
+  }
+
+  m_scan_heads.clear();
+}
+
+void ReceiveReactor::SetKeepAlive(bool is_enabled)
+{
+  m_is_keep_alive_enabled = is_enabled;
+  // have the reactor recalculate how long it can sleep for
+  Wake();
+}
+
+void ReceiveReactor::Wake()
+{
+  if (0 <= m_event_fd) {
+    uint64_t v = 1;
+    ssize_t r = write(m_event_fd, &v, sizeof(v));
+    (void)r;
+  }
+}
+
+int ReceiveReactor::StartEpoll()
+{
+  struct epoll_event ev;
+
+  m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (0 > m_epoll_fd) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  if (0 != epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &ev)) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  for (auto sh : m_scan_heads) {
+    ev.events = EPOLLIN;
+    ev.data.ptr = sh;
+    if (0 != epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, sh->GetDataSocket(), &ev)) {
+      return JS_ERROR_NETWORK;
+    }
+  }
+
+  return 0;
+}
+
+void ReceiveReactor::ReactorMain()
+{
+  m_is_keep_alive_pending = false;
+
+#ifdef JOESCAN_HAVE_IO_URING
+  if (JS_RECEIVE_MODE_IO_URING == m_mode) {
+    RunIoUring();
+    return;
+  }
+#endif
+
+  RunEpoll();
+}
+
+int ReceiveReactor::ServiceKeepAlive()
+{
+  using namespace std::chrono;
+
+  if (!m_is_keep_alive_enabled) {
+    m_is_keep_alive_pending = false;
+    return -1;
+  }
+
+  auto now = steady_clock::now();
+
+  if (!m_is_keep_alive_pending) {
+    // first keep alive goes out one interval after scanning starts
+    m_keep_alive_time = now + milliseconds(kKeepAliveSendMs);
+    m_is_keep_alive_due.assign(m_scan_heads.size(), true);
+    m_is_keep_alive_pending = true;
+  } else if (now >= m_keep_alive_time) {
+    // the application may hold a control connection for a whole request and
+    // response; never let that stall receiving data for every scan head here
+    bool is_busy = false;
+    for (uint32_t n = 0; n < m_scan_heads.size(); n++) {
+      if (m_is_keep_alive_due[n]) {
+        m_is_keep_alive_due[n] = !m_scan_heads[n]->TrySendKeepAlive();
+        is_busy = is_busy || m_is_keep_alive_due[n];
+      }
+    }
+
+    if (is_busy) {
+      m_keep_alive_time = now + milliseconds(kKeepAliveRetryMs);
+    } else {
+      m_is_keep_alive_due.assign(m_scan_heads.size(), true);
+      m_keep_alive_time = now + milliseconds(kKeepAliveSendMs);
+    }
+  }
+
+  auto remaining = duration_cast<milliseconds>(m_keep_alive_time - now);
+  return static_cast<int>(remaining.count()) + 1;
+}
+
+void ReceiveReactor::RunEpoll()
+{
+  struct epoll_event events[kMaxEvents];
+
+  while (m_is_running) {
+    int timeout_ms = ServiceKeepAlive();
+
+    int n = epoll_wait(m_epoll_fd, events, kMaxEvents, timeout_ms);
+    if (0 > n) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return;
+    }
+
+    for (int m = 0; m < n; m++) {
+      ScanHead *sh = static_cast<ScanHead *>(events[m].data.ptr);
+
+      if (nullptr == sh) {
+        uint64_t v = 0;
+        ssize_t r = read(m_event_fd, &v, sizeof(v));
+        (void)r;
+        continue;
+      }
+
+      // level triggered; one read per wakeup keeps service fair between heads
+      int r = sh->ReceiveData();
+      if ((0 == r) || ((0 > r) && (EAGAIN != errno) && (EINTR != errno))) {
+        // connection closed or broken, or a message too large to read
+        // (`EMSGSIZE`) arrived; stop watching the socket
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, sh->GetDataSocket(), nullptr);
+      }
+    }
+  }
+}
+
+#ifdef JOESCAN_HAVE_IO_URING
+int ReceiveReactor::StartIoUring()
+{
+  if (0 != m_ring.Init(kRingEntries)) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  int r = m_ring.SetupBufferRing(kRingBufferGroup, kRingBufferCount,
+                                 kRingBufferSize);
+  if (0 != r) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  if (!ArmWakePoll()) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  for (uint32_t n = 0; n < m_scan_heads.size(); n++) {
+    if (!ArmReceive(n)) {
+      return JS_ERROR_INTERNAL;
+    }
+  }
+
+  // requests are submitted by the reactor thread's first wait
+  return 0;
+}
+
+bool ReceiveReactor::ArmWakePoll()
+{
+  struct io_uring_sqe *sqe = m_ring.GetSqe();
+  if (nullptr == sqe) {
+    return false;
+  }
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = m_event_fd;
+  sqe->poll32_events = POLLIN;
+  sqe->user_data = kWakeUserData;
+
+  return true;
+}
+
+bool ReceiveReactor::ArmReceive(uint32_t idx)
+{
+  struct io_uring_sqe *sqe = m_ring.GetSqe();
+  if (nullptr == sqe) {
+    return false;
+  }
+
+  // length of zero lets the kernel fill an entire provided buffer
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = m_scan_heads[idx]->GetDataSocket();
+  sqe->ioprio = m_is_multishot ? IORING_RECV_MULTISHOT : 0;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kRingBufferGroup;
+  sqe->user_data = idx;
+
+  return true;
+}
+
+bool ReceiveReactor::CancelReceive(uint32_t idx)
+{
+  struct io_uring_sqe *sqe = m_ring.GetSqe();
+  if (nullptr == sqe) {
+    return false;
+  }
+
+  // a multishot receive keeps posting until cancelled; it completes with
+  // `-ECANCELED` and is then not posted again
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = idx;
+  sqe->user_data = kCancelUserData;
+
+  return true;
+}
+
+void ReceiveReactor::RunIoUring()
+{
+  std::vector<bool> is_active(m_scan_heads.size(), true);
+
+  while (m_is_running) {
+    int timeout_ms = ServiceKeepAlive();
+
+    int r = m_ring.SubmitAndWait(1, timeout_ms);
+    if ((0 != r) && (-ETIME != r) && (-EINTR != r)) {
+      return;
+    }
+
+    struct io_uring_cqe *cqe = nullptr;
+    while (m_ring.PeekCqe(&cqe)) {
+      uint64_t user_data = cqe->user_data;
+      int32_t res = cqe->res;
+      uint32_t flags = cqe->flags;
+      m_ring.SeenCqe();
+
+      if (kWakeUserData == user_data) {
+        uint64_t v = 0;
+        ssize_t n = read(m_event_fd, &v, sizeof(v));
+        (void)n;
+        ArmWakePoll();
+        continue;
+      }
+
+      if (kCancelUserData == user_data) {
+        continue;
+      }
+
+      uint32_t idx = static_cast<uint32_t>(user_data);
+      ScanHead *sh = m_scan_heads[idx];
+
+      if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if ((0 < res) && is_active[idx]) {
+          uint8_t *buf = m_ring.GetBuffer(bid);
+          if (0 > sh->ReceiveData(buf, static_cast<uint32_t>(res))) {
+            // stream can't be recovered, such as after a message too large
+            // to read; stop receiving on the socket altogether
+            is_active[idx] = false;
+            if (flags & IORING_CQE_F_MORE) {
+              CancelReceive(idx);
+            }
+          }
+        }
+        // data has been consumed, kernel can fill the buffer again
+        m_ring.RecycleBuffer(bid);
+      }
+
+      if (0 == (flags & IORING_CQE_F_MORE)) {
+        if ((-EINVAL == res) && m_is_multishot) {
+          // kernel has buffer rings but not multishot receive; carry on with
+          // a receive posted for every completion rather than lose the data
+          m_is_multishot = false;
+        } else if ((0 == res) ||
+                   ((0 > res) && (-ENOBUFS != res) && (-EINTR != res))) {
+          // connection is done; don't repost the receive
+          is_active[idx] = false;
+        }
+
+        if (is_active[idx]) {
+          ArmReceive(idx);
+        }
+      }
+    }
+  }
+}
+#endif
+
+#endif // __linux__
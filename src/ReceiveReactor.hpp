@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_RECEIVE_REACTOR_H
+#define JOESCAN_RECEIVE_REACTOR_H
+
+#ifdef __linux__
+
+#include "IoUring.hpp"
+#include "joescan_pinchot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+class ScanHead;
+
+/**
+ * @brief The `ReceiveReactor` class runs a single thread that receives scan
+ * data for any number of scan heads by waiting on all of their data sockets
+ * at once with `epoll`. The same thread also sends keep alive messages to its
+ * scan heads while scanning, so a scan system with many scan heads only needs
+ * a handful of threads rather than one or more per scan head.
+ *
+ * In `JS_RECEIVE_MODE_IO_URING` mode, the thread instead keeps a multishot
+ * receive posted on each data socket using io_uring. The kernel places data
+ * directly into buffers taken from a provided buffer ring and completions are
+ * handed to the scan heads without any further system calls per message.
+ */
+class ReceiveReactor {
+ public:
+  /**
+   * Initializes a `ReceiveReactor` object.
+   *
+   * @param mode Either `JS_RECEIVE_MODE_REACTOR` or `JS_RECEIVE_MODE_IO_URING`;
+   * the latter falls back to `epoll` if io_uring is not available.
+   */
+  ReceiveReactor(jsReceiveMode mode = JS_RECEIVE_MODE_REACTOR);
+  ~ReceiveReactor();
+
+  /**
+   * Adds a connected scan head to be serviced. Must be called before `Start`.
+   *
+   * @param scan_head Pointer to the scan head.
+   */
+  void AddScanHead(ScanHead *scan_head);
+
+  /**
+   * Starts the reactor thread.
+   *
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int Start();
+
+  /**
+   * Stops the reactor thread and forgets all scan heads added to it.
+   */
+  void Stop();
+
+  /**
+   * Enables or disables sending keep alive messages to the scan heads.
+   *
+   * @param is_enabled Boolean `true` to send keep alives, `false` otherwise.
+   */
+  void SetKeepAlive(bool is_enabled);
+
+ private:
+  static const uint32_t kKeepAliveSendMs = 1000;
+  // how soon to retry a keep alive the control connection was too busy for
+  static const uint32_t kKeepAliveRetryMs = 10;
+  static const int kMaxEvents = 64;
+  static const uint32_t kRingEntries = 256;
+  static const uint32_t kRingBufferCount = 64;
+  static const uint32_t kRingBufferSize = 64 * 1024;
+  static const uint16_t kRingBufferGroup = 0;
+  // io_uring user data for the wake up poll and receive cancellations; scan
+  // heads use their index
+  static const uint64_t kWakeUserData = UINT64_MAX;
+  static const uint64_t kCancelUserData = UINT64_MAX - 1;
+
+  int StartEpoll();
+  void ReactorMain();
+  void RunEpoll();
+  int ServiceKeepAlive();
+  void Wake();
+#ifdef JOESCAN_HAVE_IO_URING
+  int StartIoUring();
+  void RunIoUring();
+  bool ArmWakePoll();
+  bool ArmReceive(uint32_t idx);
+  bool CancelReceive(uint32_t idx);
+#endif
+
+  std::vector<ScanHead *> m_scan_heads;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+  std::atomic<bool> m_is_keep_alive_enabled;
+  // only accessed by the reactor thread
+  std::chrono::steady_clock::time_point m_keep_alive_time;
+  bool m_is_keep_alive_pending;
+  // indexed as `m_scan_heads`, whether a keep alive is still to be sent for
+  // the current interval
+  std::vector<bool> m_is_keep_alive_due;
+  jsReceiveMode m_mode;
+  int m_epoll_fd;
+  int m_event_fd;
+#ifdef JOESCAN_HAVE_IO_URING
+  IoUring m_ring;
+#endif
+  // cleared if the kernel turns out to reject multishot receives
+  bool m_is_multishot;
+};
+
+} // namespace joescan
+
+#endif // __linux__
+
+#endif // JOESCAN_RECEIVE_REACTOR_H
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_RECORDING_FORMAT_H
+#define JOESCAN_RECORDING_FORMAT_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace joescan {
+
+/**
+ * A recording of the data streams of a scan system is split across files
+ * named by appending `.NNNNNN` to the path given, counting up from zero. Each
+ * file starts with a `RecordingFileHeader` followed by records, each made up
+ * of a `RecordHeader` and `length` bytes of payload. All values are stored in
+ * the byte order of the host that made the recording, always little-endian
+ * for the platforms supported.
+ */
+static const uint32_t kRecordingMagic = 0x4353524A; // "JRSC"
+static const uint32_t kRecordingVersion = 1;
+
+enum RecordType : uint16_t {
+  // a data message exactly as read from the data socket of a scan head,
+  // without its length prefix
+  kRecordData = 1,
+  // a `RecordedScanHead` describing a scan head as scanning was started; also
+  // repeated at the start of every file
+  kRecordScanHead = 2,
+  // padding to keep writes aligned, to be skipped
+  kRecordPad = 3,
+};
+
+#pragma pack(push, 1)
+
+struct RecordingFileHeader { // size  byte offset
+  uint32_t magic;            // 4      0
+  uint32_t version;          // 4      4
+  // index of the file within the recording
+  uint32_t file_index;       // 4      8
+  uint32_t reserved;         // 4     12
+  // time on the host clock records are timestamped with as the file was
+  // opened, and the wall clock time in ns since the epoch at that moment
+  uint64_t host_time_ns;     // 8     16
+  uint64_t wall_time_ns;     // 8     24
+                             // total 32
+};
+
+struct RecordHeader {        // size  byte offset
+  // time on the host clock the data was received
+  uint64_t host_time_ns;     // 8      0
+  // number of payload bytes following the header
+  uint32_t length;           // 4      8
+  uint32_t serial_number;    // 4     12
+  uint16_t type;             // 2     16
+  uint16_t reserved0;        // 2     18
+  uint32_t reserved1;        // 4     20
+                             // total 24
+};
+
+struct RecordedScanHead {    // size  byte offset
+  uint32_t serial_number;    // 4      0
+  uint32_t id;               // 4      4
+  uint32_t type;             // 4      8 `jsScanHeadType`
+  uint32_t firmware_version_major; // 12
+  uint32_t firmware_version_minor; // 16
+  uint32_t firmware_version_patch; // 20
+  uint32_t format;           // 4     24 `jsDataFormat`
+  uint32_t scan_period_us;   // 4     28
+                             // total 32
+};
+
+#pragma pack(pop)
+
+static_assert(32 == sizeof(RecordingFileHeader), "RecordingFileHeader");
+static_assert(24 == sizeof(RecordHeader), "RecordHeader");
+static_assert(32 == sizeof(RecordedScanHead), "RecordedScanHead");
+
+/**
+ * Gets the time on the host clock used to timestamp recorded data. The clock
+ * is monotonic; `RecordingFileHeader` relates it to the wall clock.
+ *
+ * @return The time in nanoseconds.
+ */
+inline uint64_t RecordingTimeNs()
+{
+  auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+}
+
+} // namespace joescan
+
+#endif // JOESCAN_RECORDING_FORMAT_H
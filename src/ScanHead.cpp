@@ -17,10 +17,39 @@ using namespace joescan;
 ScanHead::ScanHead(ScanManager &manager, jsDiscovered &discovered, uint32_t id)
   : m_scan_manager(manager),
     m_format(JS_DATA_FORMAT_XY_BRIGHTNESS_FULL),
+    m_scan_format(JS_DATA_FORMAT_XY_BRIGHTNESS_FULL),
     m_type(discovered.type),
     m_cable(JS_CABLE_ORIENTATION_UPSTREAM),
-    m_circ_buffer(kMaxCircularBufferSize),
+    m_profile_queue(kMaxProfileQueueSize),
+    m_pool(kMaxProfileQueueSize + kProfilePoolReserve),
+    m_pool_clean_stride(kMaxProfileQueueSize + kProfilePoolReserve, 0),
+    m_pool_borrowed(kMaxProfileQueueSize + kProfilePoolReserve, 0),
+    m_profile_queue_soa(kMaxProfileQueueSize),
+    m_pool_soa(kMaxProfileQueueSize + kProfilePoolReserve),
+    m_pool_soa_borrowed(kMaxProfileQueueSize + kProfilePoolReserve, 0),
+    m_dispatch_queue(kMaxProfileQueueSize),
+    m_overflow_policy(JS_OVERFLOW_POLICY_OVERWRITE_OLDEST),
+    m_overflow_timeout_us(0),
+    m_scan_overflow_policy(JS_OVERFLOW_POLICY_OVERWRITE_OLDEST),
+    m_scan_overflow_timeout_us(0),
+    m_profiles_overwritten(0),
+    m_profiles_dropped(0),
+    m_queue_high_water(0),
+    m_profile_callback(nullptr),
+    m_profile_callback_ctx(nullptr),
+    m_dispatcher(nullptr),
+    m_scan_callback(nullptr),
+    m_scan_callback_ctx(nullptr),
+    m_scan_dispatcher(nullptr),
     m_builder(512),
+    m_resample_encoder(JS_ENCODER_MAIN),
+    m_resample_ticks(0),
+    m_resample_mode(JS_RESAMPLE_MODE_NEAREST),
+    m_gate_open_points(0),
+    m_gate_close_points(0),
+    m_gate_pre_roll(0),
+    m_gate_post_roll(0),
+    m_stream(kStreamBufferSize),
     m_serial_number(discovered.serial_number),
     m_ip_address(discovered.ip_addr),
     m_id(id),
@@ -31,17 +60,22 @@ ScanHead::ScanHead(ScanManager &manager, jsDiscovered &discovered, uint32_t id)
     m_data_tcp_fd(0),
     m_port(0),
     m_scan_period_us(0),
+    m_data_type_mask(DataType::XYData | DataType::Brightness),
+    m_data_stride(1),
+    m_scan_stride(1),
+    m_is_scan_compact(false),
+    m_is_scan_soa(false),
+    m_is_scan_resample(false),
+    m_is_scan_gated(false),
     m_packets_received(0),
-    m_packets_received_for_profile(0),
-    m_complete_profiles_received(0),
-    m_last_profile_source(0),
-    m_last_profile_timestamp(0),
+    m_recorder(nullptr),
+    m_is_receive_busy(false),
+    m_scan_recorder(nullptr),
+    m_receive_time_ns(0),
     m_is_receive_thread_active(false),
     m_is_scanning(false)
 {
   m_units = m_scan_manager.GetUnits();
-  m_packet_buf = new uint8_t[kMaxPacketSize * 10];
-  m_packet_buf_len = kMaxPacketSize * 10;
 
   // TODO: this should constants; maybe defined in scan head specification?
   // default configuration
@@ -74,11 +108,12 @@ ScanHead::ScanHead(ScanManager &manager, jsDiscovered &discovered, uint32_t id)
     m_map_alignment[pair] = alignment;
     m_map_window[pair] = window;
   }
+
+  SnapshotScanConfiguration();
 }
 
 ScanHead::~ScanHead()
 {
-  delete[] m_packet_buf;
 }
 
 jsScanHeadType ScanHead::GetType() const
@@ -130,7 +165,7 @@ int ScanHead::Connect(uint32_t timeout_s)
   SOCKET fd = -1;
   int r = 0;
 
-  m_mutex.lock();
+  m_control_mutex.lock();
   {
     net_iface iface =
       NetworkInterface::InitTCPSocket(m_ip_address, kScanServerPort, timeout_s);
@@ -143,9 +178,13 @@ int ScanHead::Connect(uint32_t timeout_s)
     m_data_tcp_fd = iface.sockfd;
   }
 
+  m_stream.Reset();
   m_is_receive_thread_active = true;
-  std::thread receive_thread(&ScanHead::ReceiveMain, this);
-  m_receive_thread = std::move(receive_thread);
+  if (JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD ==
+      m_scan_manager.GetReceiveMode()) {
+    std::thread receive_thread(&ScanHead::ReceiveMain, this);
+    m_receive_thread = std::move(receive_thread);
+  }
 
   m_builder.Clear();
   auto data_offset =
@@ -157,12 +196,12 @@ int ScanHead::Connect(uint32_t timeout_s)
 
   r = TCPSend(m_builder);
   if (0 != r) {
-    m_mutex.unlock();
+    m_control_mutex.unlock();
     return r;
   }
 
   // manually unlock; calling GetStatusMessage will lock the mutex again
-  m_mutex.unlock();
+  m_control_mutex.unlock();
 
   StatusMessage status;
   r = GetStatusMessage(&status);
@@ -177,7 +216,7 @@ int ScanHead::Disconnect(void)
 {
   using namespace schema::client;
 
-  m_mutex.lock();
+  m_control_mutex.lock();
   m_builder.Clear();
 
   auto msg_offset =
@@ -189,15 +228,18 @@ int ScanHead::Disconnect(void)
   m_control_tcp_fd = -1;
   NetworkInterface::CloseSocket(m_data_tcp_fd);
   m_data_tcp_fd = -1;
-  m_mutex.unlock();
-  m_receive_thread.join();
+  m_control_mutex.unlock();
+  if (m_receive_thread.joinable()) {
+    m_receive_thread.join();
+  }
 
   return r;
 }
 
 int ScanHead::SendWindow(jsCamera camera_to_update)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
 
   using namespace schema::client;
   int r = 0;
@@ -285,7 +327,8 @@ int ScanHead::SendScanConfiguration()
     return 0;
   }
 
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
   ScanConfigurationDataT cfg;
   cfg.udp_port = m_port;
   cfg.data_type_mask = m_data_type_mask;
@@ -335,10 +378,28 @@ int ScanHead::SendScanConfiguration()
 }
 
 int ScanHead::SendKeepAlive()
+{
+  std::unique_lock<std::mutex> lock(m_control_mutex);
+  return SendKeepAliveLocked();
+}
+
+bool ScanHead::TrySendKeepAlive()
+{
+  std::unique_lock<std::mutex> lock(m_control_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return false;
+  }
+
+  SendKeepAliveLocked();
+
+  return true;
+}
+
+int ScanHead::SendKeepAliveLocked()
 {
   using namespace schema::client;
 
-  std::unique_lock<std::mutex> lock(m_mutex);
+  // private function, assume control mutex is already locked
   m_builder.Clear();
   auto msg_offset =
     CreateMessageClient(m_builder, MessageType_KEEP_ALIVE, MessageData_NONE);
@@ -352,14 +413,11 @@ int ScanHead::StartScanning()
 {
   using namespace schema::client;
 
-  std::unique_lock<std::mutex> lock(m_mutex);
-  m_profile = ProfileBuilder();
-  m_packets_received = 0;
-  m_complete_profiles_received = 0;
-  m_last_profile_source = 0;
-  m_last_profile_timestamp = 0;
-  // reset circular buffer holding profile data
-  m_circ_buffer.clear();
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
+  PrepareScanning();
+  // set before the scan head is told to start, so its first profile is kept
+  m_is_scanning = true;
 
   m_builder.Clear();
   auto msg_offset =
@@ -367,8 +425,8 @@ int ScanHead::StartScanning()
   m_builder.Finish(msg_offset);
   int r = TCPSend(m_builder);
 
-  if (0 == r) {
-    m_is_scanning = true;
+  if (0 != r) {
+    m_is_scanning = false;
   }
 
   return r;
@@ -377,7 +435,8 @@ int ScanHead::StartScanning()
 int ScanHead::StopScanning()
 {
   using namespace schema::client;
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
   m_builder.Clear();
   auto msg_offset =
     CreateMessageClient(m_builder, MessageType_SCAN_STOP, MessageData_NONE);
@@ -391,6 +450,30 @@ int ScanHead::StopScanning()
   return r;
 }
 
+int ScanHead::StartScanningOffline()
+{
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
+  if (IsConnected()) {
+    return JS_ERROR_CONNECTED;
+  }
+
+  PrepareScanning();
+  m_stream.Reset();
+  m_is_receive_thread_active = true;
+  m_is_scanning = true;
+
+  return 0;
+}
+
+void ScanHead::StopScanningOffline()
+{
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
+  m_is_receive_thread_active = false;
+  m_is_scanning = false;
+}
+
 bool ScanHead::IsConnected()
 {
   return (0 < m_control_tcp_fd) ? true : false;
@@ -466,7 +549,7 @@ int32_t ScanHead::GetImage(jsCamera camera, jsLaser laser,
                            uint32_t camera_exposure_us,
                            uint32_t laser_on_time_us, jsCameraImage *image)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_control_mutex);
 
   // Only allow image capture if connected and not currently scanning.
   if (!IsConnected()) {
@@ -624,7 +707,8 @@ int32_t ScanHead::GetProfile(jsCamera camera, jsLaser laser,
                              uint32_t laser_on_time_us,
                              jsRawProfile *profile)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::lock_guard<std::mutex> config_lock(m_config_mutex);
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
 
   // Only allow image capture if connected and not currently scanning.
   if (!IsConnected()) {
@@ -738,6 +822,7 @@ int32_t ScanHead::GetProfile(jsCamera camera, jsLaser laser,
     profile->num_encoder_values = encoders_size;
     profile->packets_received = 0;
     profile->packets_expected = 0;
+    profile->gap_profiles = 0;
     profile->data_len = JS_RAW_PROFILE_DATA_LEN;
     profile->data_valid_brightness = data->valid_points();
     profile->data_valid_xy = data->valid_points();
@@ -777,40 +862,341 @@ int32_t ScanHead::GetProfile(jsCamera camera, jsLaser laser,
 
 uint32_t ScanHead::AvailableProfiles()
 {
-  return static_cast<uint32_t>(m_circ_buffer.size());
+  // only one queue is filled, depending on the profile layout
+  return m_profile_queue.Size() + m_profile_queue_soa.Size();
 }
 
 uint32_t ScanHead::WaitUntilAvailableProfiles(uint32_t count,
                                               uint32_t timeout_us)
 {
-  std::chrono::duration<uint32_t, std::micro> timeout(timeout_us);
-  std::unique_lock<std::mutex> lock(m_mutex);
-  m_receive_thread_data_sync.wait_for(
-    lock, timeout, [this, count] { return m_circ_buffer.size() >= count; });
-  return static_cast<uint32_t>(m_circ_buffer.size());
+  return m_profile_wakeup.WaitFor(
+    count, [this] { return AvailableProfiles(); }, timeout_us);
+}
+
+uint32_t ScanHead::GetProfiles(jsRawProfile **profiles, uint32_t max_profiles)
+{
+  uint32_t n = m_profile_queue.Pop(profiles, max_profiles);
+  if (0 != n) {
+    BorrowProfiles(m_pool, m_pool_borrowed, profiles, n);
+    m_space_wakeup.Notify([this] {
+      return m_profile_queue.Capacity() - m_profile_queue.Size();
+    });
+  }
+
+  return n;
+}
+
+uint32_t ScanHead::GetProfiles(jsProfileSoA **profiles, uint32_t max_profiles)
+{
+  uint32_t n = m_profile_queue_soa.Pop(profiles, max_profiles);
+  if (0 != n) {
+    BorrowProfiles(m_pool_soa, m_pool_soa_borrowed, profiles, n);
+    m_space_wakeup.Notify([this] {
+      return m_profile_queue_soa.Capacity() - m_profile_queue_soa.Size();
+    });
+  }
+
+  return n;
+}
+
+int ScanHead::ReleaseProfiles(jsRawProfile **profiles, uint32_t count)
+{
+  return ReturnProfiles(m_pool, m_pool_borrowed, profiles, count);
+}
+
+int ScanHead::ReleaseProfiles(jsProfileSoA **profiles, uint32_t count)
+{
+  return ReturnProfiles(m_pool_soa, m_pool_soa_borrowed, profiles, count);
+}
+
+template <typename T>
+void ScanHead::BorrowProfiles(ProfilePool<T> &pool,
+                              std::vector<uint8_t> &borrowed, T **profiles,
+                              uint32_t count)
+{
+  for (uint32_t n = 0; n < count; n++) {
+    borrowed[pool.IndexOf(profiles[n])] = 1;
+  }
 }
 
-std::vector<std::shared_ptr<jsRawProfile>> ScanHead::GetProfiles(uint32_t count)
+template <typename T>
+int ScanHead::ReturnProfiles(ProfilePool<T> &pool,
+                             std::vector<uint8_t> &borrowed, T **profiles,
+                             uint32_t count)
 {
-  std::vector<std::shared_ptr<jsRawProfile>> profiles;
-  std::shared_ptr<jsRawProfile> profile = nullptr;
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::lock_guard<std::mutex> lock(m_consumer_mutex);
+
+  // check every profile before releasing any; clearing the flag as each is
+  // checked also catches the same profile passed twice
+  for (uint32_t n = 0; n < count; n++) {
+    if ((!pool.IsFromPool(profiles[n])) ||
+        (0 == borrowed[pool.IndexOf(profiles[n])])) {
+      for (uint32_t m = 0; m < n; m++) {
+        borrowed[pool.IndexOf(profiles[m])] = 1;
+      }
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
 
-  while (!m_circ_buffer.empty() && (0 < count)) {
-    profile = m_circ_buffer.front();
-    m_circ_buffer.pop_front();
+    borrowed[pool.IndexOf(profiles[n])] = 0;
+  }
 
-    profiles.push_back(profile);
-    count--;
+  for (uint32_t n = 0; n < count; n++) {
+    pool.Release(profiles[n]);
   }
 
-  return profiles;
+  return 0;
 }
 
 void ScanHead::ClearProfiles()
 {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  m_circ_buffer.clear();
+  const uint32_t batch_len = 32;
+  uint32_t n = 0;
+
+  {
+    jsRawProfile *batch[batch_len];
+    do {
+      n = GetProfiles(batch, batch_len);
+      ReleaseProfiles(batch, n);
+    } while (0 != n);
+  }
+
+  {
+    jsProfileSoA *batch[batch_len];
+    do {
+      n = GetProfiles(batch, batch_len);
+      ReleaseProfiles(batch, n);
+    } while (0 != n);
+  }
+}
+
+int ScanHead::RegisterProfileCallback(jsProfileCallback fn, void *ctx)
+{
+  std::lock_guard<std::mutex> lock(m_config_mutex);
+  if (m_is_scanning) {
+    return JS_ERROR_SCANNING;
+  }
+
+  m_profile_callback = fn;
+  m_profile_callback_ctx = ctx;
+
+  return 0;
+}
+
+int ScanHead::SetResampling(jsEncoder encoder, uint32_t ticks_per_slice,
+                            jsResampleMode mode)
+{
+  if ((JS_ENCODER_MAIN > encoder) || (JS_ENCODER_MAX <= encoder)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if ((JS_RESAMPLE_MODE_NEAREST != mode) &&
+      (JS_RESAMPLE_MODE_LINEAR != mode)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  std::lock_guard<std::mutex> lock(m_config_mutex);
+  if (m_is_scanning) {
+    return JS_ERROR_SCANNING;
+  }
+
+  m_resample_encoder = encoder;
+  m_resample_ticks = ticks_per_slice;
+  m_resample_mode = mode;
+
+  return 0;
+}
+
+int ScanHead::SetPresenceGate(uint32_t open_points, uint32_t close_points,
+                              uint32_t pre_roll, uint32_t post_roll)
+{
+  if ((close_points > open_points) || (PresenceGate::kMaxPreRoll < pre_roll)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  std::lock_guard<std::mutex> lock(m_config_mutex);
+  if (m_is_scanning) {
+    return JS_ERROR_SCANNING;
+  }
+
+  m_gate_open_points = open_points;
+  m_gate_close_points = close_points;
+  m_gate_pre_roll = pre_roll;
+  m_gate_post_roll = post_roll;
+
+  return 0;
+}
+
+int ScanHead::SetProfileBufferCapacity(uint32_t capacity)
+{
+  if ((0 == capacity) || (JS_SCAN_HEAD_PROFILE_BUFFER_MAX < capacity)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  std::lock_guard<std::mutex> lock(m_config_mutex);
+  if (IsConnected()) {
+    return JS_ERROR_CONNECTED;
+  }
+
+  if (m_is_scanning) {
+    // replaying a recording, the receive path is using the pools
+    return JS_ERROR_SCANNING;
+  }
+
+  // receive path only runs while connected or replaying; hand back every
+  // profile still held so that nothing points into the pools once they are
+  // reallocated
+  ReleaseHeldProfiles();
+  ClearProfiles();
+
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  {
+    // never handed out by `GetProfiles`, so not marked as borrowed
+    jsRawProfile *batch[kDispatchBatchSize];
+    uint32_t n = 0;
+    while (0 != (n = m_dispatch_queue.Pop(batch, kDispatchBatchSize))) {
+      for (uint32_t m = 0; m < n; m++) {
+        m_pool.Release(batch[m]);
+      }
+    }
+  }
+
+  if ((0 != m_pool.GetInUse()) || (0 != m_pool_soa.GetInUse())) {
+    // application is still holding on to borrowed profiles
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  const uint32_t pool_capacity = capacity + kProfilePoolReserve;
+  std::vector<uint8_t> clean_stride(pool_capacity, 0);
+  std::vector<uint8_t> borrowed(pool_capacity, 0);
+  std::vector<uint8_t> soa_borrowed(pool_capacity, 0);
+  m_pool.Reset(pool_capacity);
+  m_pool_clean_stride.swap(clean_stride);
+  m_pool_borrowed.swap(borrowed);
+  m_pool_soa.Reset(pool_capacity);
+  m_pool_soa_borrowed.swap(soa_borrowed);
+  m_profile_queue.Reset(capacity);
+  m_profile_queue_soa.Reset(capacity);
+  m_dispatch_queue.Reset(capacity);
+
+  return 0;
+}
+
+uint32_t ScanHead::GetProfileBufferCapacity()
+{
+  // both queues are always sized the same
+  return m_profile_queue.Capacity();
+}
+
+int ScanHead::SetProfileBufferOverflow(jsOverflowPolicy policy,
+                                       uint32_t timeout_us)
+{
+  if ((JS_OVERFLOW_POLICY_OVERWRITE_OLDEST != policy) &&
+      (JS_OVERFLOW_POLICY_DROP_NEWEST != policy) &&
+      (JS_OVERFLOW_POLICY_BLOCK != policy)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  std::lock_guard<std::mutex> lock(m_config_mutex);
+  if (m_is_scanning) {
+    return JS_ERROR_SCANNING;
+  }
+
+  m_overflow_policy = policy;
+  m_overflow_timeout_us = timeout_us;
+
+  return 0;
+}
+
+void ScanHead::SetProfileDispatcher(ProfileDispatcher *dispatcher)
+{
+  std::lock_guard<std::mutex> lock(m_config_mutex);
+  m_dispatcher = dispatcher;
+  if (nullptr == dispatcher) {
+    // dispatcher is going away; receive thread is no longer running
+    m_scan_dispatcher = nullptr;
+  }
+}
+
+uint32_t ScanHead::DispatchProfiles()
+{
+  jsRawProfile *batch[kDispatchBatchSize];
+  jsProfileCallback fn = nullptr;
+  void *ctx = nullptr;
+
+  uint32_t n = m_dispatch_queue.Pop(batch, kDispatchBatchSize);
+  if (0 == n) {
+    return 0;
+  }
+  m_space_wakeup.Notify([this] {
+    return m_dispatch_queue.Capacity() - m_dispatch_queue.Size();
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(m_consumer_mutex);
+    fn = m_scan_callback;
+    ctx = m_scan_callback_ctx;
+  }
+
+  // callback is called without holding the lock so it is free to call back
+  // into the scan head; it can only be missing if it was unregistered before
+  // scanning again while profiles of the last scan were still waiting
+  if (nullptr != fn) {
+    for (uint32_t m = 0; m < n; m++) {
+      fn(batch[m], ctx);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_consumer_mutex);
+  for (uint32_t m = 0; m < n; m++) {
+    m_pool.Release(batch[m]);
+  }
+
+  return n;
+}
+
+uint32_t ScanHead::PendingDispatch() const
+{
+  return m_dispatch_queue.Size();
+}
+
+jsScanHeadReceiveStatistics ScanHead::GetReceiveStatistics()
+{
+  jsScanHeadReceiveStatistics stats;
+
+  if (m_is_scan_soa) {
+    stats.profile_pool_capacity = m_pool_soa.GetCapacity();
+    stats.profile_pool_in_use = m_pool_soa.GetInUse();
+    stats.profile_pool_high_water = m_pool_soa.GetHighWaterMark();
+    stats.profile_pool_exhausted = m_pool_soa.GetExhaustedCount();
+  } else {
+    stats.profile_pool_capacity = m_pool.GetCapacity();
+    stats.profile_pool_in_use = m_pool.GetInUse();
+    stats.profile_pool_high_water = m_pool.GetHighWaterMark();
+    stats.profile_pool_exhausted = m_pool.GetExhaustedCount();
+  }
+  stats.profiles_completed = m_reassembly.GetCompletedCount();
+  stats.profiles_partial = m_reassembly.GetEvictedCount();
+  stats.packets_reordered = m_reassembly.GetReorderedCount();
+  stats.profiles_resampled_out = 0;
+  for (auto const &resamplers : m_resamplers) {
+    for (auto const &resampler : resamplers) {
+      stats.profiles_resampled_out += resampler.GetDroppedCount();
+    }
+  }
+  stats.profiles_gated = 0;
+  for (auto const &gates : m_gates) {
+    for (auto const &gate : gates) {
+      stats.profiles_gated += gate.GetGatedCount();
+    }
+  }
+  stats.profile_buffer_capacity = m_profile_queue.Capacity();
+  stats.profile_buffer_high_water =
+    m_queue_high_water.load(std::memory_order_relaxed);
+  stats.profiles_overwritten =
+    m_profiles_overwritten.load(std::memory_order_relaxed);
+  stats.profiles_dropped = m_profiles_dropped.load(std::memory_order_relaxed);
+
+  return stats;
 }
 
 int ScanHead::GetStatusMessage(StatusMessage *status)
@@ -828,7 +1214,7 @@ int ScanHead::GetStatusMessage(StatusMessage *status)
 
     // Just need to lock here since the only shared resources are the TCP
     // socket and the flat buffer builder
-    std::unique_lock<std::mutex> lock(m_mutex);
+    std::unique_lock<std::mutex> lock(m_control_mutex);
     m_builder.Clear();
 
     auto msg_offset = CreateMessageClient(m_builder, MessageType_STATUS_REQUEST,
@@ -902,7 +1288,7 @@ StatusMessage ScanHead::GetLastStatusMessage()
 
 void ScanHead::ClearStatusMessage()
 {
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::lock_guard<std::mutex> lock(m_control_mutex);
   memset(&m_status, 0, sizeof(StatusMessage));
 }
 
@@ -946,7 +1332,7 @@ bool ScanHead::IsConfigurationValid(jsScanHeadConfiguration &cfg)
 
 int ScanHead::SetConfiguration(jsScanHeadConfiguration &cfg)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_config_mutex);
 
   if (m_is_scanning) {
     return JS_ERROR_SCANNING;
@@ -973,7 +1359,7 @@ jsScanHeadConfiguration ScanHead::GetConfigurationDefault() const
 
 int ScanHead::SetDataFormat(jsDataFormat format)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_config_mutex);
 
   switch (format) {
     case (JS_DATA_FORMAT_XY_BRIGHTNESS_FULL):
@@ -1015,7 +1401,7 @@ jsDataFormat ScanHead::GetDataFormat() const
 
 int ScanHead::SetScanPeriod(uint32_t period_us)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_config_mutex);
   if ((period_us > m_spec.max_scan_period_us) ||
       (period_us < m_spec.min_scan_period_us)) {
     return JS_ERROR_INVALID_ARGUMENT;
@@ -1082,6 +1468,11 @@ int ScanHead::SetCableOrientation(jsCableOrientation cable)
     return JS_ERROR_INVALID_ARGUMENT;
   }
 
+  std::unique_lock<std::mutex> lock(m_config_mutex);
+  if (m_is_scanning) {
+    return JS_ERROR_SCANNING;
+  }
+
   m_cable = cable;
 
   for (auto &m : m_map_alignment) {
@@ -1136,7 +1527,7 @@ int ScanHead::SetAlignment(jsLaser laser, double roll_degrees, double shift_x,
 int ScanHead::SetAlignment(jsCamera camera, jsLaser laser, double roll_degrees,
                            double shift_x, double shift_y)
 {
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_config_mutex);
 
   if ((false == IsCameraValid(camera)) || (false == IsLaserValid(laser))) {
     return JS_ERROR_INVALID_ARGUMENT;
@@ -1192,7 +1583,7 @@ int ScanHead::GetAlignment(jsCamera camera, jsLaser laser, double *roll_degrees,
     return JS_ERROR_INVALID_ARGUMENT;
   }
 
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_config_mutex);
   std::pair<jsCamera, jsLaser> pair(camera, laser);
   AlignmentParams *alignment = &m_map_alignment[pair];
 
@@ -1243,7 +1634,7 @@ int ScanHead::SetWindow(jsCamera camera, jsLaser laser, ScanWindow &window)
     return JS_ERROR_INVALID_ARGUMENT;
   }
 
-  std::unique_lock<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_config_mutex);
 
   if (m_is_scanning) {
     return JS_ERROR_SCANNING;
@@ -1397,7 +1788,8 @@ std::pair<jsCamera, jsLaser> ScanHead::CameraLaserNext(uint32_t idx)
 
 void ScanHead::ProcessProfile(uint8_t *buf, uint32_t len)
 {
-  // private function, assume mutex is already locked
+  // private function, called only by the receive path; reads the scan
+  // configuration snapshot so no lock is needed
   DataPacket packet(buf, len, 0);
   uint32_t source = 0;
   uint64_t timestamp = 0;
@@ -1411,84 +1803,87 @@ void ScanHead::ProcessProfile(uint8_t *buf, uint32_t len)
   source = packet.GetSourceId();
   timestamp = packet.GetTimeStamp();
 
-  if ((source != m_last_profile_source) ||
-      (timestamp != m_last_profile_timestamp)) {
-    if (false == m_profile.IsEmpty()) {
-      std::unique_lock<std::mutex> lock(m_mutex);
-      // have a partial profile, push it back despite loss
-      m_profile.SetPacketInfo(m_packets_received_for_profile, total_packets);
-      m_circ_buffer.push_back(m_profile.raw);
-      m_receive_thread_data_sync.notify_all();
+  ReassemblyTable::Slot *slot = m_reassembly.Find(source, timestamp);
+  if (nullptr == slot) {
+    // first packet of a new profile; profiles that stopped receiving packets
+    // won't complete, push them back despite loss
+    ReassemblyTable::Slot *stale = nullptr;
+    while (nullptr != (stale = m_reassembly.FindStale())) {
+      FinishProfile(stale, false);
     }
 
-    m_last_profile_source = source;
-    m_last_profile_timestamp = timestamp;
-    m_packets_received_for_profile = 0;
-
     jsCamera camera = CameraPortToId(packet.GetCameraPort());
     jsLaser laser = LaserPortToId(packet.GetLaserPort());
-    m_profile = ProfileBuilder(camera, laser, packet, m_format);
+    ProfileBuilder profile;
+    ProfileSoABuilder profile_soa;
+
+    if (m_is_scan_soa) {
+      jsProfileSoA *p = m_pool_soa.Acquire();
+      if (nullptr == p) {
+        // no free profile to assemble into; discard the packet
+        return;
+      }
+      profile_soa = ProfileSoABuilder(p, camera, laser, packet, m_scan_format,
+                                      m_scan_stride);
+    } else {
+      jsRawProfile *p = m_pool.Acquire();
+      if (nullptr == p) {
+        // no free profile to assemble into; discard the packet
+        return;
+      }
+
+      // compaction only looks at entries on the stride and overwrites the
+      // others, so they are never clean afterwards
+      uint8_t &clean_stride = m_pool_clean_stride[m_pool.IndexOf(p)];
+      const bool is_clean =
+        m_is_scan_compact || (m_scan_stride == clean_stride);
+      clean_stride = m_is_scan_compact ? 0 : m_scan_stride;
+      profile = ProfileBuilder(p, camera, laser, packet, m_scan_format,
+                               m_scan_stride, is_clean);
+    }
+
+    slot = m_reassembly.Insert(source, timestamp, total_packets);
+    if (nullptr == slot) {
+      // too many profiles in flight, give up on the oldest
+      FinishProfile(m_reassembly.FindOldest(), false);
+      slot = m_reassembly.Insert(source, timestamp, total_packets);
+    }
+
+    slot->profile = profile;
+    slot->profile_soa = profile_soa;
+    slot->camera = camera;
+    slot->laser = laser;
   }
 
-  // server sends int16_t x/y data points; invalid is int16_t minimum
-  const int16_t INVALID_XY = -32768;
-  const jsCamera camera = m_profile.raw->camera;
-  const jsLaser laser = m_profile.raw->laser;
-  std::pair<jsCamera, jsLaser> pair(camera, laser);
-  AlignmentParams *alignment = &m_map_alignment[pair];
+  const CameraToMillTransform &transform =
+    m_scan_transforms[slot->camera][slot->laser];
+  const uint8_t *xy_src = nullptr;
+  const uint8_t *b_src = nullptr;
+  uint32_t num_vals = 0;
+  uint32_t inc = 0;
+  uint32_t idx = 0;
 
   // if Brightness, assume X/Y data is present
   if (datatype_mask & DataType::Brightness) {
     FragmentLayout b_layout = packet.GetFragmentLayout(DataType::Brightness);
     FragmentLayout xy_layout = packet.GetFragmentLayout(DataType::XYData);
-    uint8_t *b_src = reinterpret_cast<uint8_t *>(&(raw[b_layout.offset]));
-    int16_t *xy_src = reinterpret_cast<int16_t *>(&(raw[xy_layout.offset]));
+    b_src = &(raw[b_layout.offset]);
+    xy_src = &(raw[xy_layout.offset]);
     const uint32_t start_column = packet.GetStartColumn();
-    const jsCamera id = m_profile.raw->camera;
 
     // assume step is the same for both layouts
-    const uint32_t inc = total_packets * xy_layout.step;
-    uint32_t idx = start_column + current_packet * xy_layout.step;
-
+    inc = total_packets * xy_layout.step;
+    idx = start_column + current_packet * xy_layout.step;
     // assume num_vals is same for both layouts
-    for (uint32_t n = 0; n < xy_layout.num_vals; n++) {
-      int16_t x_raw = htons(*xy_src++);
-      int16_t y_raw = htons(*xy_src++);
-      uint8_t brightness = *b_src++;
-
-      if ((INVALID_XY != x_raw) && (INVALID_XY != y_raw)) {
-        int32_t x = static_cast<int32_t>(x_raw);
-        int32_t y = static_cast<int32_t>(y_raw);
-
-        Point2D<int32_t> point = alignment->CameraToMill(x, y);
-        m_profile.InsertPointAndBrightness(idx, point, brightness);
-      }
-
-      idx += inc;
-    }
+    num_vals = xy_layout.num_vals;
   } else if (datatype_mask & DataType::XYData) {
     FragmentLayout layout = packet.GetFragmentLayout(DataType::XYData);
-    int16_t *src = reinterpret_cast<int16_t *>(&(raw[layout.offset]));
+    xy_src = &(raw[layout.offset]);
     const uint32_t start_column = packet.GetStartColumn();
-    const jsCamera id = m_profile.raw->camera;
-
-    const uint32_t inc = total_packets * layout.step;
-    uint32_t idx = start_column + current_packet * layout.step;
 
-    for (unsigned int j = 0; j < layout.num_vals; j++) {
-      int16_t x_raw = htons(*src++);
-      int16_t y_raw = htons(*src++);
-
-      if ((INVALID_XY != x_raw) && (INVALID_XY != y_raw)) {
-        int32_t x = static_cast<int32_t>(x_raw);
-        int32_t y = static_cast<int32_t>(y_raw);
-
-        Point2D<int32_t> point = alignment->CameraToMill(x, y);
-        m_profile.InsertPoint(idx, point);
-      }
-
-      idx += inc;
-    }
+    inc = total_packets * layout.step;
+    idx = start_column + current_packet * layout.step;
+    num_vals = layout.num_vals;
   }
 
 #if 0
@@ -1508,73 +1903,418 @@ void ScanHead::ProcessProfile(uint8_t *buf, uint32_t len)
         m += (j * total_packets + current_packet) * layout.step;
 
         Point2D point(pixel, m);
-        m_profile.InsertPixelCoordinate(m, point);
+        profile.InsertPixelCoordinate(m, point);
       }
     }
   }
 #endif
 
-  m_packets_received_for_profile++;
-  if (m_packets_received_for_profile == total_packets) {
-    std::unique_lock<std::mutex> lock(m_mutex);
+  if (nullptr != xy_src) {
+    if (!m_is_scan_soa &&
+        ((0 != (idx % m_scan_stride)) || (0 != (inc % m_scan_stride)))) {
+      // data off the stride is not expected from the scan head, but if it
+      // ever is sent the whole data array must be initialized for next use
+      m_pool_clean_stride[m_pool.IndexOf(slot->profile.raw)] = 0;
+    }
+
+    if (m_is_scan_soa) {
+      slot->profile_soa.InsertPoints(idx, inc, xy_src, b_src, num_vals,
+                                     transform);
+    } else {
+      slot->profile.InsertPoints(current_packet, idx, inc, xy_src, b_src,
+                                 num_vals, transform);
+    }
+  }
+
+  if (m_reassembly.AddPacket(slot)) {
     // received all packets for the profile
-    m_profile.SetPacketInfo(total_packets, total_packets);
-    m_circ_buffer.push_back(m_profile.raw);
-    m_receive_thread_data_sync.notify_all();
-    m_profile = ProfileBuilder();
-    m_last_profile_source = 0;
-    m_last_profile_timestamp = 0;
-    m_complete_profiles_received++;
+    FinishProfile(slot, true);
   }
 }
 
-void ScanHead::ReceiveMain()
+void ScanHead::FinishProfile(ReassemblyTable::Slot *slot, bool is_complete)
 {
-#ifndef __linux__
-  // bump up thread priority; receiving profiles is the most important thing
-  // for end users
-  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
-#endif
+  if (m_is_scan_soa) {
+    ProfileSoABuilder &profile = slot->profile_soa;
+    profile.SetPacketInfo(slot->packets_received, slot->packets_expected);
+    // always compacted, invalid points have no representation
+    profile.Compact(m_scan_stride);
+    PushProfile(profile.profile);
+  } else {
+    ProfileBuilder &profile = slot->profile;
+    profile.SetPacketInfo(slot->packets_received, slot->packets_expected);
+    if (m_is_scan_compact) {
+      profile.Compact(m_scan_stride);
+    } else {
+      profile.Fill();
+    }
+    FilterProfile(profile.raw);
+  }
 
-  while (m_is_receive_thread_active) {
-    uint8_t *buf = m_packet_buf;
-#ifdef __linux__
-    size_t buf_len = m_packet_buf_len;
-#else
-    int buf_len = m_packet_buf_len;
-#endif
+  m_reassembly.Remove(slot, is_complete);
+}
 
-    uint32_t total_len = 0;
-    char *dst = reinterpret_cast<char *>(&total_len);
-    int r = 0;
+void ScanHead::PrepareScanning()
+{
+  // private function, assume config and control mutexes are already locked
 
-    // ASSUMPTION: operating system isn't going to break apart a 32bit word
-    r = recv(m_data_tcp_fd, dst, sizeof(uint32_t), 0);
-    assert((0 == r) || (sizeof(uint32_t) == r));
+  // late data from a previous scan may still be arriving; have the receive
+  // path drop it, and wait for it to be idle, before resetting its state
+  m_is_scanning.store(false, std::memory_order_seq_cst);
+  WaitForReceiveIdle();
 
-    uint32_t len = 0;
-    while (m_is_receive_thread_active && (len < total_len)) {
-      dst = reinterpret_cast<char*>(buf + len);
-      r = recv(m_data_tcp_fd, dst, total_len - len, 0);
-      if (0 > r) {
-        if (errno == EAGAIN) continue;
-        if (errno == 0) continue; // this happens sometimes, wtf does it mean?
+  ReleaseHeldProfiles();
+  m_packets_received = 0;
+  // configuration can't change while scanning; snapshot what the receive path
+  // needs so it never has to take a lock to read it
+  SnapshotScanConfiguration();
+  // reset queue holding profile data
+  ClearProfiles();
+  m_pool.ResetStatistics();
+  m_pool_soa.ResetStatistics();
+  m_reassembly.ResetStatistics();
+  m_profiles_overwritten.store(0, std::memory_order_relaxed);
+  m_profiles_dropped.store(0, std::memory_order_relaxed);
+  m_queue_high_water.store(0, std::memory_order_relaxed);
+}
+
+void ScanHead::SnapshotScanConfiguration()
+{
+  // private function, assume config mutex is already locked
+  for (uint32_t c = 0; c < JS_CAMERA_MAX; c++) {
+    for (uint32_t l = 0; l < JS_LASER_MAX; l++) {
+      std::pair<jsCamera, jsLaser> pair(static_cast<jsCamera>(c),
+                                        static_cast<jsLaser>(l));
+      auto iter = m_map_alignment.find(pair);
+      m_scan_transforms[c][l] = (m_map_alignment.end() == iter) ?
+                                AlignmentParams().GetCameraToMillTransform() :
+                                iter->second.GetCameraToMillTransform();
+    }
+  }
 
-        throw std::runtime_error("Recv " + std::to_string(errno) + " " + std::strerror(errno));
-      } else if (0 == r) {
-        // connection closed
-        return;
-      } else {
-        len += r;
+  m_scan_format = m_format;
+  m_scan_stride = m_data_stride;
+  m_is_scan_compact = m_scan_manager.IsProfileCompactionEnabled();
+  m_is_scan_soa = (JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS ==
+                   m_scan_manager.GetProfileLayout());
+  m_scan_dispatcher = m_dispatcher;
+  m_scan_overflow_policy = m_overflow_policy;
+  m_scan_overflow_timeout_us = m_overflow_timeout_us;
+
+  // any profile held by the resamplers or gates has already been released;
+  // profile data is only held at the index of its column if not compacted
+  m_is_scan_resample = (0 != m_resample_ticks) && !m_is_scan_soa;
+  for (auto &resamplers : m_resamplers) {
+    for (auto &resampler : resamplers) {
+      resampler.Configure(m_resample_encoder, m_resample_ticks,
+                          m_resample_mode, !m_is_scan_compact);
+    }
+  }
+  m_is_scan_gated = (0 != m_gate_open_points) && !m_is_scan_soa;
+  for (auto &gates : m_gates) {
+    for (auto &gate : gates) {
+      gate.Configure(m_gate_open_points, m_gate_close_points, m_gate_pre_roll,
+                     m_gate_post_roll);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_consumer_mutex);
+    m_scan_callback = m_profile_callback;
+    m_scan_callback_ctx = m_profile_callback_ctx;
+  }
+}
+
+void ScanHead::ReleaseHeldProfiles()
+{
+  std::lock_guard<std::mutex> lock(m_consumer_mutex);
+  m_reassembly.Clear([this](ReassemblyTable::Slot *slot) {
+    m_pool.Release(slot->profile.raw);
+    m_pool_soa.Release(slot->profile_soa.profile);
+  });
+  for (auto &resamplers : m_resamplers) {
+    for (auto &resampler : resamplers) {
+      m_pool.Release(resampler.Clear());
+      resampler.ResetStatistics();
+    }
+  }
+  for (auto &gates : m_gates) {
+    for (auto &gate : gates) {
+      jsRawProfile *held[PresenceGate::kMaxPreRoll];
+      uint32_t n = gate.Clear(held);
+      for (uint32_t m = 0; m < n; m++) {
+        m_pool.Release(held[m]);
       }
+      gate.ResetStatistics();
     }
+  }
+}
+
+void ScanHead::FilterProfile(jsRawProfile *profile)
+{
+  jsRawProfile *gated[PresenceGate::kMaxPreRoll + 1];
+  jsRawProfile *dropped = nullptr;
+  uint32_t n = 1;
+
+  gated[0] = profile;
+  if (m_is_scan_gated) {
+    PresenceGate &gate = m_gates[profile->camera][profile->laser];
+    n = gate.Add(profile, gated, &dropped);
+    m_pool.Recycle(dropped);
+  }
+
+  for (uint32_t m = 0; m < n; m++) {
+    jsRawProfile *p = gated[m];
 
-    if (m_is_receive_thread_active) {
-      uint16_t magic = (buf[0] << 8) | (buf[1]);
-      if (kDataMagic == magic) {
-        ProcessProfile(buf, len);
+    if (m_is_scan_resample) {
+      ProfileResampler &resampler = m_resamplers[p->camera][p->laser];
+      p = resampler.Add(p, &dropped);
+      m_pool.Recycle(dropped);
+      if (nullptr == p) {
+        continue;
       }
     }
+
+    PushProfile(p);
+  }
+}
+
+template <typename T>
+bool ScanHead::EnqueueProfile(SpscQueue<T *> &queue, ProfilePool<T> &pool,
+                              T *profile)
+{
+  T *oldest = nullptr;
+  bool is_room = true;
+
+  if (JS_OVERFLOW_POLICY_DROP_NEWEST == m_scan_overflow_policy) {
+    // only the consumer changes the size in the meantime, making more room
+    is_room = (queue.Capacity() > queue.Size());
+  } else if (JS_OVERFLOW_POLICY_BLOCK == m_scan_overflow_policy) {
+    is_room = (0 != m_space_wakeup.WaitFor(
+                      1, [&queue] { return queue.Capacity() - queue.Size(); },
+                      m_scan_overflow_timeout_us));
+  } else if (queue.Steal(&oldest)) {
+    // queue is full, the oldest profile is overwritten
+    pool.Recycle(oldest);
+    m_profiles_overwritten.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (!is_room) {
+    pool.Recycle(profile);
+    m_profiles_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // can't fail; either there was room or the oldest profile was evicted
+  queue.Push(profile);
+
+  uint32_t size = queue.Size();
+  if (size > m_queue_high_water.load(std::memory_order_relaxed)) {
+    m_queue_high_water.store(size, std::memory_order_relaxed);
+  }
+
+  return true;
+}
+
+void ScanHead::PushProfile(jsRawProfile *profile)
+{
+  if (nullptr != m_scan_callback) {
+    if (nullptr == m_scan_dispatcher) {
+      // called right from the receive path; the profile is reused as soon as
+      // the callback returns
+      m_scan_callback(profile, m_scan_callback_ctx);
+      m_pool.Recycle(profile);
+      return;
+    }
+
+    if (EnqueueProfile(m_dispatch_queue, m_pool, profile)) {
+      m_scan_dispatcher->Notify();
+    }
+    return;
+  }
+
+  if (EnqueueProfile(m_profile_queue, m_pool, profile)) {
+    m_profile_wakeup.Notify([this] { return AvailableProfiles(); });
+    m_scan_manager.NotifyProfilesAvailable();
+  }
+}
+
+void ScanHead::PushProfile(jsProfileSoA *profile)
+{
+  if (EnqueueProfile(m_profile_queue_soa, m_pool_soa, profile)) {
+    m_profile_wakeup.Notify([this] { return AvailableProfiles(); });
+    m_scan_manager.NotifyProfilesAvailable();
+  }
+}
+
+int ScanHead::ReceiveData()
+{
+  int r = m_stream.Read(m_data_tcp_fd);
+  if (0 >= r) {
+    return r;
+  }
+
+  BeginRecording();
+  ProcessMessages();
+  EndRecording();
+
+  return r;
+}
+
+int ScanHead::ReceiveData(uint8_t *data, uint32_t len)
+{
+  BeginRecording();
+  int r = ProcessData(data, len);
+  EndRecording();
+
+  return r;
+}
+
+void ScanHead::SetRecorder(RecorderChannel *recorder)
+{
+  m_recorder.store(recorder, std::memory_order_seq_cst);
+
+  // once the receive path is seen idle, it will load the new recorder the
+  // next time it runs
+  WaitForReceiveIdle();
+}
+
+void ScanHead::WaitForReceiveIdle()
+{
+  // pairs with `BeginRecording`; anything the receive path loads after this
+  // returns sees what was stored before it was called
+  while (m_is_receive_busy.load(std::memory_order_seq_cst)) {
+    std::this_thread::yield();
+  }
+}
+
+void ScanHead::BeginRecording()
+{
+  m_is_receive_busy.store(true, std::memory_order_seq_cst);
+  m_scan_recorder = m_recorder.load(std::memory_order_seq_cst);
+  if (nullptr != m_scan_recorder) {
+    // one timestamp for everything taken in by a single read
+    m_receive_time_ns = RecordingTimeNs();
+  }
+}
+
+void ScanHead::EndRecording()
+{
+  m_scan_recorder = nullptr;
+  m_is_receive_busy.store(false, std::memory_order_release);
+}
+
+int ScanHead::ProcessData(uint8_t *data, uint32_t len)
+{
+  uint32_t idx = 0;
+
+  // finish off a message left split across the previous buffer, copying in
+  // only as many bytes as the message still needs
+  while (m_is_receive_thread_active && (!m_stream.IsEmpty()) && (idx < len)) {
+    uint32_t needed = m_stream.GetBytesNeeded();
+    uint32_t free_len = 0;
+    uint8_t *dst = m_stream.GetWritePointer(&free_len);
+    uint32_t n = len - idx;
+
+    n = (needed < n) ? needed : n;
+    if (free_len < n) {
+      // message too large to ever fit in the buffer
+      errno = EMSGSIZE;
+      return -1;
+    }
+
+    memcpy(dst, &data[idx], n);
+    m_stream.Commit(n);
+    idx += n;
+
+    ProcessMessages();
+  }
+
+  // process all complete messages directly out of the caller's buffer
+  while (m_is_receive_thread_active && (sizeof(uint32_t) <= (len - idx))) {
+    uint32_t msg_len = 0;
+    memcpy(&msg_len, &data[idx], sizeof(uint32_t));
+    if ((len - idx - sizeof(uint32_t)) < msg_len) {
+      break;
+    }
+
+    ProcessMessage(&data[idx + sizeof(uint32_t)], msg_len);
+    idx += sizeof(uint32_t) + msg_len;
+  }
+
+  // keep the start of a message that continues in the next buffer
+  if (idx < len) {
+    uint32_t free_len = 0;
+    uint8_t *dst = m_stream.GetWritePointer(&free_len);
+    if (free_len < (len - idx)) {
+      errno = EMSGSIZE;
+      return -1;
+    }
+
+    memcpy(dst, &data[idx], len - idx);
+    m_stream.Commit(len - idx);
+  }
+
+  return static_cast<int>(len);
+}
+
+void ScanHead::ProcessMessages()
+{
+  uint8_t *buf = nullptr;
+  uint32_t len = 0;
+
+  while (m_is_receive_thread_active && m_stream.Next(&buf, &len)) {
+    ProcessMessage(buf, len);
+  }
+}
+
+void ScanHead::ProcessMessage(uint8_t *buf, uint32_t len)
+{
+  // data arriving outside of a scan is left over from a previous one
+  if ((sizeof(uint16_t) > len) ||
+      (!m_is_scanning.load(std::memory_order_seq_cst))) {
+    return;
+  }
+
+  if (nullptr != m_scan_recorder) {
+    m_scan_recorder->Record(m_receive_time_ns, buf, len);
+  }
+
+  uint16_t magic = (buf[0] << 8) | (buf[1]);
+  if (kDataMagic == magic) {
+    ProcessProfile(buf, len);
+  }
+}
+
+SOCKET ScanHead::GetDataSocket() const
+{
+  return m_data_tcp_fd;
+}
+
+void ScanHead::ReceiveMain()
+{
+#ifndef __linux__
+  // bump up thread priority; receiving profiles is the most important thing
+  // for end users
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#endif
+
+  while (m_is_receive_thread_active) {
+    int r = ReceiveData();
+    if (0 > r) {
+      // stream can't be recovered from a message too large to read; stop as
+      // if the connection was closed rather than reading it over and over
+      if (errno == EMSGSIZE) return;
+      if (errno == EAGAIN) continue;
+      if (errno == EINTR) continue;
+      if (errno == 0) continue; // this happens sometimes, wtf does it mean?
+      if (!m_is_receive_thread_active) return; // socket closed on disconnect
+
+      throw std::runtime_error("Recv " + std::to_string(errno) + " " + std::strerror(errno));
+    } else if (0 == r) {
+      // connection closed
+      return;
+    }
   }
 }
 
@@ -8,17 +8,24 @@
 #ifndef JOESCAN_SCAN_HEAD_H
 #define JOESCAN_SCAN_HEAD_H
 
+#include "ConsumerWakeup.hpp"
 #include "NetworkInterface.hpp"
+#include "ProfileDispatcher.hpp"
+#include "ProfilePool.hpp"
+#include "PresenceGate.hpp"
+#include "ProfileResampler.hpp"
+#include "ReassemblyTable.hpp"
 #include "ScanManager.hpp"
 #include "ScanWindow.hpp"
 #include "StatusMessage.hpp"
+#include "StreamReader.hpp"
+#include "StreamRecorder.hpp"
 #include "joescan_pinchot.h"
 
 #include "ScanHeadSpecification_generated.h"
-#include "boost/circular_buffer.hpp"
 #include "flatbuffers/flatbuffers.h"
 
-#include <condition_variable>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -126,6 +133,16 @@ class ScanHead {
    */
   int SendKeepAlive();
 
+  /**
+   * Sends Keep Alive message to the scan head, unless the control connection
+   * is in use, such as by a request waiting on its response. Lets the receive
+   * path send keep alives without ever blocking on the control connection.
+   *
+   * @return Boolean `true` if sent, `false` if the connection was in use and
+   * it should be tried again later.
+   */
+  bool TrySendKeepAlive();
+
   /**
    * Performs client request to the scan head to start scanning.
    *
@@ -140,6 +157,62 @@ class ScanHead {
    */
   int StopScanning();
 
+  /**
+   * Readies the receive path to process data passed to `ReceiveData` while
+   * not connected to the scan head, the same as `StartScanning` does for a
+   * connected scan head. Lets the receive path be driven without hardware,
+   * such as when benchmarking it.
+   *
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int StartScanningOffline();
+
+  /**
+   * Stops the receive path started by `StartScanningOffline`. Profiles
+   * already received are left available to read.
+   */
+  void StopScanningOffline();
+
+  /**
+   * Reads in data available on the data socket and processes all complete
+   * messages received. Called by the receive thread of the scan head or by a
+   * `ReceiveReactor` servicing the scan head.
+   *
+   * @return Number of bytes read, `0` if the connection was closed, or
+   * negative value if the read failed with `errno` holding the cause.
+   */
+  int ReceiveData();
+
+  /**
+   * Processes data that was already received from the data socket by other
+   * means, such as by an io_uring `ReceiveReactor`. Complete messages are
+   * processed in place; a message split across buffers is carried over
+   * internally until the rest of it is passed in.
+   *
+   * @param data Pointer to the received data.
+   * @param len The number of bytes received.
+   * @return Number of bytes processed or negative value if a message too large
+   * to buffer was encountered.
+   */
+  int ReceiveData(uint8_t *data, uint32_t len);
+
+  /**
+   * Sets the channel that all data messages received are copied to, as they
+   * are received and before they are processed. Waits for the receive path
+   * to let go of any previous channel before returning, so must not be
+   * called from within a profile callback.
+   *
+   * @param recorder Pointer to the channel, or `nullptr` to stop recording.
+   */
+  void SetRecorder(RecorderChannel *recorder);
+
+  /**
+   * Gets the socket used to receive scan data from the scan head.
+   *
+   * @return The data socket.
+   */
+  SOCKET GetDataSocket() const;
+
   /**
    * Returns boolean confirming connection of the client to the scan head.
    *
@@ -170,6 +243,11 @@ class ScanHead {
    * Returns the number of profiles that are available to be read from calling
    * the `GetProfiles` function.
    *
+   * @note The profile accessors below (`AvailableProfiles`,
+   * `WaitUntilAvailableProfiles`, `GetProfiles`, `ReleaseProfiles` and
+   * `ClearProfiles`) never take a lock shared with the receive thread or the
+   * control connection.
+   *
    * @return The number of profiles able to be read.
    */
   uint32_t AvailableProfiles();
@@ -187,19 +265,149 @@ class ScanHead {
    * Obtains up to the number of scanning profiles requested from the scan
    * head. Note, if the total number of profiles returned from the scan
    * head is less than what is requested, only the actual number of profiles
-   * available will be returned in the vector.
+   * available will be returned. Each profile obtained must be handed back
+   * with `ReleaseProfiles` once the caller is done with it.
    *
-   * @param count The maximum number of profiles to return.
-   * @return Vector holding references to profile data.
+   * @param profiles Array to be filled with pointers to profile data.
+   * @param max_profiles The maximum number of profiles to return.
+   * @return The number of profiles returned in the array.
    */
-  std::vector<std::shared_ptr<jsRawProfile>> GetProfiles(uint32_t count);
+  uint32_t GetProfiles(jsRawProfile **profiles, uint32_t max_profiles);
 
   /**
-   * Empties the circular buffer used to store received profiles from the
-   * scan head.
+   * Same as above, but for profiles assembled with the
+   * `JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS` layout.
+   *
+   * @param profiles Array to be filled with pointers to profile data.
+   * @param max_profiles The maximum number of profiles to return.
+   * @return The number of profiles returned in the array.
+   */
+  uint32_t GetProfiles(jsProfileSoA **profiles, uint32_t max_profiles);
+
+  /**
+   * Returns profiles obtained with `GetProfiles` so that their storage can be
+   * reused for new profile data.
+   *
+   * @param profiles Array of pointers to profile data.
+   * @param count The number of profiles in the array.
+   * @return `0` on success or `JS_ERROR_INVALID_ARGUMENT` if any profile was
+   * not obtained from this scan head or was already returned, in which case
+   * none are returned.
+   */
+  int ReleaseProfiles(jsRawProfile **profiles, uint32_t count);
+
+  /**
+   * Same as above, but for profiles assembled with the
+   * `JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS` layout.
+   *
+   * @param profiles Array of pointers to profile data.
+   * @param count The number of profiles in the array.
+   * @return `0` on success or `JS_ERROR_INVALID_ARGUMENT` if any profile was
+   * not obtained from this scan head or was already returned, in which case
+   * none are returned.
+   */
+  int ReleaseProfiles(jsProfileSoA **profiles, uint32_t count);
+
+  /**
+   * Empties the queue used to store received profiles from the scan head.
    */
   void ClearProfiles();
 
+  /**
+   * Sets a function to be called with each profile as soon as it has been
+   * assembled, in place of storing it in the profile queue. Only applies to
+   * the `JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES` layout.
+   *
+   * @param fn The function to call or `nullptr` to queue profiles instead.
+   * @param ctx Pointer passed along to `fn`.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int RegisterProfileCallback(jsProfileCallback fn, void *ctx);
+
+  /**
+   * Sets how profiles are resampled to fixed encoder spacing before being
+   * queued or passed to the profile callback.
+   *
+   * @param encoder The encoder to resample by.
+   * @param ticks_per_slice Encoder ticks between profiles or `0` to disable.
+   * @param mode How the profile for each slice is produced.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int SetResampling(jsEncoder encoder, uint32_t ticks_per_slice,
+                    jsResampleMode mode);
+
+  /**
+   * Sets how profiles are discarded while nothing is in the scan window,
+   * before being resampled.
+   *
+   * @param open_points Valid points needed to open the gate or `0` to
+   * disable it.
+   * @param close_points Valid points below which the gate closes.
+   * @param pre_roll Profiles passed on from before the gate opens.
+   * @param post_roll Profiles passed on after the gate would close.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int SetPresenceGate(uint32_t open_points, uint32_t close_points,
+                      uint32_t pre_roll, uint32_t post_roll);
+
+  /**
+   * Reallocates the profile queues and pools to buffer a new number of
+   * profiles. Profiles not yet read out are discarded.
+   *
+   * @param capacity The number of profiles to buffer.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int SetProfileBufferCapacity(uint32_t capacity);
+
+  /**
+   * Gets the number of profiles that can be buffered before being read out.
+   *
+   * @return The profile buffer capacity.
+   */
+  uint32_t GetProfileBufferCapacity();
+
+  /**
+   * Sets what happens to newly assembled profiles when the profile queue is
+   * full.
+   *
+   * @param policy What to do when the queue is full.
+   * @param timeout_us Max time to wait for room in the queue in microseconds
+   * with `JS_OVERFLOW_POLICY_BLOCK`.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int SetProfileBufferOverflow(jsOverflowPolicy policy, uint32_t timeout_us);
+
+  /**
+   * Sets the dispatcher thread used to invoke the profile callback. Must only
+   * be called when the receive thread is not running or before scanning.
+   *
+   * @param dispatcher Pointer to the dispatcher or `nullptr` to invoke the
+   * callback directly from the receive path.
+   */
+  void SetProfileDispatcher(ProfileDispatcher *dispatcher);
+
+  /**
+   * Invokes the profile callback for profiles handed over to the dispatcher
+   * and returns them to the pool. Only called by the dispatcher thread.
+   *
+   * @return The number of profiles dispatched.
+   */
+  uint32_t DispatchProfiles();
+
+  /**
+   * Gets the number of profiles waiting on the dispatcher thread.
+   *
+   * @return The number of profiles waiting.
+   */
+  uint32_t PendingDispatch() const;
+
+  /**
+   * Gets statistics about the reception and buffering of profile data.
+   *
+   * @return The receive statistics of the scan head.
+   */
+  jsScanHeadReceiveStatistics GetReceiveStatistics();
+
   /**
    * Requests a new status message from the scan head.
    *
@@ -373,10 +581,15 @@ class ScanHead {
     uint32_t end_offset_us;
   };
 
-  static const int kMaxCircularBufferSize = JS_SCAN_HEAD_PROFILES_MAX;
-  // The JS-50 theoretical max packet size is 8k plus header, in reality the
-  // max size is 1456 * 4 + header. Using 6k.
-  static const int kMaxPacketSize = 6144;
+  static const int kMaxProfileQueueSize = JS_SCAN_HEAD_PROFILES_MAX;
+  // Size of buffer used to read in data from the scan head; the JS-50 max
+  // packet size is 1456 * 4 + header, so many packets fit per `recv` call.
+  static const uint32_t kStreamBufferSize = 256 * 1024;
+  // Profiles held in the pool beyond those that fit in the profile queue;
+  // covers the profile under assembly and those being copied out by the user.
+  static const int kProfilePoolReserve = 64;
+  // Profiles handed to the profile callback per dispatch.
+  static const uint32_t kDispatchBatchSize = 32;
   // JS-50 in image mode will have 4 rows of 1456 pixels for each packet.
   static const int kImageDataSize = 4 * 1456;
   // Port used to access REST interface
@@ -388,11 +601,34 @@ class ScanHead {
   static const uint32_t kMaxLaserDetectionThreshold = 1023;
 
   void LoadScanHeadSpecification(jsScanHeadType type, ScanHeadSpec *spec);
+  int SendKeepAliveLocked();
   uint32_t CameraLaserIdxBegin();
   uint32_t CameraLaserIdxEnd();
   std::pair<jsCamera, jsLaser> CameraLaserNext(uint32_t n);
 
+  void BeginRecording();
+  void EndRecording();
+  void WaitForReceiveIdle();
+  int ProcessData(uint8_t *data, uint32_t len);
+  void ProcessMessages();
+  void ProcessMessage(uint8_t *buf, uint32_t len);
   void ProcessProfile(uint8_t *buf, uint32_t len);
+  void PrepareScanning();
+  void SnapshotScanConfiguration();
+  void ReleaseHeldProfiles();
+  void FilterProfile(jsRawProfile *profile);
+  template <typename T>
+  void BorrowProfiles(ProfilePool<T> &pool, std::vector<uint8_t> &borrowed,
+                      T **profiles, uint32_t count);
+  template <typename T>
+  int ReturnProfiles(ProfilePool<T> &pool, std::vector<uint8_t> &borrowed,
+                     T **profiles, uint32_t count);
+  template <typename T>
+  bool EnqueueProfile(SpscQueue<T *> &queue, ProfilePool<T> &pool,
+                      T *profile);
+  void PushProfile(jsRawProfile *profile);
+  void PushProfile(jsProfileSoA *profile);
+  void FinishProfile(ReassemblyTable::Slot *slot, bool is_complete);
   void ReceiveMain();
   int ResolveIpAddress();
   int TCPSend(flatbuffers::FlatBufferBuilder &builder);
@@ -409,19 +645,76 @@ class ScanHead {
   jsScanHeadConfiguration m_config_default;
   jsScanHeadConfiguration m_config;
   jsDataFormat m_format;
+  // copy of `m_format` taken when scanning starts, for the receive path
+  jsDataFormat m_scan_format;
   jsScanHeadType m_type;
   jsUnits m_units;
   jsCableOrientation m_cable;
 
-  boost::circular_buffer<std::shared_ptr<jsRawProfile>> m_circ_buffer;
+  SpscQueue<jsRawProfile *> m_profile_queue;
+  ProfilePool<jsRawProfile> m_pool;
+  // indexed by position in `m_pool`, the data stride a profile's entries in
+  // between strides are known to be invalid for, or zero if unknown; saves
+  // initializing the full data array for half and quarter data formats
+  std::vector<uint8_t> m_pool_clean_stride;
+  // indexed by position in `m_pool`, set while a profile is handed out by
+  // `GetProfiles` so that a profile can't be released twice
+  std::vector<uint8_t> m_pool_borrowed;
+  // used instead of the above for `JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS`;
+  // pool memory is never touched if the layout is not used
+  SpscQueue<jsProfileSoA *> m_profile_queue_soa;
+  ProfilePool<jsProfileSoA> m_pool_soa;
+  std::vector<uint8_t> m_pool_soa_borrowed;
+  ConsumerWakeup m_profile_wakeup;
+  // profiles waiting on `m_scan_dispatcher` to invoke the profile callback
+  SpscQueue<jsRawProfile *> m_dispatch_queue;
+  // lets the receive thread wait for consumers to make room in a full queue
+  // with `JS_OVERFLOW_POLICY_BLOCK`
+  ConsumerWakeup m_space_wakeup;
+  jsOverflowPolicy m_overflow_policy;
+  uint32_t m_overflow_timeout_us;
+  // copies taken when scanning starts, for the receive path
+  jsOverflowPolicy m_scan_overflow_policy;
+  uint32_t m_scan_overflow_timeout_us;
+  std::atomic<uint64_t> m_profiles_overwritten;
+  std::atomic<uint64_t> m_profiles_dropped;
+  std::atomic<uint32_t> m_queue_high_water;
+  jsProfileCallback m_profile_callback;
+  void *m_profile_callback_ctx;
+  ProfileDispatcher *m_dispatcher;
+  // copies taken when scanning starts; the callback copies are guarded by
+  // `m_consumer_mutex` as they are also read by the dispatcher thread
+  jsProfileCallback m_scan_callback;
+  void *m_scan_callback_ctx;
+  ProfileDispatcher *m_scan_dispatcher;
   flatbuffers::FlatBufferBuilder m_builder;
   std::map<std::pair<jsCamera,jsLaser>, AlignmentParams> m_map_alignment;
   std::map<std::pair<jsCamera,jsLaser>, ScanWindow> m_map_window;
   std::vector<ScanPair> m_scan_pairs;
-  ProfileBuilder m_profile;
-  std::condition_variable m_receive_thread_data_sync;
+  // camera to mill transforms taken when scanning starts, indexed by camera
+  // and laser, for the receive path
+  CameraToMillTransform m_scan_transforms[JS_CAMERA_MAX][JS_LASER_MAX];
+  ReassemblyTable m_reassembly;
+  // indexed by camera and laser, configured when scanning starts
+  ProfileResampler m_resamplers[JS_CAMERA_MAX][JS_LASER_MAX];
+  jsEncoder m_resample_encoder;
+  uint32_t m_resample_ticks;
+  jsResampleMode m_resample_mode;
+  // indexed by camera and laser, configured when scanning starts
+  PresenceGate m_gates[JS_CAMERA_MAX][JS_LASER_MAX];
+  uint32_t m_gate_open_points;
+  uint32_t m_gate_close_points;
+  uint32_t m_gate_pre_roll;
+  uint32_t m_gate_post_roll;
+  StreamReader m_stream;
   std::thread m_receive_thread;
-  std::mutex m_mutex;
+  // guards the control TCP socket and `m_builder`
+  std::mutex m_control_mutex;
+  // guards the configuration; when held with `m_control_mutex`, it must be
+  // locked first
+  std::mutex m_config_mutex;
+  // serializes consumers handing profiles back to `m_pool`
+  std::mutex m_consumer_mutex;
 
   uint32_t m_serial_number;
   uint32_t m_ip_address;
@@ -432,18 +725,26 @@ class ScanHead {
   SOCKET m_control_tcp_fd;
   SOCKET m_data_tcp_fd;
   int m_port;
-  uint8_t *m_packet_buf;
-  uint32_t m_packet_buf_len;
   uint32_t m_scan_period_us;
   uint32_t m_data_type_mask;
   uint32_t m_data_stride;
+  // copies taken when scanning starts, for the receive path
+  uint32_t m_scan_stride;
+  bool m_is_scan_compact;
+  bool m_is_scan_soa;
+  bool m_is_scan_resample;
+  bool m_is_scan_gated;
   uint64_t m_packets_received;
-  uint32_t m_packets_received_for_profile;
-  uint64_t m_complete_profiles_received;
-  uint32_t m_last_profile_source;
-  uint64_t m_last_profile_timestamp;
+  // recording channel set by the scan manager, and whether the receive path
+  // is running; together these let it be changed without locking
+  std::atomic<RecorderChannel *> m_recorder;
+  std::atomic<bool> m_is_receive_busy;
+  // copy of `m_recorder` and receive time taken for each read
+  RecorderChannel *m_scan_recorder;
+  uint64_t m_receive_time_ns;
   bool m_is_receive_thread_active;
-  bool m_is_scanning;
+  // read by the receive path to drop data arriving outside of a scan
+  std::atomic<bool> m_is_scanning;
 };
 } // namespace joescan
 
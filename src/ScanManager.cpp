@@ -9,13 +9,17 @@
 #include "ScanHead.hpp"
 
 #include "BroadcastDiscover.hpp"
+#include "IoUring.hpp"
 #include "NetworkInterface.hpp"
 #include "NetworkTypes.hpp"
 #include "ProfileBuilder.hpp"
 #include "StatusMessage.hpp"
 
 #include "MessageClient_generated.h"
+#include "ScanHeadType_generated.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <ctime>
@@ -29,7 +33,14 @@ uint32_t ScanManager::m_uid_count = 0;
 
 ScanManager::ScanManager(jsUnits units) :
   m_state(SystemState::Disconnected),
-  m_units(units)
+  m_units(units),
+  m_receive_mode(JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD),
+  m_receive_threads(0),
+  m_is_profile_compaction_enabled(false),
+  m_profile_layout(JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES),
+  m_callback_threads(0),
+  m_is_frame_assembly_enabled(false),
+  m_frame_timeout_us(0)
 {
   m_uid = ++m_uid_count;
 
@@ -38,6 +49,14 @@ ScanManager::ScanManager(jsUnits units) :
 
 ScanManager::~ScanManager()
 {
+  // reactors and dispatchers reference the scan heads, stop them before the
+  // heads go away
+  if (SystemState::Replaying == m_state) {
+    StopReplay();
+  }
+  StopReactors();
+  StopDispatchers();
+  StopRecording();
   RemoveAllScanHeads();
 }
 
@@ -48,6 +67,10 @@ uint32_t ScanManager::GetUID()
 
 int32_t ScanManager::Discover()
 {
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
   if (IsConnected()) {
     return JS_ERROR_CONNECTED;
   }
@@ -161,6 +184,12 @@ int32_t ScanManager::RemoveScanHead(uint32_t serial_number)
     return JS_ERROR_INVALID_ARGUMENT;
   }
 
+  {
+    // frames may hold profiles of the scan head and point to it
+    std::lock_guard<std::mutex> lock(m_frame_mutex);
+    m_frames.Configure(std::vector<FrameAssembler::Element>(), 0, 0);
+  }
+
   uint32_t id = res->second->GetId();
   delete res->second;
 
@@ -232,9 +261,21 @@ int32_t ScanManager::Connect(uint32_t timeout_s)
     connected[serial] = scan_head;
   }
 
-  if (connected.size() == m_serial_to_scan_head.size()) {
-    int r = 0;
+  jsReceiveMode mode = GetReceiveMode();
+  if ((JS_RECEIVE_MODE_REACTOR == mode) || (JS_RECEIVE_MODE_IO_URING == mode)) {
+    int r = StartReactors(connected);
+    if (0 != r) {
+      return r;
+    }
+  }
 
+  int r = StartDispatchers(connected);
+  if (0 != r) {
+    StopReactors();
+    return r;
+  }
+
+  if (connected.size() == m_serial_to_scan_head.size()) {
     for (auto const &pair : m_serial_to_scan_head) {
       ScanHead *sh = pair.second;
       sh->SendWindow();
@@ -256,6 +297,13 @@ int32_t ScanManager::Connect(uint32_t timeout_s)
     }
   }
 
+  if (SystemState::Connected != m_state) {
+    // connecting is retried from scratch; nothing may be left servicing the
+    // scan heads in the meantime
+    StopReactors();
+    StopDispatchers();
+  }
+
   return int32_t(connected.size());
 }
 
@@ -273,11 +321,16 @@ void ScanManager::Disconnect()
     throw std::runtime_error(error_msg);
   }
 
+  StopReactors();
+
   for (auto const &pair : m_serial_to_scan_head) {
     ScanHead *scan_head = pair.second;
     scan_head->Disconnect();
   }
 
+  // receive threads are stopped, nothing more can be handed to dispatchers
+  StopDispatchers();
+
   m_state = SystemState::Disconnected;
 }
 
@@ -343,6 +396,22 @@ int ScanManager::StartScanning(uint32_t period_us, jsDataFormat fmt)
     }
   }
 
+  if ((nullptr != m_recorder) && m_recorder->IsRecording()) {
+    // lets a replay reproduce the configuration the data was scanned with
+    RecordScanHeads();
+  }
+
+  {
+    // frames left over from the last scan are dropped
+    std::lock_guard<std::mutex> lock(m_frame_mutex);
+    if (m_is_frame_assembly_enabled) {
+      m_frames.Configure(FrameAssembler::GetElements(table), period_us,
+                         m_frame_timeout_us);
+    } else {
+      m_frames.Configure(std::vector<FrameAssembler::Element>(), 0, 0);
+    }
+  }
+
   for (auto const &pair : m_serial_to_scan_head) {
     ScanHead *scan_head = pair.second;
 
@@ -353,6 +422,15 @@ int ScanManager::StartScanning(uint32_t period_us, jsDataFormat fmt)
   }
 
   m_state = SystemState::Scanning;
+#ifdef __linux__
+  if (!m_reactors.empty()) {
+    // keep alives are sent from the reactor threads
+    for (auto &reactor : m_reactors) {
+      reactor->SetKeepAlive(true);
+    }
+    return 0;
+  }
+#endif
   std::thread keep_alive_thread(&ScanManager::KeepAliveThread, this);
   m_keep_alive_thread = std::move(keep_alive_thread);
 
@@ -363,6 +441,10 @@ int32_t ScanManager::StopScanning()
 {
   using namespace schema::client;
 
+  if (SystemState::Replaying == m_state) {
+    return StopReplay();
+  }
+
   if (!IsConnected()) {
     return JS_ERROR_NOT_CONNECTED;
   }
@@ -382,7 +464,15 @@ int32_t ScanManager::StopScanning()
   }
 
   m_condition.notify_all();
-  m_keep_alive_thread.join();
+  if (m_keep_alive_thread.joinable()) {
+    m_keep_alive_thread.join();
+  }
+
+#ifdef __linux__
+  for (auto &reactor : m_reactors) {
+    reactor->SetKeepAlive(false);
+  }
+#endif
 
   return 0;
 }
@@ -407,11 +497,619 @@ uint32_t ScanManager::GetMinScanPeriod()
   return camera_offset_us + table.total_duration_us;
 }
 
+int32_t ScanManager::SetReceiveMode(jsReceiveMode mode, uint32_t num_threads)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if (IsConnected()) {
+    return JS_ERROR_CONNECTED;
+  }
+
+  if ((JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD != mode) &&
+      (JS_RECEIVE_MODE_REACTOR != mode) &&
+      (JS_RECEIVE_MODE_IO_URING != mode)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  m_receive_mode = mode;
+  m_receive_threads = num_threads;
+
+  return 0;
+}
+
+jsReceiveMode ScanManager::GetReceiveMode() const
+{
+#ifdef __linux__
+#ifdef JOESCAN_HAVE_IO_URING
+  if ((JS_RECEIVE_MODE_IO_URING == m_receive_mode) && IoUring::IsSupported()) {
+    return JS_RECEIVE_MODE_IO_URING;
+  }
+#endif
+  if (JS_RECEIVE_MODE_IO_URING == m_receive_mode) {
+    // kernel or build lacks io_uring support, use existing receive path
+    return JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD;
+  }
+
+  return m_receive_mode;
+#else
+  // reactor relies on epoll; fall back to a thread per scan head
+  return JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD;
+#endif
+}
+
+int32_t ScanManager::SetProfileCompaction(bool is_enabled)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  m_is_profile_compaction_enabled = is_enabled;
+
+  return 0;
+}
+
+bool ScanManager::IsProfileCompactionEnabled() const
+{
+  return m_is_profile_compaction_enabled;
+}
+
+int32_t ScanManager::SetProfileLayout(jsProfileLayout layout)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if ((JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES != layout) &&
+      (JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS != layout)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if ((JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS == layout) &&
+      m_is_frame_assembly_enabled) {
+    // frames only hold `jsRawProfile` data
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  m_profile_layout = layout;
+
+  return 0;
+}
+
+jsProfileLayout ScanManager::GetProfileLayout() const
+{
+  return m_profile_layout;
+}
+
+int32_t ScanManager::SetProfileCallbackThreads(uint32_t num_threads)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if (IsConnected()) {
+    return JS_ERROR_CONNECTED;
+  }
+
+  m_callback_threads = num_threads;
+
+  return 0;
+}
+
+uint32_t ScanManager::AvailableProfiles()
+{
+  uint32_t total = 0;
+
+  for (auto const &pair : m_serial_to_scan_head) {
+    total += pair.second->AvailableProfiles();
+  }
+
+  return total;
+}
+
+uint32_t ScanManager::WaitUntilAvailableProfiles(uint32_t count,
+                                                 uint32_t timeout_us,
+                                                 uint32_t *ids,
+                                                 uint32_t max_ids)
+{
+  uint32_t total = m_profile_wakeup.WaitFor(
+    count, [this] { return AvailableProfiles(); }, timeout_us);
+
+  if (0 == total) {
+    return 0;
+  }
+
+  uint32_t n = 0;
+  for (auto const &pair : m_id_to_scan_head) {
+    if (max_ids <= n) {
+      break;
+    }
+
+    if (0 != pair.second->AvailableProfiles()) {
+      ids[n++] = pair.first;
+    }
+  }
+
+  return n;
+}
+
+void ScanManager::NotifyProfilesAvailable()
+{
+  m_profile_wakeup.Notify([this] { return AvailableProfiles(); });
+}
+
+int32_t ScanManager::SetFrameAssembly(bool is_enabled, uint32_t timeout_us)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if (is_enabled && ((0 == timeout_us) ||
+      (JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS == m_profile_layout))) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  std::lock_guard<std::mutex> lock(m_frame_mutex);
+  m_is_frame_assembly_enabled = is_enabled;
+  m_frame_timeout_us = timeout_us;
+
+  return 0;
+}
+
+uint32_t ScanManager::GetFrameSize()
+{
+  auto table = m_phase_table.CalculatePhaseTable();
+
+  return static_cast<uint32_t>(FrameAssembler::GetElements(table).size());
+}
+
+int32_t ScanManager::GetFrameElement(uint32_t index, uint32_t *id,
+                                     jsCamera *camera, jsLaser *laser)
+{
+  auto table = m_phase_table.CalculatePhaseTable();
+  auto elements = FrameAssembler::GetElements(table);
+
+  if (elements.size() <= index) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  *id = elements[index].scan_head_id;
+  *camera = elements[index].camera;
+  *laser = elements[index].laser;
+
+  return 0;
+}
+
+int32_t ScanManager::WaitUntilFrameAvailable(uint32_t timeout_us)
+{
+  using namespace std::chrono;
+
+  auto deadline = steady_clock::now() + microseconds(timeout_us);
+
+  std::unique_lock<std::mutex> lock(m_frame_mutex);
+  if (!m_is_frame_assembly_enabled) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  while (1) {
+    uint32_t n = m_frames.Poll();
+    auto now = steady_clock::now();
+    if ((0 != n) || (now >= deadline)) {
+      return static_cast<int32_t>(n);
+    }
+
+    // wake up on new profiles or once the oldest frame in progress times out;
+    // round up so we don't wake up just short of the timeout
+    auto wake = (std::min)(deadline, m_frames.GetDeadline());
+    uint32_t wait_us =
+      static_cast<uint32_t>(duration_cast<microseconds>(wake - now).count()) +
+      1;
+
+    lock.unlock();
+    m_profile_wakeup.WaitFor(
+      1, [this] { return AvailableProfiles(); }, wait_us);
+    lock.lock();
+  }
+}
+
+int32_t ScanManager::GetFrame(jsFrameInfo *info, jsRawProfile **profiles,
+                              uint32_t max_profiles)
+{
+  std::lock_guard<std::mutex> lock(m_frame_mutex);
+  if (!m_is_frame_assembly_enabled) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  uint32_t frame_size = m_frames.GetFrameSize();
+  if (max_profiles < frame_size) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (!m_frames.Pop(info, profiles)) {
+    // caller may not have waited, sort in what has been received since
+    m_frames.Poll();
+    if (!m_frames.Pop(info, profiles)) {
+      return 0;
+    }
+  }
+
+  return static_cast<int32_t>(frame_size);
+}
+
+int32_t ScanManager::ReleaseFrame(jsRawProfile **profiles, uint32_t count)
+{
+  std::lock_guard<std::mutex> lock(m_frame_mutex);
+
+  return m_frames.Release(profiles, count);
+}
+
+int32_t ScanManager::StartRecording(const std::string &path,
+                                    uint64_t max_file_bytes,
+                                    uint32_t max_file_s, bool is_direct_io)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  int32_t r = StopRecording();
+  if (0 != r) {
+    return r;
+  }
+
+  std::vector<uint32_t> serial_numbers;
+  for (auto const &pair : m_serial_to_scan_head) {
+    serial_numbers.push_back(pair.first);
+  }
+
+  std::unique_ptr<StreamRecorder> recorder(new StreamRecorder());
+  r = recorder->Start(path, max_file_bytes, max_file_s, is_direct_io,
+                      serial_numbers);
+  if (0 != r) {
+    return r;
+  }
+
+  m_recorder = std::move(recorder);
+  RecordScanHeads();
+
+  for (auto const &pair : m_serial_to_scan_head) {
+    ScanHead *scan_head = pair.second;
+    scan_head->SetRecorder(m_recorder->GetChannel(pair.first));
+  }
+
+  return 0;
+}
+
+int32_t ScanManager::StopRecording()
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if ((nullptr == m_recorder) || !m_recorder->IsRecording()) {
+    return 0;
+  }
+
+  // the receive path must let go of the channels before they are drained
+  for (auto const &pair : m_serial_to_scan_head) {
+    ScanHead *scan_head = pair.second;
+    scan_head->SetRecorder(nullptr);
+  }
+
+  m_recorder->Stop();
+
+  return 0;
+}
+
+int32_t ScanManager::GetRecordingStatistics(jsRecordingStatistics *stats)
+{
+  if (nullptr == m_recorder) {
+    memset(stats, 0, sizeof(jsRecordingStatistics));
+    return 0;
+  }
+
+  m_recorder->GetStatistics(stats);
+
+  return 0;
+}
+
+void ScanManager::RecordScanHeads()
+{
+  std::vector<RecordedScanHead> recorded;
+
+  for (auto const &pair : m_serial_to_scan_head) {
+    ScanHead *scan_head = pair.second;
+    auto version = scan_head->GetFirmwareVersion();
+    RecordedScanHead info;
+    memset(&info, 0, sizeof(info));
+    info.serial_number = scan_head->GetSerialNumber();
+    info.id = scan_head->GetId();
+    info.type = scan_head->GetType();
+    info.firmware_version_major = std::get<0>(version);
+    info.firmware_version_minor = std::get<1>(version);
+    info.firmware_version_patch = std::get<2>(version);
+    info.format = scan_head->GetDataFormat();
+    info.scan_period_us = scan_head->GetScanPeriod();
+    recorded.push_back(info);
+  }
+
+  m_recorder->RecordScanHeads(recorded);
+}
+
+int32_t ScanManager::OpenReplay(const std::string &path)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if (IsConnected()) {
+    return JS_ERROR_CONNECTED;
+  }
+
+  std::vector<RecordedScanHead> recorded;
+  int32_t r = StreamReplayer::ReadScanHeads(path, &recorded);
+  if (0 != r) {
+    return r;
+  }
+
+  m_replay_path = path;
+  m_replay_scan_heads.clear();
+  for (auto const &info : recorded) {
+    auto discovered = std::make_shared<jsDiscovered>();
+    memset(discovered.get(), 0, sizeof(jsDiscovered));
+    discovered->serial_number = info.serial_number;
+    discovered->type = static_cast<jsScanHeadType>(info.type);
+    discovered->firmware_version_major = info.firmware_version_major;
+    discovered->firmware_version_minor = info.firmware_version_minor;
+    discovered->firmware_version_patch = info.firmware_version_patch;
+    strncpy(discovered->type_str,
+            schema::EnumNameScanHeadType(
+              static_cast<schema::ScanHeadType>(info.type)),
+            JS_SCAN_HEAD_TYPE_STR_MAX_LEN - 1);
+
+    m_serial_to_discovered[info.serial_number] = discovered;
+    m_replay_scan_heads[info.serial_number] = info;
+  }
+
+  return int32_t(recorded.size());
+}
+
+int32_t ScanManager::StartReplay(double speed)
+{
+  if (IsScanning()) {
+    return JS_ERROR_SCANNING;
+  }
+
+  if (IsConnected()) {
+    return JS_ERROR_CONNECTED;
+  }
+
+  if (m_replay_path.empty() || (0.0 > speed)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  // only scan heads that were recorded get data
+  std::map<uint32_t, ScanHead *> scan_heads;
+  uint32_t period_us = 0;
+  for (auto const &pair : m_serial_to_scan_head) {
+    auto iter = m_replay_scan_heads.find(pair.first);
+    if (m_replay_scan_heads.end() == iter) {
+      continue;
+    }
+
+    ScanHead *scan_head = pair.second;
+    const RecordedScanHead &info = iter->second;
+    int32_t r = scan_head->SetDataFormat(static_cast<jsDataFormat>(info.format));
+    if (0 != r) {
+      return r;
+    }
+
+    r = scan_head->SetScanPeriod(info.scan_period_us);
+    if (0 != r) {
+      return r;
+    }
+
+    period_us = info.scan_period_us;
+    scan_heads[pair.first] = scan_head;
+  }
+
+  if (scan_heads.empty()) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  {
+    // frames left over from the last scan are dropped
+    auto table = m_phase_table.CalculatePhaseTable();
+    std::lock_guard<std::mutex> lock(m_frame_mutex);
+    if (m_is_frame_assembly_enabled) {
+      m_frames.Configure(FrameAssembler::GetElements(table), period_us,
+                         m_frame_timeout_us);
+    } else {
+      m_frames.Configure(std::vector<FrameAssembler::Element>(), 0, 0);
+    }
+  }
+
+  int32_t r = StartDispatchers(scan_heads);
+  if (0 != r) {
+    return r;
+  }
+
+  for (auto const &pair : scan_heads) {
+    r = pair.second->StartScanningOffline();
+    if (0 != r) {
+      break;
+    }
+  }
+
+  if (0 == r) {
+    if (nullptr == m_replayer) {
+      m_replayer.reset(new StreamReplayer());
+    }
+    r = m_replayer->Start(m_replay_path, speed, scan_heads);
+  }
+
+  if (0 != r) {
+    for (auto const &pair : scan_heads) {
+      pair.second->StopScanningOffline();
+    }
+    StopDispatchers();
+    return r;
+  }
+
+  m_state = SystemState::Replaying;
+
+  return 0;
+}
+
+int32_t ScanManager::StopReplay()
+{
+  if (SystemState::Replaying != m_state) {
+    return JS_ERROR_NOT_SCANNING;
+  }
+
+  m_replayer->Stop();
+
+  for (auto const &pair : m_serial_to_scan_head) {
+    pair.second->StopScanningOffline();
+  }
+
+  // replay threads are stopped, nothing more can be handed to dispatchers
+  StopDispatchers();
+
+  m_state = SystemState::Disconnected;
+
+  return 0;
+}
+
+int32_t ScanManager::GetReplayStatistics(jsReplayStatistics *stats)
+{
+  if (nullptr == m_replayer) {
+    memset(stats, 0, sizeof(jsReplayStatistics));
+    return 0;
+  }
+
+  m_replayer->GetStatistics(stats);
+
+  return 0;
+}
+
 jsUnits ScanManager::GetUnits() const
 {
   return m_units;
 }
 
+int32_t ScanManager::StartReactors(std::map<uint32_t, ScanHead *> &scan_heads)
+{
+#ifdef __linux__
+  // in case a previous connection attempt left some running
+  StopReactors();
+
+  uint32_t num_heads = static_cast<uint32_t>(scan_heads.size());
+  uint32_t num_reactors = m_receive_threads;
+
+  if (0 == num_heads) {
+    return 0;
+  }
+
+  if (0 == num_reactors) {
+    num_reactors = (num_heads + kScanHeadsPerReactor - 1) /
+                   kScanHeadsPerReactor;
+    if (kMaxDefaultReactors < num_reactors) {
+      num_reactors = kMaxDefaultReactors;
+    }
+  }
+
+  if (num_reactors > num_heads) {
+    num_reactors = num_heads;
+  }
+
+  jsReceiveMode mode = GetReceiveMode();
+  for (uint32_t n = 0; n < num_reactors; n++) {
+    m_reactors.emplace_back(new ReceiveReactor(mode));
+  }
+
+  // spread scan heads evenly over the reactors
+  uint32_t n = 0;
+  for (auto const &pair : scan_heads) {
+    m_reactors[n++ % num_reactors]->AddScanHead(pair.second);
+  }
+
+  for (auto &reactor : m_reactors) {
+    int r = reactor->Start();
+    if (0 != r) {
+      StopReactors();
+      return r;
+    }
+  }
+#else
+  (void)scan_heads;
+#endif
+
+  return 0;
+}
+
+void ScanManager::StopReactors()
+{
+#ifdef __linux__
+  for (auto &reactor : m_reactors) {
+    reactor->Stop();
+  }
+  m_reactors.clear();
+#endif
+}
+
+int32_t ScanManager::StartDispatchers(
+  std::map<uint32_t, ScanHead *> &scan_heads)
+{
+  // in case a previous connection attempt left some running
+  StopDispatchers();
+
+  uint32_t num_heads = static_cast<uint32_t>(scan_heads.size());
+  uint32_t num_dispatchers = m_callback_threads;
+
+  if ((0 == num_heads) || (0 == num_dispatchers)) {
+    return 0;
+  }
+
+  if (num_dispatchers > num_heads) {
+    num_dispatchers = num_heads;
+  }
+
+  for (uint32_t n = 0; n < num_dispatchers; n++) {
+    m_dispatchers.emplace_back(new ProfileDispatcher());
+  }
+
+  // spread scan heads evenly over the dispatchers
+  uint32_t n = 0;
+  for (auto const &pair : scan_heads) {
+    ProfileDispatcher *dispatcher = m_dispatchers[n++ % num_dispatchers].get();
+    dispatcher->AddScanHead(pair.second);
+    pair.second->SetProfileDispatcher(dispatcher);
+  }
+
+  for (auto &dispatcher : m_dispatchers) {
+    int r = dispatcher->Start();
+    if (0 != r) {
+      StopDispatchers();
+      return r;
+    }
+  }
+
+  return 0;
+}
+
+void ScanManager::StopDispatchers()
+{
+  for (auto &dispatcher : m_dispatchers) {
+    dispatcher->Stop();
+  }
+  m_dispatchers.clear();
+
+  for (auto const &pair : m_serial_to_scan_head) {
+    pair.second->SetProfileDispatcher(nullptr);
+  }
+}
+
 void ScanManager::KeepAliveThread()
 {
   const uint32_t keep_alive_send_ms = 1000;
@@ -9,15 +9,23 @@
 #define JOESCAN_SCAN_MANAGER_H
 
 #include "AlignmentParams.hpp"
+#include "ConsumerWakeup.hpp"
+#include "FrameAssembler.hpp"
 #include "PhaseTable.hpp"
 #include "ProfileBuilder.hpp"
+#include "ProfileDispatcher.hpp"
+#include "ReceiveReactor.hpp"
+#include "StreamRecorder.hpp"
+#include "StreamReplayer.hpp"
 #include "joescan_pinchot.h"
 
 #include <condition_variable>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace joescan {
 class ScanHead;
@@ -163,6 +171,232 @@ class ScanManager {
    */
   uint32_t GetMinScanPeriod();
 
+  /**
+   * @brief Sets how scan data is received from the `ScanHead` objects.
+   *
+   * @param mode The receive mode to use.
+   * @param num_threads The number of threads to use for the
+   * `JS_RECEIVE_MODE_REACTOR` and `JS_RECEIVE_MODE_IO_URING` modes or `0` to
+   * select automatically.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t SetReceiveMode(jsReceiveMode mode, uint32_t num_threads);
+
+  /**
+   * @brief Gets how scan data is received from the `ScanHead` objects. On
+   * platforms where the requested mode is not available, the mode that will
+   * be used instead is returned.
+   *
+   * @return The receive mode.
+   */
+  jsReceiveMode GetReceiveMode() const;
+
+  /**
+   * @brief Sets whether profiles are compacted as they are assembled, so only
+   * valid points are held at the front of the profile data.
+   *
+   * @param is_enabled Boolean `true` to compact profiles.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t SetProfileCompaction(bool is_enabled);
+
+  /**
+   * @brief Gets whether profiles are compacted as they are assembled.
+   *
+   * @return Boolean `true` if profiles are compacted.
+   */
+  bool IsProfileCompactionEnabled() const;
+
+  /**
+   * @brief Sets how profile data is laid out in memory as profiles are
+   * assembled.
+   *
+   * @param layout The profile layout to use.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t SetProfileLayout(jsProfileLayout layout);
+
+  /**
+   * @brief Gets how profile data is laid out in memory as profiles are
+   * assembled.
+   *
+   * @return The profile layout.
+   */
+  jsProfileLayout GetProfileLayout() const;
+
+  /**
+   * @brief Sets the number of `ProfileDispatcher` threads used to invoke the
+   * profile callbacks of the `ScanHead` objects.
+   *
+   * @param num_threads The number of threads to use or `0` to invoke the
+   * callbacks from the receive path.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t SetProfileCallbackThreads(uint32_t num_threads);
+
+  /**
+   * @brief Returns the total number of profiles available to be read across
+   * all of the `ScanHead` objects.
+   *
+   * @return The number of profiles able to be read.
+   */
+  uint32_t AvailableProfiles();
+
+  /**
+   * @brief Blocks until the total number of profiles available across all of
+   * the `ScanHead` objects reaches the number requested, then reports which
+   * have profiles to be read.
+   *
+   * @param count The desired total number of profiles to wait for.
+   * @param timeout_us The max time to wait for in microseconds.
+   * @param ids Array to be filled with the ids of scan heads with profiles.
+   * @param max_ids The maximum number of ids to fill in.
+   * @return The number of ids filled in.
+   */
+  uint32_t WaitUntilAvailableProfiles(uint32_t count, uint32_t timeout_us,
+                                      uint32_t *ids, uint32_t max_ids);
+
+  /**
+   * @brief Wakes up a thread blocked in `WaitUntilAvailableProfiles` if
+   * enough profiles are now available. Called by the `ScanHead` objects after
+   * queueing a profile.
+   */
+  void NotifyProfilesAvailable();
+
+  /**
+   * @brief Sets whether profiles are grouped into frames holding the profiles
+   * of every element of the `PhaseTable` for one scan period.
+   *
+   * @param is_enabled Boolean `true` to assemble frames.
+   * @param timeout_us Time in microseconds to wait for a frame to complete
+   * before it is handed out with elements missing.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t SetFrameAssembly(bool is_enabled, uint32_t timeout_us);
+
+  /**
+   * @brief Returns the number of profiles making up a frame, one for each
+   * scan head, camera and laser element of the `PhaseTable`.
+   *
+   * @return The frame size.
+   */
+  uint32_t GetFrameSize();
+
+  /**
+   * @brief Gets the element of the `PhaseTable` whose profile is held at a
+   * given index of a frame.
+   *
+   * @param index The index into the frame.
+   * @param id Pointer to be updated with the ID of the scan head.
+   * @param camera Pointer to be updated with the camera.
+   * @param laser Pointer to be updated with the laser.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t GetFrameElement(uint32_t index, uint32_t *id, jsCamera *camera,
+                          jsLaser *laser);
+
+  /**
+   * @brief Blocks until a frame is ready to be read.
+   *
+   * @param timeout_us The max time to wait for in microseconds.
+   * @return The number of frames ready on success, negative value mapping to
+   * `jsError` on error.
+   */
+  int32_t WaitUntilFrameAvailable(uint32_t timeout_us);
+
+  /**
+   * @brief Takes the oldest ready frame. The profiles of the frame must be
+   * handed back with `ReleaseFrame` once the caller is done with them.
+   *
+   * @param info Pointer to be updated with information about the frame.
+   * @param profiles Array to be filled with pointers to profile data, with
+   * `nullptr` for elements missing from the frame.
+   * @param max_profiles The length of the `profiles` array.
+   * @return The number of profiles in the frame, `0` if no frame is ready,
+   * or negative value mapping to `jsError` on error.
+   */
+  int32_t GetFrame(jsFrameInfo *info, jsRawProfile **profiles,
+                   uint32_t max_profiles);
+
+  /**
+   * @brief Returns the profiles of a frame obtained with `GetFrame` so that
+   * their storage can be reused for new profile data.
+   *
+   * @param profiles Array of pointers to profile data; `nullptr` is skipped.
+   * @param count The number of profiles in the array.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t ReleaseFrame(jsRawProfile **profiles, uint32_t count);
+
+  /**
+   * @brief Starts recording the data received from every scan head to disk,
+   * replacing any recording already in progress. Only scan heads created
+   * before recording starts are recorded.
+   *
+   * @param path The path of the recording, to which the file index is added.
+   * @param max_file_bytes Size at which a new file is started, or `0` for no
+   * limit.
+   * @param max_file_s Age in seconds at which a new file is started, or `0`
+   * for no limit.
+   * @param is_direct_io Boolean `true` to bypass the page cache where
+   * supported.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t StartRecording(const std::string &path, uint64_t max_file_bytes,
+                         uint32_t max_file_s, bool is_direct_io);
+
+  /**
+   * @brief Stops recording, writing out all data recorded.
+   *
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t StopRecording();
+
+  /**
+   * @brief Gets the statistics of the current or last recording.
+   *
+   * @param stats Pointer to be updated with the statistics.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t GetRecordingStatistics(jsRecordingStatistics *stats);
+
+  /**
+   * @brief Opens a recording to be replayed, making the scan heads recorded
+   * available to be created as though they had been discovered.
+   *
+   * @param path The path of the recording, without file index.
+   * @return The number of scan heads recorded on success, negative value
+   * mapping to `jsError` on error.
+   */
+  int32_t OpenReplay(const std::string &path);
+
+  /**
+   * @brief Replays the recording opened with `OpenReplay` to the scan heads,
+   * in place of scanning. Each scan head is set to the data format and scan
+   * period it was recorded with.
+   *
+   * @param speed Multiple of the recorded rate to replay at, or `0` to replay
+   * as fast as possible.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t StartReplay(double speed);
+
+  /**
+   * @brief Stops replaying a recording. Profiles already received are left
+   * available to read.
+   *
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t StopReplay();
+
+  /**
+   * @brief Gets the statistics of the current or last replay.
+   *
+   * @param stats Pointer to be updated with the statistics.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t GetReplayStatistics(jsReplayStatistics *stats);
+
   /**
    * @brief Gets the measurement units specified for the `ScanManager`.
    *
@@ -195,21 +429,54 @@ class ScanManager {
    * aggressively.
   **/
   static const uint32_t kCameraStartEarlyOffsetNs = 9500;
+  /**
+   * Number of scan heads each reactor thread services when the number of
+   * threads is selected automatically, and the most threads then used.
+   */
+  static const uint32_t kScanHeadsPerReactor = 8;
+  static const uint32_t kMaxDefaultReactors = 2;
 
-  enum SystemState { Disconnected, Connected, Scanning };
+  // `Replaying` counts as scanning, but not as connected
+  enum SystemState { Disconnected, Connected, Scanning, Replaying };
 
   void KeepAliveThread();
+  int32_t StartReactors(std::map<uint32_t, ScanHead *> &scan_heads);
+  void StopReactors();
+  int32_t StartDispatchers(std::map<uint32_t, ScanHead *> &scan_heads);
+  void StopDispatchers();
+  void RecordScanHeads();
 
   std::map<uint32_t, std::shared_ptr<jsDiscovered>> m_serial_to_discovered;
   std::map<uint32_t, ScanHead*> m_serial_to_scan_head;
   std::map<uint32_t, ScanHead*> m_id_to_scan_head;
   std::thread m_keep_alive_thread;
+#ifdef __linux__
+  std::vector<std::unique_ptr<ReceiveReactor>> m_reactors;
+#endif
+  std::vector<std::unique_ptr<ProfileDispatcher>> m_dispatchers;
+  ConsumerWakeup m_profile_wakeup;
+  // kept after recording stops so its statistics can still be read
+  std::unique_ptr<StreamRecorder> m_recorder;
+  std::unique_ptr<StreamReplayer> m_replayer;
+  std::string m_replay_path;
+  // scan heads described by the recording opened for replay, by serial number
+  std::map<uint32_t, RecordedScanHead> m_replay_scan_heads;
+  FrameAssembler m_frames;
+  // guards `m_frames`; never held while waiting on profiles
+  std::mutex m_frame_mutex;
   std::condition_variable m_condition;
   std::mutex m_mutex;
 
   PhaseTable m_phase_table;
   SystemState m_state;
   jsUnits m_units;
+  jsReceiveMode m_receive_mode;
+  uint32_t m_receive_threads;
+  bool m_is_profile_compaction_enabled;
+  jsProfileLayout m_profile_layout;
+  uint32_t m_callback_threads;
+  bool m_is_frame_assembly_enabled;
+  uint32_t m_frame_timeout_us;
 
   static uint32_t m_uid_count;
   uint32_t m_uid;
@@ -223,7 +490,8 @@ inline bool ScanManager::IsConnected() const
 
 inline bool ScanManager::IsScanning() const
 {
-  return m_state == SystemState::Scanning;
+  return (m_state == SystemState::Scanning) ||
+         (m_state == SystemState::Replaying);
 }
 } // namespace joescan
 
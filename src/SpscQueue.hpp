@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_SPSC_QUEUE_H
+#define JOESCAN_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace joescan {
+
+/**
+ * @brief The `SpscQueue` class is a fixed capacity, lock-free ring buffer for
+ * passing small trivially copyable values (typically pointers) from a single
+ * producer thread to a single consumer thread.
+ *
+ * In addition to the usual push / pop operations, the producer can evict the
+ * oldest element of a full queue with `Steal`. Both the consumer and the
+ * producer advance the read position with a compare and swap, so whichever
+ * side wins owns the element and the other side never touches it.
+ */
+template <typename T>
+class SpscQueue {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SpscQueue elements must be trivially copyable");
+
+ public:
+  /**
+   * Initializes a `SpscQueue` object.
+   *
+   * @param capacity The maximum number of elements the queue can hold.
+   */
+  explicit SpscQueue(uint32_t capacity)
+    : m_slots(new std::atomic<T>[capacity]),
+      m_capacity(capacity),
+      m_head(0),
+      m_tail(0)
+  {
+  }
+
+  /**
+   * Reallocates the queue to hold a new number of elements, discarding any
+   * elements it holds. Must not be called while either thread is using the
+   * queue; the queue is left unchanged if allocation fails.
+   *
+   * @param capacity The maximum number of elements the queue can hold.
+   */
+  void Reset(uint32_t capacity)
+  {
+    m_slots.reset(new std::atomic<T>[capacity]);
+    m_capacity = capacity;
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Adds an element to the back of the queue. Producer only.
+   *
+   * @param value The element to add.
+   * @return Boolean `true` on success, `false` if the queue is full.
+   */
+  bool Push(T value)
+  {
+    const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+
+    if (m_capacity <= (tail - head)) {
+      return false;
+    }
+
+    m_slots[tail % m_capacity].store(value, std::memory_order_relaxed);
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  /**
+   * Removes the oldest element of a full queue so that the producer can make
+   * room for a new one. Producer only.
+   *
+   * @param value Pointer to be updated with the evicted element.
+   * @return Boolean `true` if an element was evicted, `false` if the queue
+   * was not full or the consumer freed up space in the meantime.
+   */
+  bool Steal(T *value)
+  {
+    const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    uint64_t head = m_head.load(std::memory_order_acquire);
+
+    if (m_capacity > (tail - head)) {
+      return false;
+    }
+
+    // slot can't change underneath us; only the producer writes to it
+    T v = m_slots[head % m_capacity].load(std::memory_order_relaxed);
+    if (!m_head.compare_exchange_strong(head, head + 1,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+      // consumer read from the queue first, there is space now
+      return false;
+    }
+
+    *value = v;
+    return true;
+  }
+
+  /**
+   * Removes up to `max` elements from the front of the queue. Consumer only.
+   *
+   * @param values Array to be filled with elements removed from the queue.
+   * @param max The maximum number of elements to remove.
+   * @return The number of elements removed.
+   */
+  uint32_t Pop(T *values, uint32_t max)
+  {
+    uint64_t head = m_head.load(std::memory_order_acquire);
+
+    for (;;) {
+      const uint64_t tail = m_tail.load(std::memory_order_acquire);
+      uint64_t n = tail - head;
+      if (n > max) {
+        n = max;
+      }
+
+      if (0 == n) {
+        return 0;
+      }
+
+      for (uint64_t m = 0; m < n; m++) {
+        values[m] = m_slots[(head + m) % m_capacity].load(
+          std::memory_order_relaxed);
+      }
+
+      // on failure the producer stole the oldest element; values read may be
+      // stale, so try again with the updated head
+      if (m_head.compare_exchange_weak(head, head + n,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+        return static_cast<uint32_t>(n);
+      }
+    }
+  }
+
+  /**
+   * Removes a single element from the front of the queue. Consumer only.
+   *
+   * @param value Pointer to be updated with the element removed.
+   * @return Boolean `true` on success, `false` if the queue is empty.
+   */
+  bool Pop(T *value)
+  {
+    return (1 == Pop(value, 1));
+  }
+
+  /**
+   * Gets the number of elements in the queue. Safe to call from any thread,
+   * but the value is only a snapshot.
+   *
+   * @return The number of elements in the queue.
+   */
+  uint32_t Size() const
+  {
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    const uint64_t tail = m_tail.load(std::memory_order_acquire);
+
+    // elements may be popped and pushed between the two reads; clamp
+    const uint64_t n = tail - head;
+    return (n < m_capacity) ? static_cast<uint32_t>(n) : m_capacity;
+  }
+
+  /**
+   * Gets the maximum number of elements the queue can hold.
+   *
+   * @return The queue capacity.
+   */
+  uint32_t Capacity() const
+  {
+    return m_capacity;
+  }
+
+ private:
+  // keep the indexes on separate cache lines to avoid false sharing between
+  // the producer and consumer threads
+  static const uint32_t kCacheLineSize = 64;
+
+  std::unique_ptr<std::atomic<T>[]> m_slots;
+  uint32_t m_capacity;
+  char m_pad0[kCacheLineSize];
+  std::atomic<uint64_t> m_head;
+  char m_pad1[kCacheLineSize];
+  std::atomic<uint64_t> m_tail;
+  char m_pad2[kCacheLineSize];
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_SPSC_QUEUE_H
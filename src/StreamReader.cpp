@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "StreamReader.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+using namespace joescan;
+
+StreamReader::StreamReader(uint32_t capacity)
+  : m_buf(new uint8_t[capacity]),
+    m_capacity(capacity),
+    m_begin(0),
+    m_end(0)
+{
+}
+
+int StreamReader::Read(SOCKET fd)
+{
+  uint32_t len = 0;
+  uint8_t *dst = GetWritePointer(&len);
+
+  if (0 == len) {
+    // buffer is full without holding a complete message; set an error of its
+    // own so callers don't mistake it for a read to retry
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+#ifdef __linux__
+  int r = static_cast<int>(recv(fd, dst, len, 0));
+#else
+  int r = recv(fd, reinterpret_cast<char *>(dst), static_cast<int>(len), 0);
+#endif
+
+  if (0 < r) {
+    Commit(static_cast<uint32_t>(r));
+  }
+
+  return r;
+}
+
+uint8_t *StreamReader::GetWritePointer(uint32_t *len)
+{
+  if (m_begin == m_end) {
+    // everything has been consumed, start over at the beginning
+    m_begin = 0;
+    m_end = 0;
+  } else if (0 != m_begin) {
+    // move the partial message to the front to make room; typically this is
+    // only part of one message so the copy is small
+    uint32_t remaining = m_end - m_begin;
+    memmove(&m_buf[0], &m_buf[m_begin], remaining);
+    m_begin = 0;
+    m_end = remaining;
+  }
+
+  *len = m_capacity - m_end;
+  return &m_buf[m_end];
+}
+
+void StreamReader::Commit(uint32_t len)
+{
+  m_end += len;
+}
+
+bool StreamReader::Next(uint8_t **msg, uint32_t *len)
+{
+  uint32_t available = m_end - m_begin;
+  uint32_t msg_len = 0;
+
+  if (sizeof(uint32_t) > available) {
+    return false;
+  }
+
+  // NOTE: length is sent little-endian as to keep with approach used by
+  // Flatbuffers; copy out since it may not be aligned
+  memcpy(&msg_len, &m_buf[m_begin], sizeof(uint32_t));
+  if ((available - sizeof(uint32_t)) < msg_len) {
+    return false;
+  }
+
+  *msg = &m_buf[m_begin + sizeof(uint32_t)];
+  *len = msg_len;
+  m_begin += sizeof(uint32_t) + msg_len;
+
+  return true;
+}
+
+bool StreamReader::IsEmpty() const
+{
+  return m_begin == m_end;
+}
+
+uint32_t StreamReader::GetBytesNeeded() const
+{
+  uint32_t available = m_end - m_begin;
+  uint32_t msg_len = 0;
+
+  if (sizeof(uint32_t) > available) {
+    return sizeof(uint32_t) - available;
+  }
+
+  memcpy(&msg_len, &m_buf[m_begin], sizeof(uint32_t));
+  if ((available - sizeof(uint32_t)) < msg_len) {
+    return msg_len - (available - sizeof(uint32_t));
+  }
+
+  return 0;
+}
+
+void StreamReader::Reset()
+{
+  m_begin = 0;
+  m_end = 0;
+}
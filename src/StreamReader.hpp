@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_STREAM_READER_H
+#define JOESCAN_STREAM_READER_H
+
+#include <cstdint>
+#include <memory>
+
+#include "NetworkIncludes.hpp"
+
+namespace joescan {
+
+/**
+ * @brief The `StreamReader` class reads length prefixed messages from a TCP
+ * stream. Each message is framed by a little-endian 32-bit length followed by
+ * the message body. Rather than issuing a `recv` call for each length and body,
+ * the reader pulls in as much data as the kernel has available with a single
+ * call and then hands out every complete message in place, without copying.
+ * Bytes belonging to a message split across reads are kept for the next read.
+ */
+class StreamReader {
+ public:
+  static const uint32_t kDefaultCapacity = 256 * 1024;
+
+  /**
+   * Initializes a `StreamReader` object.
+   *
+   * @param capacity The size of the buffer in bytes; limits the largest
+   * message that can be read.
+   */
+  StreamReader(uint32_t capacity = kDefaultCapacity);
+
+  /**
+   * Reads as much data as is available from the socket, up to the free space
+   * in the buffer, using a single `recv` call.
+   *
+   * @param fd The socket to read from.
+   * @return The number of bytes read, `0` if the connection was closed, or
+   * negative value if `recv` failed or a message too large for the buffer was
+   * encountered, in which case `errno` is set to `EMSGSIZE`.
+   */
+  int Read(SOCKET fd);
+
+  /**
+   * Gets the free space at the end of the buffer so data can be added without
+   * using `Read`, such as when data is received by other means. Must be
+   * followed by a call to `Commit`.
+   *
+   * @param len Pointer to be updated with the number of bytes free.
+   * @return Pointer to the free space in the buffer.
+   */
+  uint8_t *GetWritePointer(uint32_t *len);
+
+  /**
+   * Marks bytes written to the pointer returned by `GetWritePointer` as part
+   * of the stream.
+   *
+   * @param len The number of bytes written.
+   */
+  void Commit(uint32_t len);
+
+  /**
+   * Gets the next complete message in the buffer. The returned pointer is
+   * only valid until the next call to `Read` or `GetWritePointer`.
+   *
+   * @param msg Pointer to be updated with the start of the message body.
+   * @param len Pointer to be updated with the length of the message body.
+   * @return Boolean `true` if a message was returned, `false` if no complete
+   * message is available.
+   */
+  bool Next(uint8_t **msg, uint32_t *len);
+
+  /**
+   * Checks if there is any buffered data not yet handed out by `Next`.
+   *
+   * @return Boolean `true` if no data is buffered, `false` otherwise.
+   */
+  bool IsEmpty() const;
+
+  /**
+   * Gets the number of bytes that must be added before more can be learned
+   * about the pending message; either the rest of its length or the rest of
+   * its body. Used to complete a message split across externally received
+   * buffers without copying in more than is needed.
+   *
+   * @return The number of bytes needed, `0` if a complete message is
+   * available.
+   */
+  uint32_t GetBytesNeeded() const;
+
+  /**
+   * Discards all buffered data.
+   */
+  void Reset();
+
+ private:
+  std::unique_ptr<uint8_t[]> m_buf;
+  uint32_t m_capacity;
+  // offset of the first byte not yet handed out by `Next`
+  uint32_t m_begin;
+  // offset one past the last byte read in
+  uint32_t m_end;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_STREAM_READER_H
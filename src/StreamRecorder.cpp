@@ -0,0 +1,511 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "StreamRecorder.hpp"
+
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+RecorderChannel::RecorderChannel(StreamRecorder &recorder,
+                                 uint32_t serial_number)
+  : m_recorder(recorder),
+    m_storage(new uint8_t[uint64_t(StreamRecorder::kChannelBufferSize) *
+                          StreamRecorder::kChannelBuffers]),
+    m_buffers(StreamRecorder::kChannelBuffers),
+    m_full(StreamRecorder::kChannelBuffers),
+    m_free(StreamRecorder::kChannelBuffers),
+    m_current(nullptr),
+    m_serial_number(serial_number)
+{
+  for (uint32_t n = 0; n < StreamRecorder::kChannelBuffers; n++) {
+    Buffer *buffer = &m_buffers[n];
+    buffer->data = &m_storage[uint64_t(n) * StreamRecorder::kChannelBufferSize];
+    buffer->len = 0;
+    buffer->records = 0;
+    buffer->start_ns = 0;
+    m_free.Push(buffer);
+  }
+}
+
+void RecorderChannel::Record(uint64_t host_time_ns, const uint8_t *data,
+                             uint32_t len)
+{
+  const uint32_t size = sizeof(RecordHeader) + len;
+  if (StreamRecorder::kChannelBufferSize < size) {
+    m_recorder.CountDropped(1);
+    return;
+  }
+
+  if ((nullptr != m_current) &&
+      (((StreamRecorder::kChannelBufferSize - m_current->len) < size) ||
+       (StreamRecorder::kMaxBufferAgeNs <
+        (host_time_ns - m_current->start_ns)))) {
+    Submit();
+  }
+
+  if (nullptr == m_current) {
+    if (!m_free.Pop(&m_current)) {
+      // writer has fallen behind; never wait on it
+      m_current = nullptr;
+      m_recorder.m_buffer_full_events.fetch_add(1, std::memory_order_relaxed);
+      m_recorder.CountDropped(1);
+      return;
+    }
+
+    m_current->len = 0;
+    m_current->records = 0;
+    m_current->start_ns = host_time_ns;
+  }
+
+  RecordHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.host_time_ns = host_time_ns;
+  hdr.length = len;
+  hdr.serial_number = m_serial_number;
+  hdr.type = kRecordData;
+
+  uint8_t *dst = &m_current->data[m_current->len];
+  memcpy(dst, &hdr, sizeof(hdr));
+  memcpy(dst + sizeof(hdr), data, len);
+  m_current->len += size;
+  m_current->records++;
+}
+
+void RecorderChannel::Submit()
+{
+  // can't fail, the queue holds every buffer
+  m_full.Push(m_current);
+  m_current = nullptr;
+
+  const uint32_t pending = m_full.Size();
+  uint32_t high_water =
+    m_recorder.m_buffers_high_water.load(std::memory_order_relaxed);
+  while ((pending > high_water) &&
+         !m_recorder.m_buffers_high_water.compare_exchange_weak(
+           high_water, pending, std::memory_order_relaxed)) {
+  }
+
+  m_recorder.NotifyWriter();
+}
+
+StreamRecorder::StreamRecorder()
+  : m_is_stopping(false),
+    m_is_recording(false),
+    m_max_file_bytes(0),
+    m_max_file_ns(0),
+    m_is_direct_io(false),
+    m_file_index(0),
+    m_file_bytes(0),
+    m_file_opened_ns(0),
+    m_is_write_failed(false),
+#ifdef __linux__
+    m_fd(-1),
+#else
+    m_file(nullptr),
+#endif
+    m_out(nullptr),
+    m_out_len(0),
+    m_records_written(0),
+    m_records_dropped(0),
+    m_buffer_full_events(0),
+    m_bytes_written(0),
+    m_files_written(0),
+    m_buffers_high_water(0),
+    m_write_errors(0)
+{
+}
+
+StreamRecorder::~StreamRecorder()
+{
+  Stop();
+}
+
+int32_t StreamRecorder::Start(const std::string &path, uint64_t max_file_bytes,
+                              uint32_t max_file_s, bool is_direct_io,
+                              const std::vector<uint32_t> &serial_numbers)
+{
+  if (m_is_recording) {
+    return JS_ERROR_INTERNAL;
+  }
+
+  m_channels.clear();
+  m_serial_to_channel.clear();
+  m_scan_heads.clear();
+  m_scan_heads_pending.clear();
+  m_path = path;
+  m_max_file_bytes = max_file_bytes;
+  m_max_file_ns = uint64_t(max_file_s) * 1000000000;
+  m_is_direct_io = is_direct_io;
+  m_file_index = 0;
+  m_is_write_failed = false;
+  m_is_stopping = false;
+  m_records_written = 0;
+  m_records_dropped = 0;
+  m_buffer_full_events = 0;
+  m_bytes_written = 0;
+  m_files_written = 0;
+  m_buffers_high_water = 0;
+  m_write_errors = 0;
+
+  if (nullptr == m_out) {
+    // room to align the start and to pad out the last block of a full buffer
+    m_out_storage.reset(new uint8_t[kWriteBufferSize + 3 * kWriteAlignment]);
+    uintptr_t p = reinterpret_cast<uintptr_t>(m_out_storage.get());
+    p = (p + kWriteAlignment - 1) & ~uintptr_t(kWriteAlignment - 1);
+    m_out = reinterpret_cast<uint8_t *>(p);
+  }
+  m_out_len = 0;
+
+  for (auto serial_number : serial_numbers) {
+    m_channels.emplace_back(new RecorderChannel(*this, serial_number));
+    m_serial_to_channel[serial_number] = m_channels.back().get();
+  }
+
+  if (!OpenFile()) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  m_is_recording = true;
+  m_thread = std::thread(&StreamRecorder::WriterMain, this);
+
+  return 0;
+}
+
+void StreamRecorder::Stop()
+{
+  if (!m_is_recording) {
+    return;
+  }
+
+  m_is_stopping = true;
+  NotifyWriter();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+
+  m_is_recording = false;
+}
+
+RecorderChannel *StreamRecorder::GetChannel(uint32_t serial_number)
+{
+  auto iter = m_serial_to_channel.find(serial_number);
+  if (m_serial_to_channel.end() == iter) {
+    return nullptr;
+  }
+
+  return iter->second;
+}
+
+void StreamRecorder::RecordScanHeads(
+  const std::vector<RecordedScanHead> &scan_heads)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto const &scan_head : scan_heads) {
+    m_scan_heads[scan_head.serial_number] = scan_head;
+    m_scan_heads_pending.push_back(scan_head);
+  }
+}
+
+void StreamRecorder::GetStatistics(jsRecordingStatistics *stats) const
+{
+  stats->is_recording = m_is_recording;
+  stats->records_written = m_records_written.load(std::memory_order_relaxed);
+  stats->records_dropped = m_records_dropped.load(std::memory_order_relaxed);
+  stats->buffer_full_events =
+    m_buffer_full_events.load(std::memory_order_relaxed);
+  stats->bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+  stats->files_written = m_files_written.load(std::memory_order_relaxed);
+  stats->buffers_per_scan_head = kChannelBuffers;
+  stats->buffers_pending_high_water =
+    m_buffers_high_water.load(std::memory_order_relaxed);
+  stats->write_errors = m_write_errors.load(std::memory_order_relaxed);
+}
+
+bool StreamRecorder::IsRecording() const
+{
+  return m_is_recording;
+}
+
+void StreamRecorder::WriterMain()
+{
+  while (!m_is_stopping) {
+    m_wakeup.WaitFor(1, [this] {
+      return m_is_stopping ? 1 : PendingBuffers();
+    }, kWriterPollUs);
+
+    WriteScanHeads(false);
+    const bool is_idle = (0 == PendingBuffers());
+    DrainChannels(false);
+
+    if ((0 != m_max_file_ns) &&
+        (m_max_file_ns <= (RecordingTimeNs() - m_file_opened_ns))) {
+      Rotate();
+    } else if (is_idle && (0 != m_out_len)) {
+      // get data to disk while there is time, rather than letting it sit
+      Flush(true);
+    }
+  }
+
+  // receive path no longer uses the channels, partly filled buffers can be
+  // taken from underneath it
+  WriteScanHeads(false);
+  DrainChannels(true);
+  Flush(true);
+  CloseFile();
+}
+
+uint32_t StreamRecorder::PendingBuffers() const
+{
+  uint32_t n = 0;
+  for (auto const &channel : m_channels) {
+    n += channel->m_full.Size();
+  }
+
+  return n;
+}
+
+void StreamRecorder::DrainChannels(bool is_final)
+{
+  for (auto &channel : m_channels) {
+    RecorderChannel::Buffer *buffer = nullptr;
+
+    for (;;) {
+      if (!channel->m_full.Pop(&buffer)) {
+        if (!is_final || (nullptr == channel->m_current)) {
+          break;
+        }
+
+        buffer = channel->m_current;
+        channel->m_current = nullptr;
+      }
+
+      if ((0 != m_max_file_bytes) &&
+          (m_max_file_bytes <= (m_file_bytes + m_out_len))) {
+        Rotate();
+      }
+
+      if (m_is_write_failed) {
+        CountDropped(buffer->records);
+      } else {
+        Append(buffer->data, buffer->len);
+        m_records_written.fetch_add(buffer->records,
+                                    std::memory_order_relaxed);
+      }
+
+      channel->m_free.Push(buffer);
+    }
+  }
+}
+
+void StreamRecorder::WriteScanHeads(bool is_all)
+{
+  std::vector<RecordedScanHead> scan_heads;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (is_all) {
+      for (auto const &pair : m_scan_heads) {
+        scan_heads.push_back(pair.second);
+      }
+    } else {
+      scan_heads.swap(m_scan_heads_pending);
+    }
+  }
+
+  for (auto const &scan_head : scan_heads) {
+    AppendRecord(kRecordScanHead, scan_head.serial_number,
+                 reinterpret_cast<const uint8_t *>(&scan_head),
+                 sizeof(scan_head));
+  }
+}
+
+void StreamRecorder::Append(const uint8_t *data, uint32_t len)
+{
+  while (0 != len) {
+    uint32_t n = kWriteBufferSize - m_out_len;
+    n = (len < n) ? len : n;
+
+    memcpy(&m_out[m_out_len], data, n);
+    m_out_len += n;
+    data += n;
+    len -= n;
+
+    if (kWriteBufferSize == m_out_len) {
+      Flush(false);
+    }
+  }
+}
+
+void StreamRecorder::AppendRecord(uint16_t type, uint32_t serial_number,
+                                  const uint8_t *data, uint32_t len)
+{
+  RecordHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.host_time_ns = RecordingTimeNs();
+  hdr.length = len;
+  hdr.serial_number = serial_number;
+  hdr.type = type;
+
+  Append(reinterpret_cast<const uint8_t *>(&hdr), sizeof(hdr));
+  Append(data, len);
+}
+
+void StreamRecorder::Flush(bool is_padded)
+{
+  if (0 == m_out_len) {
+    return;
+  }
+
+  uint32_t rem = m_out_len % kWriteAlignment;
+  if (is_padded && m_is_direct_io && (0 != rem)) {
+    // direct I/O can only write whole blocks; fill out the last one with a
+    // record to be skipped, spilling into another block if the header
+    // doesn't fit
+    uint32_t pad = kWriteAlignment - rem;
+    if (sizeof(RecordHeader) > pad) {
+      pad += kWriteAlignment;
+    }
+
+    RecordHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.length = pad - sizeof(RecordHeader);
+    hdr.type = kRecordPad;
+    memcpy(&m_out[m_out_len], &hdr, sizeof(hdr));
+    memset(&m_out[m_out_len + sizeof(hdr)], 0, hdr.length);
+    m_out_len += pad;
+  }
+
+  if (!m_is_write_failed && !WriteFile(m_out, m_out_len)) {
+    m_is_write_failed = true;
+    m_write_errors.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  m_file_bytes += m_out_len;
+  m_out_len = 0;
+}
+
+bool StreamRecorder::OpenFile()
+{
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".%06u", m_file_index);
+  const std::string path = m_path + suffix;
+
+#ifdef __linux__
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  m_fd = -1;
+  if (m_is_direct_io) {
+    m_fd = open(path.c_str(), flags | O_DIRECT, 0644);
+    if (0 > m_fd) {
+      // not every file system supports it; write through the page cache
+      m_is_direct_io = false;
+    }
+  }
+  if (0 > m_fd) {
+    m_fd = open(path.c_str(), flags, 0644);
+  }
+  if (0 > m_fd) {
+    return false;
+  }
+#else
+  // direct I/O is only supported on Linux
+  m_is_direct_io = false;
+  m_file = std::fopen(path.c_str(), "wb");
+  if (nullptr == m_file) {
+    return false;
+  }
+#endif
+
+  m_file_index++;
+  m_file_bytes = 0;
+  m_file_opened_ns = RecordingTimeNs();
+  m_files_written.fetch_add(1, std::memory_order_relaxed);
+
+  auto wall = std::chrono::system_clock::now().time_since_epoch();
+  RecordingFileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = kRecordingMagic;
+  hdr.version = kRecordingVersion;
+  hdr.file_index = m_file_index - 1;
+  hdr.host_time_ns = m_file_opened_ns;
+  hdr.wall_time_ns = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count());
+  Append(reinterpret_cast<const uint8_t *>(&hdr), sizeof(hdr));
+
+  // every file describes the scan heads, so it can be replayed on its own
+  WriteScanHeads(true);
+
+  return true;
+}
+
+void StreamRecorder::CloseFile()
+{
+#ifdef __linux__
+  if (0 <= m_fd) {
+    close(m_fd);
+    m_fd = -1;
+  }
+#else
+  if (nullptr != m_file) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+#endif
+}
+
+void StreamRecorder::Rotate()
+{
+  Flush(true);
+  CloseFile();
+
+  if (!m_is_write_failed && !OpenFile()) {
+    m_is_write_failed = true;
+    m_write_errors.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool StreamRecorder::WriteFile(const uint8_t *data, uint32_t len)
+{
+#ifdef __linux__
+  while (0 != len) {
+    ssize_t n = write(m_fd, data, len);
+    if (0 > n) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return false;
+    }
+
+    data += n;
+    len -= static_cast<uint32_t>(n);
+    m_bytes_written.fetch_add(n, std::memory_order_relaxed);
+  }
+#else
+  if (len != std::fwrite(data, 1, len, m_file)) {
+    return false;
+  }
+  m_bytes_written.fetch_add(len, std::memory_order_relaxed);
+#endif
+
+  return true;
+}
+
+void StreamRecorder::NotifyWriter()
+{
+  m_wakeup.Notify([this] { return m_is_stopping ? 1 : PendingBuffers(); });
+}
+
+void StreamRecorder::CountDropped(uint64_t records)
+{
+  m_records_dropped.fetch_add(records, std::memory_order_relaxed);
+}
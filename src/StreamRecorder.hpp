@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_STREAM_RECORDER_H
+#define JOESCAN_STREAM_RECORDER_H
+
+#include "ConsumerWakeup.hpp"
+#include "RecordingFormat.hpp"
+#include "SpscQueue.hpp"
+#include "joescan_pinchot.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+class StreamRecorder;
+
+/**
+ * @brief The `RecorderChannel` class takes the data messages received from a
+ * single scan head and hands them to the `StreamRecorder` writer thread in
+ * large buffers through lock-free queues. If the writer falls behind and no
+ * buffer is free, messages are dropped rather than waiting on the disk.
+ */
+class RecorderChannel {
+ public:
+  RecorderChannel(StreamRecorder &recorder, uint32_t serial_number);
+
+  /**
+   * Copies a message into the recording. Only called from the receive path
+   * of the scan head.
+   *
+   * @param host_time_ns The time the message was received.
+   * @param data Pointer to the message, without its length prefix.
+   * @param len The length of the message.
+   */
+  void Record(uint64_t host_time_ns, const uint8_t *data, uint32_t len);
+
+ private:
+  struct Buffer {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t records;
+    uint64_t start_ns;
+  };
+
+  void Submit();
+
+  StreamRecorder &m_recorder;
+  std::unique_ptr<uint8_t[]> m_storage;
+  std::vector<Buffer> m_buffers;
+  // buffers waiting to be written, filled by the receive path
+  SpscQueue<Buffer *> m_full;
+  // buffers handed back by the writer thread
+  SpscQueue<Buffer *> m_free;
+  Buffer *m_current;
+  uint32_t m_serial_number;
+
+  friend class StreamRecorder;
+};
+
+/**
+ * @brief The `StreamRecorder` class writes the data messages received from
+ * the scan heads of a scan system to disk, as described in
+ * `RecordingFormat.hpp`. A dedicated writer thread gathers the buffers of
+ * every `RecorderChannel` into a large aligned write buffer and writes it out,
+ * optionally bypassing the page cache, starting a new file once the current
+ * one reaches a size or age limit.
+ */
+class StreamRecorder {
+ public:
+  // size of each buffer a channel fills, must hold the largest message
+  static const uint32_t kChannelBufferSize = 256 * 1024;
+  // buffers per channel; allows a scan head to get this far ahead of the disk
+  static const uint32_t kChannelBuffers = 32;
+  // buffers partly filled for longer than this are handed to the writer
+  static const uint64_t kMaxBufferAgeNs = 500000000;
+
+  StreamRecorder();
+  ~StreamRecorder();
+
+  /**
+   * Opens the first file of a recording and starts the writer thread.
+   *
+   * @param path The path of the recording, to which the file index is added.
+   * @param max_file_bytes Size at which a new file is started, or `0` for no
+   * limit.
+   * @param max_file_s Age in seconds at which a new file is started, or `0`
+   * for no limit.
+   * @param is_direct_io Boolean `true` to bypass the page cache where
+   * supported.
+   * @param serial_numbers The serial numbers of the scan heads recorded.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t Start(const std::string &path, uint64_t max_file_bytes,
+                uint32_t max_file_s, bool is_direct_io,
+                const std::vector<uint32_t> &serial_numbers);
+
+  /**
+   * Writes out all data recorded and closes the recording. The channels must
+   * no longer be in use by the receive path.
+   */
+  void Stop();
+
+  /**
+   * Gets the channel taking the data of a scan head.
+   *
+   * @param serial_number The serial number of the scan head.
+   * @return Pointer to the channel, `nullptr` if the scan head is not
+   * recorded.
+   */
+  RecorderChannel *GetChannel(uint32_t serial_number);
+
+  /**
+   * Adds a description of each scan head to the recording, as scanning is
+   * started.
+   *
+   * @param scan_heads The scan heads of the scan system.
+   */
+  void RecordScanHeads(const std::vector<RecordedScanHead> &scan_heads);
+
+  /**
+   * Gets the statistics of the current or last recording.
+   *
+   * @param stats Pointer to be updated with the statistics.
+   */
+  void GetStatistics(jsRecordingStatistics *stats) const;
+
+  bool IsRecording() const;
+
+ private:
+  // data is written to disk in multiples of this; suits direct I/O
+  static const uint32_t kWriteAlignment = 4096;
+  static const uint32_t kWriteBufferSize = 4 * 1024 * 1024;
+  // how often the writer thread checks for rotation and idle data
+  static const uint32_t kWriterPollUs = 100000;
+
+  void WriterMain();
+  uint32_t PendingBuffers() const;
+  void DrainChannels(bool is_final);
+  void WriteScanHeads(bool is_all);
+  void Append(const uint8_t *data, uint32_t len);
+  void AppendRecord(uint16_t type, uint32_t serial_number,
+                    const uint8_t *data, uint32_t len);
+  void Flush(bool is_padded);
+  bool OpenFile();
+  void CloseFile();
+  void Rotate();
+  bool WriteFile(const uint8_t *data, uint32_t len);
+  void NotifyWriter();
+  void CountDropped(uint64_t records);
+
+  std::vector<std::unique_ptr<RecorderChannel>> m_channels;
+  std::map<uint32_t, RecorderChannel *> m_serial_to_channel;
+  std::thread m_thread;
+  ConsumerWakeup m_wakeup;
+  std::atomic<bool> m_is_stopping;
+  bool m_is_recording;
+
+  // guards `m_scan_heads` and `m_scan_heads_pending`
+  std::mutex m_mutex;
+  std::map<uint32_t, RecordedScanHead> m_scan_heads;
+  std::vector<RecordedScanHead> m_scan_heads_pending;
+
+  std::string m_path;
+  uint64_t m_max_file_bytes;
+  uint64_t m_max_file_ns;
+  bool m_is_direct_io;
+  uint32_t m_file_index;
+  uint64_t m_file_bytes;
+  uint64_t m_file_opened_ns;
+  bool m_is_write_failed;
+#ifdef __linux__
+  int m_fd;
+#else
+  std::FILE *m_file;
+#endif
+  std::unique_ptr<uint8_t[]> m_out_storage;
+  uint8_t *m_out;
+  uint32_t m_out_len;
+
+  std::atomic<uint64_t> m_records_written;
+  std::atomic<uint64_t> m_records_dropped;
+  std::atomic<uint64_t> m_buffer_full_events;
+  std::atomic<uint64_t> m_bytes_written;
+  std::atomic<uint32_t> m_files_written;
+  std::atomic<uint32_t> m_buffers_high_water;
+  std::atomic<uint32_t> m_write_errors;
+
+  friend class RecorderChannel;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_STREAM_RECORDER_H
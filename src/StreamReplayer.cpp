@@ -0,0 +1,323 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "StreamReplayer.hpp"
+#include "ScanHead.hpp"
+
+#include <cstring>
+
+using namespace joescan;
+
+RecordingReader::RecordingReader(const std::string &path)
+  : m_path(path),
+    m_file(nullptr),
+    m_buf(new uint8_t[kReadBufferSize]),
+    m_len(0),
+    m_pos(0)
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+  Close();
+}
+
+int RecordingReader::Open(uint32_t index, RecordingFileHeader *hdr)
+{
+  Close();
+
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".%06u", index);
+  const std::string path = m_path + suffix;
+
+  m_file = std::fopen(path.c_str(), "rb");
+  if (nullptr == m_file) {
+    return 0;
+  }
+
+  if (!Fill(sizeof(RecordingFileHeader))) {
+    return -1;
+  }
+
+  memcpy(hdr, &m_buf[m_pos], sizeof(RecordingFileHeader));
+  if ((kRecordingMagic != hdr->magic) ||
+      (kRecordingVersion != hdr->version)) {
+    return -1;
+  }
+  m_pos += sizeof(RecordingFileHeader);
+
+  return 1;
+}
+
+int RecordingReader::Next(RecordHeader *hdr, uint8_t **record)
+{
+  if (!Fill(sizeof(RecordHeader))) {
+    // ending on a record boundary is the normal end of the file
+    return (m_pos == m_len) ? 0 : -1;
+  }
+
+  memcpy(hdr, &m_buf[m_pos], sizeof(RecordHeader));
+  const uint64_t size = uint64_t(sizeof(RecordHeader)) + hdr->length;
+  if ((kReadBufferSize < size) ||
+      !Fill(static_cast<uint32_t>(size))) {
+    return -1;
+  }
+
+  *record = &m_buf[m_pos];
+  m_pos += static_cast<uint32_t>(size);
+
+  return 1;
+}
+
+bool RecordingReader::Fill(uint32_t len)
+{
+  if (len <= (m_len - m_pos)) {
+    return true;
+  }
+
+  // carry over what is left of the buffer and read in more behind it
+  memmove(&m_buf[0], &m_buf[m_pos], m_len - m_pos);
+  m_len -= m_pos;
+  m_pos = 0;
+
+  while ((nullptr != m_file) && (m_len < len)) {
+    size_t n = std::fread(&m_buf[m_len], 1, kReadBufferSize - m_len, m_file);
+    if (0 == n) {
+      break;
+    }
+    m_len += static_cast<uint32_t>(n);
+  }
+
+  return len <= m_len;
+}
+
+void RecordingReader::Close()
+{
+  if (nullptr != m_file) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+  m_len = 0;
+  m_pos = 0;
+}
+
+StreamReplayer::StreamReplayer()
+  : m_speed(0.0),
+    m_recorded_start_ns(0),
+    m_is_stopping(false),
+    m_threads_finished(0),
+    m_is_truncated(false),
+    m_records_replayed(0),
+    m_bytes_replayed(0),
+    m_max_lag_us(0),
+    m_files_read(0)
+{
+}
+
+StreamReplayer::~StreamReplayer()
+{
+  Stop();
+}
+
+int32_t StreamReplayer::ReadScanHeads(const std::string &path,
+                                      std::vector<RecordedScanHead> *scan_heads)
+{
+  RecordingReader reader(path);
+  RecordingFileHeader file_hdr;
+
+  if (0 >= reader.Open(0, &file_hdr)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  // the scan heads are described again as scanning starts, just ahead of the
+  // data; the last description before any data is the one that applies
+  std::map<uint32_t, RecordedScanHead> found;
+  RecordHeader hdr;
+  uint8_t *record = nullptr;
+  while (0 < reader.Next(&hdr, &record)) {
+    if (kRecordData == hdr.type) {
+      break;
+    }
+
+    if ((kRecordScanHead == hdr.type) &&
+        (sizeof(RecordedScanHead) <= hdr.length)) {
+      RecordedScanHead scan_head;
+      memcpy(&scan_head, &record[sizeof(RecordHeader)], sizeof(scan_head));
+      found[scan_head.serial_number] = scan_head;
+    }
+  }
+
+  scan_heads->clear();
+  for (auto const &pair : found) {
+    scan_heads->push_back(pair.second);
+  }
+
+  return 0;
+}
+
+int32_t StreamReplayer::Start(const std::string &path, double speed,
+                              const std::map<uint32_t, ScanHead *> &scan_heads)
+{
+  Stop();
+
+  RecordingReader reader(path);
+  RecordingFileHeader file_hdr;
+  if (0 >= reader.Open(0, &file_hdr)) {
+    return JS_ERROR_INVALID_ARGUMENT;
+  }
+
+  // time from when the first of the scan heads started sending data, rather
+  // than when recording started; the data of each scan head is in order but
+  // one may come after another's later data
+  std::map<uint32_t, bool> is_seen;
+  for (auto const &pair : scan_heads) {
+    is_seen[pair.first] = false;
+  }
+  uint64_t start_ns = UINT64_MAX;
+  uint32_t num_seen = 0;
+  RecordHeader hdr;
+  uint8_t *record = nullptr;
+  while ((num_seen < is_seen.size()) && (0 < reader.Next(&hdr, &record))) {
+    auto iter = is_seen.find(hdr.serial_number);
+    if ((kRecordData != hdr.type) || (is_seen.end() == iter) ||
+        (iter->second)) {
+      continue;
+    }
+
+    iter->second = true;
+    num_seen++;
+    start_ns = (hdr.host_time_ns < start_ns) ? hdr.host_time_ns : start_ns;
+  }
+
+  m_path = path;
+  m_speed = speed;
+  m_recorded_start_ns =
+    (UINT64_MAX == start_ns) ? file_hdr.host_time_ns : start_ns;
+  m_start = std::chrono::steady_clock::now();
+  m_is_stopping = false;
+  m_threads_finished = 0;
+  m_is_truncated = false;
+  m_records_replayed = 0;
+  m_bytes_replayed = 0;
+  m_max_lag_us = 0;
+  m_files_read = 0;
+
+  for (auto const &pair : scan_heads) {
+    m_threads.emplace_back(&StreamReplayer::ReplayMain, this, pair.second,
+                           pair.first);
+  }
+
+  return 0;
+}
+
+void StreamReplayer::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_is_stopping = true;
+  }
+  m_condition.notify_all();
+
+  for (auto &thread : m_threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  m_threads.clear();
+}
+
+void StreamReplayer::GetStatistics(jsReplayStatistics *stats) const
+{
+  stats->is_finished = (!m_threads.empty()) &&
+    (m_threads.size() == m_threads_finished.load(std::memory_order_acquire));
+  stats->is_truncated = m_is_truncated.load(std::memory_order_relaxed);
+  stats->records_replayed = m_records_replayed.load(std::memory_order_relaxed);
+  stats->bytes_replayed = m_bytes_replayed.load(std::memory_order_relaxed);
+  stats->max_lag_us = m_max_lag_us.load(std::memory_order_relaxed);
+  stats->files_read =
+    static_cast<uint32_t>(m_files_read.load(std::memory_order_relaxed));
+}
+
+void StreamReplayer::ReplayMain(ScanHead *scan_head, uint32_t serial_number)
+{
+  RecordingReader reader(m_path);
+  RecordingFileHeader file_hdr;
+  RecordHeader hdr;
+  uint8_t *record = nullptr;
+  bool is_done = false;
+
+  for (uint32_t index = 0; !is_done && !m_is_stopping; index++) {
+    int r = reader.Open(index, &file_hdr);
+    if (0 == r) {
+      break;
+    } else if (0 > r) {
+      m_is_truncated = true;
+      break;
+    }
+    UpdateMax(m_files_read, index + 1);
+
+    while (!m_is_stopping) {
+      r = reader.Next(&hdr, &record);
+      if (0 == r) {
+        break;
+      } else if (0 > r) {
+        m_is_truncated = true;
+        is_done = true;
+        break;
+      }
+
+      if ((kRecordData != hdr.type) || (serial_number != hdr.serial_number)) {
+        continue;
+      }
+
+      if (0.0 < m_speed) {
+        const double offset_ns =
+          double(int64_t(hdr.host_time_ns - m_recorded_start_ns)) / m_speed;
+        auto t = m_start + std::chrono::nanoseconds(int64_t(offset_ns));
+        auto now = std::chrono::steady_clock::now();
+        if (now < t) {
+          if (!WaitUntil(t)) {
+            break;
+          }
+        } else {
+          auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - t);
+          UpdateMax(m_max_lag_us, static_cast<uint64_t>(lag.count()));
+        }
+      }
+
+      // the receive path takes messages with their length prefix, as read
+      // from the data socket; it fits in the tail of the record header
+      uint8_t *msg = &record[sizeof(RecordHeader) - sizeof(uint32_t)];
+      memcpy(msg, &hdr.length, sizeof(uint32_t));
+      scan_head->ReceiveData(msg, sizeof(uint32_t) + hdr.length);
+
+      m_records_replayed.fetch_add(1, std::memory_order_relaxed);
+      m_bytes_replayed.fetch_add(hdr.length, std::memory_order_relaxed);
+    }
+  }
+
+  if (!m_is_stopping) {
+    m_threads_finished.fetch_add(1, std::memory_order_release);
+  }
+}
+
+bool StreamReplayer::WaitUntil(std::chrono::steady_clock::time_point t)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_condition.wait_until(lock, t, [this] { return m_is_stopping.load(); });
+
+  return !m_is_stopping;
+}
+
+void StreamReplayer::UpdateMax(std::atomic<uint64_t> &value, uint64_t n)
+{
+  uint64_t current = value.load(std::memory_order_relaxed);
+  while ((n > current) &&
+         !value.compare_exchange_weak(current, n, std::memory_order_relaxed)) {
+  }
+}
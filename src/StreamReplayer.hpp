@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_STREAM_REPLAYER_H
+#define JOESCAN_STREAM_REPLAYER_H
+
+#include "RecordingFormat.hpp"
+#include "joescan_pinchot.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+class ScanHead;
+
+/**
+ * @brief The `RecordingReader` class reads the records of a recording made by
+ * `StreamRecorder`, one file at a time.
+ */
+class RecordingReader {
+ public:
+  // must hold the largest record, plus room to carry over a partial one
+  static const uint32_t kReadBufferSize = 1024 * 1024;
+
+  RecordingReader(const std::string &path);
+  ~RecordingReader();
+
+  /**
+   * Opens a file of the recording and reads its header.
+   *
+   * @param index The index of the file within the recording.
+   * @param hdr Pointer to be updated with the file header.
+   * @return `1` if opened, `0` if there is no such file, or negative value
+   * if the file is not a recording.
+   */
+  int Open(uint32_t index, RecordingFileHeader *hdr);
+
+  /**
+   * Reads the next record of the open file. The record stays valid until the
+   * next call, and may be modified in place.
+   *
+   * @param hdr Pointer to be updated with the record header.
+   * @param record Pointer to be updated with the start of the record, its
+   * payload following the header.
+   * @return `1` if a record was read, `0` at the end of the file, or negative
+   * value if the file is truncated or corrupt.
+   */
+  int Next(RecordHeader *hdr, uint8_t **record);
+
+ private:
+  bool Fill(uint32_t len);
+  void Close();
+
+  std::string m_path;
+  std::FILE *m_file;
+  std::unique_ptr<uint8_t[]> m_buf;
+  uint32_t m_len;
+  uint32_t m_pos;
+};
+
+/**
+ * @brief The `StreamReplayer` class feeds a recording made by `StreamRecorder`
+ * to the receive path of the scan heads of a scan system, as though it was
+ * being received from them. Each scan head is fed by its own thread, as
+ * their data are interleaved in the recording in large blocks rather than in
+ * the order received.
+ */
+class StreamReplayer {
+ public:
+  StreamReplayer();
+  ~StreamReplayer();
+
+  /**
+   * Reads the description of the scan heads from the start of a recording,
+   * as they were when data was first recorded.
+   *
+   * @param path The path of the recording, without file index.
+   * @param scan_heads Pointer to be filled with the scan heads.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  static int32_t ReadScanHeads(const std::string &path,
+                               std::vector<RecordedScanHead> *scan_heads);
+
+  /**
+   * Starts replaying a recording. The receive path of each scan head must
+   * already be started with `ScanHead::StartScanningOffline`.
+   *
+   * @param path The path of the recording, without file index.
+   * @param speed Multiple of the recorded rate to replay at, or `0` to replay
+   * as fast as the scan heads can take the data.
+   * @param scan_heads The scan heads to replay data to, by serial number.
+   * @return `0` on success, negative value mapping to `jsError` on error.
+   */
+  int32_t Start(const std::string &path, double speed,
+                const std::map<uint32_t, ScanHead *> &scan_heads);
+
+  /**
+   * Stops replaying, waiting for all threads to finish.
+   */
+  void Stop();
+
+  /**
+   * Gets the statistics of the current or last replay.
+   *
+   * @param stats Pointer to be updated with the statistics.
+   */
+  void GetStatistics(jsReplayStatistics *stats) const;
+
+ private:
+  void ReplayMain(ScanHead *scan_head, uint32_t serial_number);
+  bool WaitUntil(std::chrono::steady_clock::time_point t);
+  static void UpdateMax(std::atomic<uint64_t> &value, uint64_t n);
+
+  std::string m_path;
+  double m_speed;
+  // recorded time and host time replay started at, shared by all threads so
+  // that the scan heads stay in step with each other
+  uint64_t m_recorded_start_ns;
+  std::chrono::steady_clock::time_point m_start;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::atomic<bool> m_is_stopping;
+
+  std::atomic<uint32_t> m_threads_finished;
+  std::atomic<bool> m_is_truncated;
+  std::atomic<uint64_t> m_records_replayed;
+  std::atomic<uint64_t> m_bytes_replayed;
+  std::atomic<uint64_t> m_max_lag_us;
+  std::atomic<uint64_t> m_files_read;
+};
+
+} // namespace joescan
+
+#endif // JOESCAN_STREAM_REPLAYER_H
@@ -7,6 +7,7 @@
 
 #include "joescan_pinchot.h"
 #include "NetworkInterface.hpp"
+#include "ProfileKernels.hpp"
 #include "ScanHead.hpp"
 #include "ScanManager.hpp"
 #include "Version.hpp"
@@ -15,6 +16,7 @@
 #include <chrono>
 #include <string>
 #include <cassert>
+#include <cstddef>
 #include <cstring>
 #include <cmath>
 
@@ -25,31 +27,6 @@ using namespace joescan;
 static std::map<uint32_t, ScanManager*> _uid_to_scan_manager;
 static int _network_init_count = 0;
 
-static unsigned int _data_format_to_stride(jsDataFormat fmt)
-{
-  unsigned int stride = 0;
-
-  switch (fmt) {
-    case JS_DATA_FORMAT_INVALID:
-      stride = 0;
-      break;
-    case JS_DATA_FORMAT_XY_BRIGHTNESS_FULL:
-    case JS_DATA_FORMAT_XY_FULL:
-      stride = 1;
-      break;
-    case JS_DATA_FORMAT_XY_BRIGHTNESS_HALF:
-    case JS_DATA_FORMAT_XY_HALF:
-      stride = 2;
-      break;
-    case JS_DATA_FORMAT_XY_BRIGHTNESS_QUARTER:
-    case JS_DATA_FORMAT_XY_QUARTER:
-      stride = 4;
-      break;
-  }
-
-  return stride;
-}
-
 static ScanManager *_get_scan_manager_object(jsScanSystem scan_system)
 {
   uint32_t uid = scan_system & 0xFFFFFFFF;
@@ -101,6 +78,35 @@ static jsScanHead _get_jsScanHead(ScanHead *scan_head)
   return sh;
 }
 
+/**
+ * Copies profiles out of a scan head in small batches so that the storage
+ * backing each profile is handed back to the scan head as soon as possible.
+ * The `copy` function is called with the destination index and profile.
+ */
+template <typename T, typename Fn>
+static uint32_t _copy_profiles(ScanHead *sh, uint32_t max_profiles, Fn copy)
+{
+  const uint32_t batch_len = 32;
+  T *batch[batch_len];
+  uint32_t total = 0;
+
+  while (total < max_profiles) {
+    uint32_t len = std::min(batch_len, max_profiles - total);
+    uint32_t n = sh->GetProfiles(batch, len);
+    for (uint32_t m = 0; m < n; m++) {
+      copy(total + m, batch[m]);
+    }
+    sh->ReleaseProfiles(batch, n);
+    total += n;
+
+    if (n < len) {
+      break;
+    }
+  }
+
+  return total;
+}
+
 EXPORTED
 void jsGetAPIVersion(const char **version_str)
 {
@@ -727,9 +733,10 @@ int32_t jsScanSystemPhaseInsertLaserConfiguration(jsScanSystem scan_system,
 }
 
 EXPORTED
-int32_t jsScanSystemGetMinScanPeriod(jsScanSystem scan_system)
+int32_t jsScanSystemSetReceiveMode(jsScanSystem scan_system,
+                                   jsReceiveMode mode, uint32_t num_threads)
 {
-  uint32_t period_us = 0;
+  int32_t r = 0;
 
   try {
     ScanManager *manager = _get_scan_manager_object(scan_system);
@@ -737,18 +744,17 @@ int32_t jsScanSystemGetMinScanPeriod(jsScanSystem scan_system)
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    period_us = manager->GetMinScanPeriod();
+    r = manager->SetReceiveMode(mode, num_threads);
   } catch (std::exception &e) {
     (void)e;
-    return JS_ERROR_INTERNAL;
+    r = JS_ERROR_INTERNAL;
   }
 
-  return (int32_t)period_us;
+  return r;
 }
 
 EXPORTED
-int32_t jsScanSystemStartScanning(jsScanSystem scan_system, uint32_t period_us,
-                                  jsDataFormat fmt)
+int32_t jsScanSystemGetReceiveMode(jsScanSystem scan_system)
 {
   int32_t r = 0;
 
@@ -758,7 +764,7 @@ int32_t jsScanSystemStartScanning(jsScanSystem scan_system, uint32_t period_us,
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = manager->StartScanning(period_us, fmt);
+    r = static_cast<int32_t>(manager->GetReceiveMode());
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -768,7 +774,8 @@ int32_t jsScanSystemStartScanning(jsScanSystem scan_system, uint32_t period_us,
 }
 
 EXPORTED
-int32_t jsScanSystemStopScanning(jsScanSystem scan_system)
+int32_t jsScanSystemSetProfileCompaction(jsScanSystem scan_system,
+                                         bool is_enabled)
 {
   int32_t r = 0;
 
@@ -778,7 +785,7 @@ int32_t jsScanSystemStopScanning(jsScanSystem scan_system)
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = manager->StopScanning();
+    r = manager->SetProfileCompaction(is_enabled);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -788,104 +795,100 @@ int32_t jsScanSystemStopScanning(jsScanSystem scan_system)
 }
 
 EXPORTED
-bool jsScanSystemIsScanning(jsScanSystem scan_system)
+int32_t jsScanSystemSetProfileLayout(jsScanSystem scan_system,
+                                     jsProfileLayout layout)
 {
-  bool is_scanning = false;
+  int32_t r = 0;
 
   try {
     ScanManager *manager = _get_scan_manager_object(scan_system);
     if (nullptr == manager) {
-      return false;
+      return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    is_scanning = manager->IsScanning();
+    r = manager->SetProfileLayout(layout);
   } catch (std::exception &e) {
     (void)e;
-    is_scanning = false;
+    r = JS_ERROR_INTERNAL;
   }
 
-  return is_scanning;
+  return r;
 }
 
 EXPORTED
-jsScanHeadType jsScanHeadGetType(jsScanHead scan_head)
+int32_t jsScanSystemSetProfileCallbackThreads(jsScanSystem scan_system,
+                                              uint32_t num_threads)
 {
-  jsScanHeadType type = JS_SCAN_HEAD_INVALID_TYPE;
+  int32_t r = 0;
 
   try {
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
-      return JS_SCAN_HEAD_INVALID_TYPE;
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    type = sh->GetType();
+    r = manager->SetProfileCallbackThreads(num_threads);
   } catch (std::exception &e) {
     (void)e;
-    type = JS_SCAN_HEAD_INVALID_TYPE;
+    r = JS_ERROR_INTERNAL;
   }
 
-  return type;
+  return r;
 }
 
 EXPORTED
-uint32_t jsScanHeadGetId(jsScanHead scan_head)
+int32_t jsScanSystemGetMinScanPeriod(jsScanSystem scan_system)
 {
-  uint32_t id = 0;
+  uint32_t period_us = 0;
 
   try {
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
-      // make it super obvious that the ID is invalid
-      return UINT_MAX;
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    id = sh->GetId();
+    period_us = manager->GetMinScanPeriod();
   } catch (std::exception &e) {
     (void)e;
-    id = UINT_MAX;
+    return JS_ERROR_INTERNAL;
   }
 
-  return id;
+  return (int32_t)period_us;
 }
 
 EXPORTED
-uint32_t jsScanHeadGetSerial(jsScanHead scan_head)
+int32_t jsScanSystemStartScanning(jsScanSystem scan_system, uint32_t period_us,
+                                  jsDataFormat fmt)
 {
-  uint32_t serial = 0;
+  int32_t r = 0;
 
   try {
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
-      // make it super obvious that the serial is invalid
-      return UINT_MAX;
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    serial = sh->GetSerialNumber();
+    r = manager->StartScanning(period_us, fmt);
   } catch (std::exception &e) {
     (void)e;
-    serial = UINT_MAX;
+    r = JS_ERROR_INTERNAL;
   }
 
-  return serial;
+  return r;
 }
 
 EXPORTED
-int32_t jsScanHeadGetCapabilities(jsScanHead scan_head,
-                                  jsScanHeadCapabilities *capabilities)
+int32_t jsScanSystemStopScanning(jsScanSystem scan_system)
 {
   int32_t r = 0;
 
   try {
-    if (nullptr == capabilities) {
-      return JS_ERROR_NULL_ARGUMENT;
-    }
-
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    *capabilities = sh->GetCapabilities();
+    r = manager->StopScanning();
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -894,47 +897,46 @@ int32_t jsScanHeadGetCapabilities(jsScanHead scan_head,
   return r;
 }
 
-EXPORTED int32_t jsScanHeadGetFirmwareVersion(jsScanHead scan_head,
-                                           uint32_t *major, uint32_t *minor,
-                                           uint32_t *patch)
+EXPORTED
+bool jsScanSystemIsScanning(jsScanSystem scan_system)
 {
-  int32_t r = 0;
+  bool is_scanning = false;
 
   try {
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
-      return JS_ERROR_INVALID_ARGUMENT;
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return false;
     }
 
-    auto version = sh->GetFirmwareVersion();
-    *major = std::get<0>(version);
-    *minor = std::get<1>(version);
-    *patch = std::get<2>(version);
+    is_scanning = manager->IsScanning();
   } catch (std::exception &e) {
     (void)e;
-    r = JS_ERROR_INTERNAL;
+    is_scanning = false;
   }
 
-  return r;
+  return is_scanning;
 }
 
 EXPORTED
-int32_t jsScanHeadSetConfiguration(jsScanHead scan_head,
-                                   jsScanHeadConfiguration *cfg)
+int32_t jsScanSystemWaitUntilProfilesAvailable(jsScanSystem scan_system,
+                                               uint32_t count,
+                                               uint32_t timeout_us,
+                                               uint32_t *ids,
+                                               uint32_t max_ids)
 {
   int32_t r = 0;
 
   try {
-    if (nullptr == cfg) {
+    if (nullptr == ids) {
       return JS_ERROR_NULL_ARGUMENT;
     }
 
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = sh->SetConfiguration(*cfg);
+    r = manager->WaitUntilAvailableProfiles(count, timeout_us, ids, max_ids);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -944,22 +946,19 @@ int32_t jsScanHeadSetConfiguration(jsScanHead scan_head,
 }
 
 EXPORTED
-int32_t jsScanHeadGetConfiguration(jsScanHead scan_head,
-                                   jsScanHeadConfiguration *cfg)
+int32_t jsScanSystemSetFrameAssembly(jsScanSystem scan_system,
+                                     bool is_enabled,
+                                     uint32_t timeout_us)
 {
   int32_t r = 0;
 
   try {
-    if (nullptr == cfg) {
-      return JS_ERROR_NULL_ARGUMENT;
-    }
-
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    *cfg = sh->GetConfiguration();
+    r = manager->SetFrameAssembly(is_enabled, timeout_us);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -969,22 +968,17 @@ int32_t jsScanHeadGetConfiguration(jsScanHead scan_head,
 }
 
 EXPORTED
-int32_t jsScanHeadGetConfigurationDefault(jsScanHead scan_head,
-                                          jsScanHeadConfiguration *cfg)
+int32_t jsScanSystemGetFrameSize(jsScanSystem scan_system)
 {
   int32_t r = 0;
 
   try {
-    if (nullptr == cfg) {
-      return JS_ERROR_NULL_ARGUMENT;
-    }
-
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    *cfg = sh->GetConfigurationDefault();
+    r = static_cast<int32_t>(manager->GetFrameSize());
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -994,18 +988,24 @@ int32_t jsScanHeadGetConfigurationDefault(jsScanHead scan_head,
 }
 
 EXPORTED
-int32_t jsScanHeadSetCableOrientation(jsScanHead scan_head,
-                                      jsCableOrientation cable)
+int32_t jsScanSystemGetFrameElement(jsScanSystem scan_system, uint32_t index,
+                                    uint32_t *scan_head_id, jsCamera *camera,
+                                    jsLaser *laser)
 {
   int32_t r = 0;
 
   try {
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    if ((nullptr == scan_head_id) || (nullptr == camera) ||
+        (nullptr == laser)) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = sh->SetCableOrientation(cable);
+    r = manager->GetFrameElement(index, scan_head_id, camera, laser);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1015,18 +1015,18 @@ int32_t jsScanHeadSetCableOrientation(jsScanHead scan_head,
 }
 
 EXPORTED
-int32_t jsScanHeadGetCableOrientation(jsScanHead scan_head,
-                                      jsCableOrientation *cable)
+int32_t jsScanSystemWaitUntilFrameAvailable(jsScanSystem scan_system,
+                                            uint32_t timeout_us)
 {
   int32_t r = 0;
 
   try {
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    *cable = sh->GetCableOrientation();
+    r = manager->WaitUntilFrameAvailable(timeout_us);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1036,27 +1036,26 @@ int32_t jsScanHeadGetCableOrientation(jsScanHead scan_head,
 }
 
 EXPORTED
-int32_t jsScanHeadSetAlignment(jsScanHead scan_head, double roll_degrees,
-                               double shift_x, double shift_y)
+int32_t jsScanSystemBorrowFrame(jsScanSystem scan_system, jsFrameInfo *info,
+                                const jsRawProfile **profiles,
+                                uint32_t max_profiles)
 {
   int32_t r = 0;
 
   try {
-    if (INVALID_DOUBLE(roll_degrees) || INVALID_DOUBLE(shift_x) ||
-        INVALID_DOUBLE(shift_y)) {
-      return JS_ERROR_INVALID_ARGUMENT;
+    if ((nullptr == info) || (nullptr == profiles)) {
+      return JS_ERROR_NULL_ARGUMENT;
     }
 
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = sh->SetAlignment(roll_degrees, shift_x, shift_y);
-    if ((0 == r) && sh->IsConnected()) {
-      // changing alignment changes the window
-      r = sh->SendWindow();
-    }
+    // pointers are handed out as const; the scan heads won't write to them
+    // until they are released
+    jsRawProfile **dst = const_cast<jsRawProfile **>(profiles);
+    r = manager->GetFrame(info, dst, max_profiles);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1066,28 +1065,24 @@ int32_t jsScanHeadSetAlignment(jsScanHead scan_head, double roll_degrees,
 }
 
 EXPORTED
-int32_t jsScanHeadSetAlignmentCamera(jsScanHead scan_head, jsCamera camera,
-                                     double roll_degrees, double shift_x,
-                                     double shift_y)
+int32_t jsScanSystemReleaseFrame(jsScanSystem scan_system,
+                                 const jsRawProfile **profiles,
+                                 uint32_t count)
 {
   int32_t r = 0;
 
   try {
-    if (INVALID_DOUBLE(roll_degrees) || INVALID_DOUBLE(shift_x) ||
-        INVALID_DOUBLE(shift_y)) {
-      return JS_ERROR_INVALID_ARGUMENT;
+    if ((nullptr == profiles) && (0 != count)) {
+      return JS_ERROR_NULL_ARGUMENT;
     }
 
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = sh->SetAlignment(camera, roll_degrees, shift_x, shift_y);
-    if ((0 == r) && sh->IsConnected()) {
-      // changing alignment changes the window
-      r = sh->SendWindow(camera);
-    }
+    jsRawProfile **src = const_cast<jsRawProfile **>(profiles);
+    r = manager->ReleaseFrame(src, count);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1097,25 +1092,25 @@ int32_t jsScanHeadSetAlignmentCamera(jsScanHead scan_head, jsCamera camera,
 }
 
 EXPORTED
-int32_t jsScanHeadGetAlignmentCamera(jsScanHead scan_head, jsCamera camera,
-                                     double *roll_degrees, double *shift_x,
-                                     double *shift_y)
+int32_t jsScanSystemStartRecording(jsScanSystem scan_system, const char *path,
+                                   uint64_t max_file_bytes,
+                                   uint32_t max_file_seconds,
+                                   bool is_direct_io)
 {
   int32_t r = 0;
 
   try {
-    if ((nullptr == roll_degrees) || (nullptr == shift_x) ||
-        (nullptr == shift_y)) {
+    if (nullptr == path) {
       return JS_ERROR_NULL_ARGUMENT;
     }
 
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    AlignmentParams alignment;
-    r = sh->GetAlignment(camera, roll_degrees, shift_x, shift_y);
+    r = manager->StartRecording(path, max_file_bytes, max_file_seconds,
+                                is_direct_io);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1125,28 +1120,17 @@ int32_t jsScanHeadGetAlignmentCamera(jsScanHead scan_head, jsCamera camera,
 }
 
 EXPORTED
-int32_t jsScanHeadSetAlignmentLaser(jsScanHead scan_head, jsLaser laser,
-                                    double roll_degrees, double shift_x,
-                                    double shift_y)
+int32_t jsScanSystemStopRecording(jsScanSystem scan_system)
 {
   int32_t r = 0;
 
   try {
-    if (INVALID_DOUBLE(roll_degrees) || INVALID_DOUBLE(shift_x) ||
-               INVALID_DOUBLE(shift_y)) {
-      return JS_ERROR_INVALID_ARGUMENT;
-    }
-
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    r = sh->SetAlignment(laser, roll_degrees, shift_x, shift_y);
-    if ((0 == r) && sh->IsConnected()) {
-      // changing alignment changes the window
-      r = sh->SendWindow(sh->GetPairedCamera(laser));
-    }
+    r = manager->StopRecording();
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1156,25 +1140,22 @@ int32_t jsScanHeadSetAlignmentLaser(jsScanHead scan_head, jsLaser laser,
 }
 
 EXPORTED
-int32_t jsScanHeadGetAlignmentLaser(jsScanHead scan_head, jsLaser laser,
-                                    double *roll_degrees, double *shift_x,
-                                    double *shift_y, bool *is_cable_downstream)
+int32_t jsScanSystemGetRecordingStatistics(jsScanSystem scan_system,
+                                           jsRecordingStatistics *stats)
 {
   int32_t r = 0;
 
   try {
-    if ((nullptr == roll_degrees) || (nullptr == shift_x) ||
-        (nullptr == shift_y) || (nullptr == is_cable_downstream)) {
+    if (nullptr == stats) {
       return JS_ERROR_NULL_ARGUMENT;
     }
 
-    ScanHead *sh = _get_scan_head_object(scan_head);
-    if (nullptr == sh) {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    AlignmentParams alignment;
-    r = sh->GetAlignment(laser, roll_degrees, shift_x, shift_y);
+    r = manager->GetRecordingStatistics(stats);
   } catch (std::exception &e) {
     (void)e;
     r = JS_ERROR_INTERNAL;
@@ -1184,15 +1165,480 @@ int32_t jsScanHeadGetAlignmentLaser(jsScanHead scan_head, jsLaser laser,
 }
 
 EXPORTED
-int32_t jsScanHeadSetWindowRectangular(jsScanHead scan_head, double window_top,
-                                       double window_bottom, double window_left,
-                                       double window_right)
+int32_t jsScanSystemOpenReplay(jsScanSystem scan_system, const char *path)
 {
   int32_t r = 0;
 
   try {
-    if (INVALID_DOUBLE(window_top) || INVALID_DOUBLE(window_bottom) ||
-               INVALID_DOUBLE(window_left) || INVALID_DOUBLE(window_right)) {
+    if (nullptr == path) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = manager->OpenReplay(path);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanSystemStartReplay(jsScanSystem scan_system, double speed)
+{
+  int32_t r = 0;
+
+  try {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = manager->StartReplay(speed);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanSystemStopReplay(jsScanSystem scan_system)
+{
+  int32_t r = 0;
+
+  try {
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = manager->StopReplay();
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanSystemGetReplayStatistics(jsScanSystem scan_system,
+                                        jsReplayStatistics *stats)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == stats) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanManager *manager = _get_scan_manager_object(scan_system);
+    if (nullptr == manager) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = manager->GetReplayStatistics(stats);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+jsScanHeadType jsScanHeadGetType(jsScanHead scan_head)
+{
+  jsScanHeadType type = JS_SCAN_HEAD_INVALID_TYPE;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_SCAN_HEAD_INVALID_TYPE;
+    }
+
+    type = sh->GetType();
+  } catch (std::exception &e) {
+    (void)e;
+    type = JS_SCAN_HEAD_INVALID_TYPE;
+  }
+
+  return type;
+}
+
+EXPORTED
+uint32_t jsScanHeadGetId(jsScanHead scan_head)
+{
+  uint32_t id = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      // make it super obvious that the ID is invalid
+      return UINT_MAX;
+    }
+
+    id = sh->GetId();
+  } catch (std::exception &e) {
+    (void)e;
+    id = UINT_MAX;
+  }
+
+  return id;
+}
+
+EXPORTED
+uint32_t jsScanHeadGetSerial(jsScanHead scan_head)
+{
+  uint32_t serial = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      // make it super obvious that the serial is invalid
+      return UINT_MAX;
+    }
+
+    serial = sh->GetSerialNumber();
+  } catch (std::exception &e) {
+    (void)e;
+    serial = UINT_MAX;
+  }
+
+  return serial;
+}
+
+EXPORTED
+int32_t jsScanHeadGetCapabilities(jsScanHead scan_head,
+                                  jsScanHeadCapabilities *capabilities)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == capabilities) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    *capabilities = sh->GetCapabilities();
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED int32_t jsScanHeadGetFirmwareVersion(jsScanHead scan_head,
+                                           uint32_t *major, uint32_t *minor,
+                                           uint32_t *patch)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    auto version = sh->GetFirmwareVersion();
+    *major = std::get<0>(version);
+    *minor = std::get<1>(version);
+    *patch = std::get<2>(version);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetConfiguration(jsScanHead scan_head,
+                                   jsScanHeadConfiguration *cfg)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == cfg) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetConfiguration(*cfg);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadGetConfiguration(jsScanHead scan_head,
+                                   jsScanHeadConfiguration *cfg)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == cfg) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    *cfg = sh->GetConfiguration();
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadGetConfigurationDefault(jsScanHead scan_head,
+                                          jsScanHeadConfiguration *cfg)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == cfg) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    *cfg = sh->GetConfigurationDefault();
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetCableOrientation(jsScanHead scan_head,
+                                      jsCableOrientation cable)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetCableOrientation(cable);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadGetCableOrientation(jsScanHead scan_head,
+                                      jsCableOrientation *cable)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    *cable = sh->GetCableOrientation();
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetAlignment(jsScanHead scan_head, double roll_degrees,
+                               double shift_x, double shift_y)
+{
+  int32_t r = 0;
+
+  try {
+    if (INVALID_DOUBLE(roll_degrees) || INVALID_DOUBLE(shift_x) ||
+        INVALID_DOUBLE(shift_y)) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetAlignment(roll_degrees, shift_x, shift_y);
+    if ((0 == r) && sh->IsConnected()) {
+      // changing alignment changes the window
+      r = sh->SendWindow();
+    }
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetAlignmentCamera(jsScanHead scan_head, jsCamera camera,
+                                     double roll_degrees, double shift_x,
+                                     double shift_y)
+{
+  int32_t r = 0;
+
+  try {
+    if (INVALID_DOUBLE(roll_degrees) || INVALID_DOUBLE(shift_x) ||
+        INVALID_DOUBLE(shift_y)) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetAlignment(camera, roll_degrees, shift_x, shift_y);
+    if ((0 == r) && sh->IsConnected()) {
+      // changing alignment changes the window
+      r = sh->SendWindow(camera);
+    }
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadGetAlignmentCamera(jsScanHead scan_head, jsCamera camera,
+                                     double *roll_degrees, double *shift_x,
+                                     double *shift_y)
+{
+  int32_t r = 0;
+
+  try {
+    if ((nullptr == roll_degrees) || (nullptr == shift_x) ||
+        (nullptr == shift_y)) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    AlignmentParams alignment;
+    r = sh->GetAlignment(camera, roll_degrees, shift_x, shift_y);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetAlignmentLaser(jsScanHead scan_head, jsLaser laser,
+                                    double roll_degrees, double shift_x,
+                                    double shift_y)
+{
+  int32_t r = 0;
+
+  try {
+    if (INVALID_DOUBLE(roll_degrees) || INVALID_DOUBLE(shift_x) ||
+               INVALID_DOUBLE(shift_y)) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetAlignment(laser, roll_degrees, shift_x, shift_y);
+    if ((0 == r) && sh->IsConnected()) {
+      // changing alignment changes the window
+      r = sh->SendWindow(sh->GetPairedCamera(laser));
+    }
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadGetAlignmentLaser(jsScanHead scan_head, jsLaser laser,
+                                    double *roll_degrees, double *shift_x,
+                                    double *shift_y, bool *is_cable_downstream)
+{
+  int32_t r = 0;
+
+  try {
+    if ((nullptr == roll_degrees) || (nullptr == shift_x) ||
+        (nullptr == shift_y) || (nullptr == is_cable_downstream)) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    AlignmentParams alignment;
+    r = sh->GetAlignment(laser, roll_degrees, shift_x, shift_y);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetWindowRectangular(jsScanHead scan_head, double window_top,
+                                       double window_bottom, double window_left,
+                                       double window_right)
+{
+  int32_t r = 0;
+
+  try {
+    if (INVALID_DOUBLE(window_top) || INVALID_DOUBLE(window_bottom) ||
+               INVALID_DOUBLE(window_left) || INVALID_DOUBLE(window_right)) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
@@ -1250,6 +1696,31 @@ int32_t jsScanHeadGetStatus(jsScanHead scan_head, jsScanHeadStatus *status)
   return r;
 }
 
+EXPORTED
+int32_t jsScanHeadGetReceiveStatistics(jsScanHead scan_head,
+                                       jsScanHeadReceiveStatistics *stats)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == stats) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    *stats = sh->GetReceiveStatistics();
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
 EXPORTED
 bool jsScanHeadIsConnected(jsScanHead scan_head)
 {
@@ -1299,15 +1770,17 @@ int32_t jsScanHeadWaitUntilProfilesAvailable(jsScanHead scan_head,
   int32_t r = 0;
 
   try {
-    if (JS_SCAN_HEAD_PROFILES_MAX < count) {
-      count = JS_SCAN_HEAD_PROFILES_MAX;
-    }
-
     ScanHead *sh = _get_scan_head_object(scan_head);
     if (nullptr == sh) {
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
+    // more than can be buffered would never be available
+    uint32_t capacity = sh->GetProfileBufferCapacity();
+    if (capacity < count) {
+      count = capacity;
+    }
+
     r = sh->WaitUntilAvailableProfiles(count, timeout_us);
   } catch (std::exception &e) {
     (void)e;
@@ -1353,14 +1826,8 @@ int32_t jsScanHeadGetRawProfiles(jsScanHead scan_head, jsRawProfile *profiles,
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    auto p = sh->GetProfiles(static_cast<int>(max_profiles));
-    uint32_t total = (max_profiles < static_cast<uint32_t>(p.size()))
-                       ? max_profiles
-                       : static_cast<uint32_t>(p.size());
-    for (uint32_t n = 0; n < total; n++) {
-      // `ScanHead` returns vector of shared pointers; dereference to copy
-      profiles[n] = *p[n];
-    }
+    uint32_t total = _copy_profiles<jsRawProfile>(sh, max_profiles,
+      [profiles](uint32_t n, const jsRawProfile *p) { profiles[n] = *p; });
 
     // return number of profiles copied
     r = static_cast<int32_t>(total);
@@ -1372,6 +1839,173 @@ int32_t jsScanHeadGetRawProfiles(jsScanHead scan_head, jsRawProfile *profiles,
   return r;
 }
 
+EXPORTED
+int32_t jsScanHeadBorrowProfiles(jsScanHead scan_head,
+                                 const jsRawProfile **profiles,
+                                 uint32_t max_profiles)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == profiles) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    // pointers are handed out as const; the scan head won't write to them
+    // until they are released
+    jsRawProfile **dst = const_cast<jsRawProfile **>(profiles);
+    uint32_t total = sh->GetProfiles(dst, max_profiles);
+
+    // return number of profiles borrowed
+    r = static_cast<int32_t>(total);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadReleaseProfiles(jsScanHead scan_head,
+                                  const jsRawProfile **profiles,
+                                  uint32_t count)
+{
+  int32_t r = 0;
+
+  try {
+    if ((nullptr == profiles) && (0 != count)) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    jsRawProfile **src = const_cast<jsRawProfile **>(profiles);
+    r = sh->ReleaseProfiles(src, count);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadRegisterProfileCallback(jsScanHead scan_head,
+                                          jsProfileCallback fn,
+                                          void *user_ctx)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->RegisterProfileCallback(fn, user_ctx);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetResampling(jsScanHead scan_head, jsEncoder encoder,
+                                uint32_t ticks_per_slice, jsResampleMode mode)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetResampling(encoder, ticks_per_slice, mode);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetPresenceGate(jsScanHead scan_head, uint32_t open_points,
+                                  uint32_t close_points, uint32_t pre_roll,
+                                  uint32_t post_roll)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetPresenceGate(open_points, close_points, pre_roll, post_roll);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetProfileBufferCapacity(jsScanHead scan_head,
+                                           uint32_t capacity)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetProfileBufferCapacity(capacity);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadSetProfileBufferOverflow(jsScanHead scan_head,
+                                           jsOverflowPolicy policy,
+                                           uint32_t timeout_us)
+{
+  int32_t r = 0;
+
+  try {
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
+    }
+
+    r = sh->SetProfileBufferOverflow(policy, timeout_us);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
 EXPORTED
 int32_t jsScanHeadGetProfiles(jsScanHead scan_head, jsProfile *profiles,
                               uint32_t max_profiles)
@@ -1388,38 +2022,49 @@ int32_t jsScanHeadGetProfiles(jsScanHead scan_head, jsProfile *profiles,
       return JS_ERROR_INVALID_ARGUMENT;
     }
 
-    auto p = sh->GetProfiles(static_cast<int>(max_profiles));
-    uint32_t total = (max_profiles < static_cast<uint32_t>(p.size()))
-                       ? max_profiles
-                       : static_cast<uint32_t>(p.size());
-
-    for (uint32_t m = 0; m < total; m++) {
-      profiles[m].scan_head_id = p[m]->scan_head_id;
-      profiles[m].camera = p[m]->camera;
-      profiles[m].laser = p[m]->laser;
-      profiles[m].timestamp_ns = p[m]->timestamp_ns;
-      profiles[m].flags = p[m]->flags;
-      profiles[m].sequence_number = p[m]->sequence_number;
-      profiles[m].laser_on_time_us = p[m]->laser_on_time_us;
-      profiles[m].format = p[m]->format;
-      profiles[m].packets_received = p[m]->packets_received;
-      profiles[m].packets_expected = p[m]->packets_expected;
-      profiles[m].num_encoder_values = p[m]->num_encoder_values;
-      memcpy(profiles[m].encoder_values, p[m]->encoder_values,
-             p[m]->num_encoder_values * sizeof(uint64_t));
-
-      unsigned int stride = _data_format_to_stride(profiles[m].format);
-      unsigned int len = 0;
-      for (unsigned int n = 0; n < p[m]->data_len; n += stride) {
-        if ((JS_PROFILE_DATA_INVALID_XY != p[m]->data[n].x) ||
-            (JS_PROFILE_DATA_INVALID_XY != p[m]->data[n].y)) {
-          // Note: Only need to check X/Y since we only support data types with
-          // X/Y coordinates alone or X/Y coordinates with brightness.
-          profiles[m].data[len++] = p[m]->data[n];
-        }
-      }
-      profiles[m].data_len = len;
+    auto copy = [profiles](uint32_t m, const jsRawProfile *p) {
+      CopyProfileCompacted(p, &profiles[m]);
+    };
+
+    uint32_t total = _copy_profiles<jsRawProfile>(sh, max_profiles, copy);
+    // return number of profiles copied
+    r = static_cast<int32_t>(total);
+  } catch (std::exception &e) {
+    (void)e;
+    r = JS_ERROR_INTERNAL;
+  }
+
+  return r;
+}
+
+EXPORTED
+int32_t jsScanHeadGetProfilesSoA(jsScanHead scan_head, jsProfileSoA *profiles,
+                                 uint32_t max_profiles)
+{
+  int32_t r = 0;
+
+  try {
+    if (nullptr == profiles) {
+      return JS_ERROR_NULL_ARGUMENT;
+    }
+
+    ScanHead *sh = _get_scan_head_object(scan_head);
+    if (nullptr == sh) {
+      return JS_ERROR_INVALID_ARGUMENT;
     }
+
+    auto copy = [profiles](uint32_t m, const jsProfileSoA *p) {
+      jsProfileSoA *dst = &profiles[m];
+      const uint32_t len = p->data_len;
+
+      // only copy the valid part of each array
+      memcpy(dst, p, offsetof(jsProfileSoA, x));
+      memcpy(dst->x, p->x, len * sizeof(float));
+      memcpy(dst->y, p->y, len * sizeof(float));
+      memcpy(dst->brightness, p->brightness, len * sizeof(uint8_t));
+    };
+
+    uint32_t total = _copy_profiles<jsProfileSoA>(sh, max_profiles, copy);
     // return number of profiles copied
     r = static_cast<int32_t>(total);
   } catch (std::exception &e) {
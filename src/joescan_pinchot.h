@@ -68,6 +68,16 @@ enum jsConstants {
    * scan head with one API call.
    */
   JS_SCAN_HEAD_PROFILES_MAX = 1000,
+  /**
+   * @brief The maximum number of profiles that can be passed on from before
+   * the presence gate of a scan head opens.
+   */
+  JS_PRESENCE_GATE_PRE_ROLL_MAX = 8,
+  /**
+   * @brief The maximum number of profiles that can be buffered for a given
+   * scan head, as set by `jsScanHeadSetProfileBufferCapacity`.
+   */
+  JS_SCAN_HEAD_PROFILE_BUFFER_MAX = 100000,
 };
 
 /**
@@ -225,6 +235,87 @@ typedef enum {
   JS_DIAGNOSTIC_AUTO_EXPOSURE,
 } jsDiagnosticMode;
 
+/**
+ * @brief Enumerated value selecting how scan data is received from the scan
+ * heads of a scan system.
+ */
+typedef enum {
+  JS_RECEIVE_MODE_INVALID = 0,
+  /** @brief Each scan head receives data on its own dedicated thread. */
+  JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD = 1,
+  /**
+   * @brief A small number of threads each receive data for many scan heads,
+   * waiting on all of their network connections at once. Only available on
+   * Linux.
+   */
+  JS_RECEIVE_MODE_REACTOR = 2,
+  /**
+   * @brief Like `JS_RECEIVE_MODE_REACTOR`, but data is received using io_uring
+   * with multishot receives into kernel provided buffers, greatly reducing the
+   * number of system calls and copies made per profile. Only available on
+   * Linux 6.0 or newer.
+   */
+  JS_RECEIVE_MODE_IO_URING = 3,
+} jsReceiveMode;
+
+/**
+ * @brief Enumerated value selecting how scan data is laid out in memory as
+ * profiles are assembled.
+ */
+typedef enum {
+  JS_PROFILE_LAYOUT_INVALID = 0,
+  /**
+   * @brief Profiles are assembled as `jsRawProfile`, with each point of the
+   * scan line held together in a `jsProfileData` structure. Read out with
+   * `jsScanHeadGetProfiles`, `jsScanHeadGetRawProfiles` or
+   * `jsScanHeadBorrowProfiles`.
+   */
+  JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES = 1,
+  /**
+   * @brief Profiles are assembled as `jsProfileSoA`, with X, Y and brightness
+   * held in separate arrays. Read out with `jsScanHeadGetProfilesSoA`.
+   */
+  JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS = 2,
+} jsProfileLayout;
+
+/**
+ * @brief Enumerated value selecting how a profile is produced for each slice
+ * when resampling profiles by encoder position.
+ */
+typedef enum {
+  JS_RESAMPLE_MODE_INVALID = 0,
+  /** @brief The profile taken nearest to the slice boundary is used as is. */
+  JS_RESAMPLE_MODE_NEAREST = 1,
+  /**
+   * @brief A profile is interpolated at the slice boundary from the profiles
+   * taken on either side of it. Points only valid in one of the profiles are
+   * taken from the nearer one. Falls back to `JS_RESAMPLE_MODE_NEAREST` if
+   * profiles are compacted.
+   */
+  JS_RESAMPLE_MODE_LINEAR = 2,
+} jsResampleMode;
+
+/**
+ * @brief Enumerated value selecting what happens to a newly assembled profile
+ * when the profile buffer of a scan head is full.
+ */
+typedef enum {
+  JS_OVERFLOW_POLICY_INVALID = 0,
+  /**
+   * @brief The oldest profile in the buffer is discarded to make room. This
+   * is the default.
+   */
+  JS_OVERFLOW_POLICY_OVERWRITE_OLDEST = 1,
+  /** @brief The newly assembled profile is discarded. */
+  JS_OVERFLOW_POLICY_DROP_NEWEST = 2,
+  /**
+   * @brief Receiving data is paused until the application reads out a
+   * profile or a timeout expires, after which the newly assembled profile is
+   * discarded.
+   */
+  JS_OVERFLOW_POLICY_BLOCK = 3,
+} jsOverflowPolicy;
+
 #pragma pack(push, 1)
 
 /**
@@ -368,6 +459,130 @@ typedef struct {
   uint32_t num_profiles_sent;
 } jsScanHeadStatus;
 
+/**
+ * @brief Structure used to hold client side statistics pertaining to the
+ * reception and buffering of profile data from a scan head.
+ */
+typedef struct {
+  /** @brief Total number of profile buffers preallocated for the scan head. */
+  uint32_t profile_pool_capacity;
+  /** @brief Number of profile buffers currently holding profile data. */
+  uint32_t profile_pool_in_use;
+  /**
+   * @brief Largest number of profile buffers in use at once since scanning
+   * was last started.
+   */
+  uint32_t profile_pool_high_water;
+  /**
+   * @brief Number of profiles discarded since scanning was last started due to
+   * no profile buffer being free.
+   */
+  uint64_t profile_pool_exhausted;
+  /**
+   * @brief Number of profiles assembled with all of their packets since
+   * scanning was last started.
+   */
+  uint64_t profiles_completed;
+  /**
+   * @brief Number of profiles given up on and returned with missing packets
+   * since scanning was last started.
+   */
+  uint64_t profiles_partial;
+  /**
+   * @brief Number of packets received since scanning was last started that
+   * arrived interleaved with packets of another profile.
+   */
+  uint64_t packets_reordered;
+  /**
+   * @brief Number of profiles dropped since scanning was last started by
+   * resampling, due to another profile being nearer to the slice boundary.
+   */
+  uint64_t profiles_resampled_out;
+  /**
+   * @brief Number of profiles discarded since scanning was last started by
+   * the presence gate, due to nothing being in the scan window.
+   */
+  uint64_t profiles_gated;
+  /** @brief Number of profiles the profile buffer of the scan head holds. */
+  uint32_t profile_buffer_capacity;
+  /**
+   * @brief Largest number of profiles waiting in the profile buffer at once
+   * since scanning was last started.
+   */
+  uint32_t profile_buffer_high_water;
+  /**
+   * @brief Number of profiles discarded since scanning was last started to
+   * make room in a full profile buffer, per
+   * `JS_OVERFLOW_POLICY_OVERWRITE_OLDEST`.
+   */
+  uint64_t profiles_overwritten;
+  /**
+   * @brief Number of newly assembled profiles discarded since scanning was
+   * last started due to the profile buffer being full, per
+   * `JS_OVERFLOW_POLICY_DROP_NEWEST` or `JS_OVERFLOW_POLICY_BLOCK`.
+   */
+  uint64_t profiles_dropped;
+} jsScanHeadReceiveStatistics;
+
+/**
+ * @brief Structure used to hold statistics pertaining to the recording of
+ * the data streams of a scan system.
+ */
+typedef struct {
+  /** @brief Boolean `true` if a recording is in progress. */
+  bool is_recording;
+  /** @brief Number of messages written to the recording. */
+  uint64_t records_written;
+  /**
+   * @brief Number of messages left out of the recording, due to the writer
+   * falling behind or the recording failing to be written.
+   */
+  uint64_t records_dropped;
+  /**
+   * @brief Number of times the receive path of a scan head found all of its
+   * recording buffers waiting to be written.
+   */
+  uint64_t buffer_full_events;
+  /** @brief Number of bytes written to disk, across all files. */
+  uint64_t bytes_written;
+  /** @brief Number of files the recording has been written to. */
+  uint32_t files_written;
+  /** @brief Number of recording buffers each scan head has. */
+  uint32_t buffers_per_scan_head;
+  /**
+   * @brief Largest number of recording buffers of a scan head waiting to be
+   * written at once.
+   */
+  uint32_t buffers_pending_high_water;
+  /** @brief Number of failed writes; no more data is written after one. */
+  uint32_t write_errors;
+} jsRecordingStatistics;
+
+/**
+ * @brief Structure used to hold statistics pertaining to the replay of a
+ * recording into a scan system.
+ */
+typedef struct {
+  /** @brief Boolean `true` once all data of the recording has been replayed. */
+  bool is_finished;
+  /**
+   * @brief Boolean `true` if a file of the recording was found to be
+   * truncated or corrupt, ending the replay early.
+   */
+  bool is_truncated;
+  /** @brief Number of messages handed to the scan heads. */
+  uint64_t records_replayed;
+  /** @brief Number of message bytes handed to the scan heads. */
+  uint64_t bytes_replayed;
+  /**
+   * @brief Longest time in microseconds a message was handed over later than
+   * its recorded timing called for; `0` when replaying as fast as possible.
+   */
+  uint64_t max_lag_us;
+  /** @brief Number of files of the recording read. */
+  uint32_t files_read;
+} jsReplayStatistics;
+
 /**
  * @brief A data point within a returned profile's data.
  */
@@ -429,8 +644,11 @@ typedef struct {
    * profile held in the `data` array.
    */
   uint32_t data_len;
-  /** @brief Reserved for future use. */
-  uint64_t reserved_0;
+  /**
+   * @brief Number of profiles discarded by the presence gate right before
+   * this profile, as set by `jsScanHeadSetPresenceGate`.
+   */
+  uint64_t gap_profiles;
   /** @brief Reserved for future use. */
   uint64_t reserved_1;
   /** @brief Reserved for future use. */
@@ -445,6 +663,63 @@ typedef struct {
   jsProfileData data[JS_PROFILE_DATA_LEN];
 } jsProfile;
 
+/**
+ * @brief Profile with scan line data held as a structure of arrays, rather
+ * than an array of `jsProfileData` structures. Only valid points are held,
+ * in order, so the `x`, `y` and `brightness` arrays can be processed directly
+ * with vectorized code.
+ */
+typedef struct {
+  /** @brief The Id of the scan head that the profile originates from. */
+  uint32_t scan_head_id;
+  /** @brief The camera used for the profile. */
+  jsCamera camera;
+  /** @brief The laser used for the profile. */
+  jsLaser laser;
+  /** @brief Time of the scan head in nanoseconds when profile was taken. */
+  uint64_t timestamp_ns;
+  /** @brief Bitmask of flags listed in `enum jsProfileFlags`. */
+  uint32_t flags;
+  /** @brief Monotonically increasing count of profiles generated by camera. */
+  uint32_t sequence_number;
+  /** @brief Array holding current encoder values. */
+  int64_t encoder_values[JS_ENCODER_MAX];
+  /** @brief Number of encoder values in this profile. */
+  uint32_t num_encoder_values;
+  /** @brief Time in microseconds for the laser emitting. */
+  uint32_t laser_on_time_us;
+  /**
+   * @brief The format of the data for the given `jsProfileSoA`.
+   */
+  jsDataFormat format;
+  /**
+   * @brief Number of packets received for the profile. If less than
+   * `packets_expected`, then the profile data is incomplete. Generally,
+   * this implies some type of network issue.
+   */
+  uint32_t packets_received;
+  /** @brief Total number of packets expected to comprise the profile. */
+  uint32_t packets_expected;
+  /**
+   * @brief The total number of valid scan line measurement points for this
+   * profile held in the `x`, `y` and `brightness` arrays.
+   */
+  uint32_t data_len;
+  /** @brief Reserved for future use. */
+  uint64_t reserved_0;
+  /** @brief Reserved for future use. */
+  uint64_t reserved_1;
+  /** @brief The X coordinates in scan system units. */
+  float x[JS_PROFILE_DATA_LEN];
+  /** @brief The Y coordinates in scan system units. */
+  float y[JS_PROFILE_DATA_LEN];
+  /**
+   * @brief Measured brightness at each point. If the data format does not
+   * include brightness, will be set to `JS_PROFILE_DATA_INVALID_BRIGHTNESS`.
+   */
+  uint8_t brightness[JS_PROFILE_DATA_LEN];
+} jsProfileSoA;
+
 /**
  * @brief A Raw Profile is the most basic type of profile returned back from
  * a scan head. The data is left unprocessed with the contents being dependent
@@ -509,8 +784,11 @@ typedef struct {
    * Invalid `x` and `y` will have both set to `JS_PROFILE_DATA_INVALID_XY`.
    */
   uint32_t data_valid_xy;
-  /** @brief Reserved for future use. */
-  uint64_t reserved_0;
+  /**
+   * @brief Number of profiles discarded by the presence gate right before
+   * this profile, as set by `jsScanHeadSetPresenceGate`.
+   */
+  uint64_t gap_profiles;
   /** @brief Reserved for future use. */
   uint64_t reserved_1;
   /** @brief Reserved for future use. */
@@ -556,8 +834,36 @@ typedef struct {
   uint8_t data[JS_CAMERA_IMAGE_DATA_LEN];
 } jsCameraImage;
 
+/**
+ * @brief Describes a frame of profiles, holding the profiles taken by every
+ * scan head, camera and laser of the phase table during one scan period.
+ */
+typedef struct {
+  /** @brief Earliest time of the scan heads in nanoseconds of the profiles. */
+  uint64_t timestamp_ns;
+  /** @brief The sequence number shared by the profiles of the frame. */
+  uint32_t sequence_number;
+  /** @brief Number of profiles making up the frame, including missing ones. */
+  uint32_t num_profiles;
+  /**
+   * @brief Number of profiles that were not received before the frame timed
+   * out. Missing profiles are set to `NULL` in the frame.
+   */
+  uint32_t num_missing;
+} jsFrameInfo;
+
 #pragma pack(pop)
 
+/**
+ * @brief Function called with each profile received from a scan head, as
+ * registered with `jsScanHeadRegisterProfileCallback`.
+ *
+ * @param profile Pointer to the profile data. Only valid until the function
+ * returns; the storage is then reused for newly received profile data.
+ * @param user_ctx The pointer passed to `jsScanHeadRegisterProfileCallback`.
+ */
+typedef void (*jsProfileCallback)(const jsRawProfile *profile, void *user_ctx);
+
 #ifndef NO_PINCHOT_INTERFACE
 
 // Macros for setting the visiblity of functions within the library.
@@ -873,6 +1179,100 @@ EXPORTED int32_t PRE jsScanSystemPhaseInsertLaserConfiguration(
   jsLaser laser,
   jsScanHeadConfiguration cfg) POST;
 
+/**
+ * @brief Selects how scan data is received from the scan heads of a scan
+ * system. By default, `JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD` is used.
+ *
+ * @note This function can only be called when the scan system is disconnected.
+ * On platforms where the requested mode is not available, the scan system will
+ * fall back to `JS_RECEIVE_MODE_THREAD_PER_SCAN_HEAD`.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param mode The receive mode to use.
+ * @param num_threads The number of receive threads to use for the
+ * `JS_RECEIVE_MODE_REACTOR` and `JS_RECEIVE_MODE_IO_URING` modes. Pass `0` to
+ * let the scan system decide based on the number of scan heads. Ignored for
+ * other modes.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemSetReceiveMode(
+  jsScanSystem scan_system,
+  jsReceiveMode mode,
+  uint32_t num_threads) POST;
+
+/**
+ * @brief Gets the mode used to receive scan data from the scan heads of a scan
+ * system. This reflects any fall back made due to the requested mode not being
+ * available on the platform.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @return The `jsReceiveMode` in use on success, negative value mapping to
+ * `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemGetReceiveMode(
+  jsScanSystem scan_system) POST;
+
+/**
+ * @brief Selects whether profiles are compacted as they are received. When
+ * enabled, only the valid points of each profile are kept, in order, at the
+ * front of the `data` array with `data_len` set to the number of valid points.
+ * This moves the filtering done by `jsScanHeadGetProfiles` off of the
+ * application's thread, reducing it to a single copy per profile. By default,
+ * profiles are not compacted.
+ *
+ * @note When enabled, profiles read with `jsScanHeadGetRawProfiles` or
+ * `jsScanHeadBorrowProfiles` are compacted as well and no longer hold points
+ * at the `data` index of their camera column.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param is_enabled Boolean `true` to compact profiles, `false` otherwise.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemSetProfileCompaction(
+  jsScanSystem scan_system,
+  bool is_enabled) POST;
+
+/**
+ * @brief Selects how scan data is laid out in memory as profiles are
+ * assembled. By default, `JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES` is used.
+ *
+ * @note Profiles are only assembled in the selected layout; when using
+ * `JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS`, profiles must be read out with
+ * `jsScanHeadGetProfilesSoA` and the other functions reading profiles will
+ * not return any. Profile compaction set by `jsScanSystemSetProfileCompaction`
+ * has no effect on `jsProfileSoA`, which is always compacted.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param layout The profile layout to use.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemSetProfileLayout(
+  jsScanSystem scan_system,
+  jsProfileLayout layout) POST;
+
+/**
+ * @brief Selects the number of threads used to invoke the functions
+ * registered with `jsScanHeadRegisterProfileCallback`. By default, no threads
+ * are used and the functions are called directly by the thread receiving the
+ * scan data, as soon as each profile is assembled. With threads, the receive
+ * thread only hands each profile over, so slow functions do not hold up
+ * receiving data; the scan heads are spread evenly over the threads.
+ *
+ * @note This function can only be called when the scan system is disconnected.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param num_threads The number of threads to use, `0` to call the functions
+ * from the receive thread.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemSetProfileCallbackThreads(
+  jsScanSystem scan_system,
+  uint32_t num_threads) POST;
+
 /**
  * @brief Obtains the minimum period that a given scan system can achieve
  * scanning when `jsScanSystemStartScanning` is called.
@@ -921,6 +1321,257 @@ EXPORTED int32_t PRE jsScanSystemStopScanning(
 EXPORTED bool PRE jsScanSystemIsScanning(
   jsScanSystem scan_system) POST;
 
+/**
+ * @brief Blocks until the total number of profiles available to be read out
+ * across all scan heads of a given scan system reaches the number requested,
+ * then reports which scan heads have profiles to be read. This allows a single
+ * thread to service every scan head of the system.
+ *
+ * @note Passing a `count` of `1` returns as soon as any scan head has a
+ * profile available.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param count The total number of profiles to wait for.
+ * @param timeout_us Maximum amount of time to wait for in microseconds.
+ * @param ids Array to be filled with the IDs of the scan heads that have
+ * profiles available, as given to `jsScanSystemCreateScanHead`.
+ * @param max_ids The maximum number of IDs to fill in. Should be at least the
+ * number of scan heads in the system so that none are left out.
+ * @return `0` on timeout with no profiles available, positive value indicating
+ * the number of IDs filled in, or negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemWaitUntilProfilesAvailable(
+  jsScanSystem scan_system,
+  uint32_t count,
+  uint32_t timeout_us,
+  uint32_t *ids,
+  uint32_t max_ids) POST;
+
+/**
+ * @brief Selects whether profiles are grouped into frames as they are read
+ * out. A frame holds the profiles taken by every scan head, camera and laser
+ * element of the phase table during one scan period, matched up by sequence
+ * number and timestamp. Frames are read out in order with
+ * `jsScanSystemBorrowFrame`. By default, frames are not assembled.
+ *
+ * @note A frame that is still missing profiles once `timeout_us` has passed
+ * since its first profile was read out is handed out with the missing
+ * elements set to `NULL`.
+ *
+ * @note Frames are assembled from the profiles queued by the scan heads;
+ * while enabled, profiles should not be read from the individual scan heads.
+ * Scan heads with a function registered by
+ * `jsScanHeadRegisterProfileCallback` don't queue profiles and will always be
+ * missing from frames. Frames can't be used with the
+ * `JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS` layout.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param is_enabled Boolean `true` to assemble frames, `false` otherwise.
+ * @param timeout_us Maximum amount of time in microseconds to wait for all
+ * profiles of a frame. Must be non-zero if `is_enabled` is `true`.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemSetFrameAssembly(
+  jsScanSystem scan_system,
+  bool is_enabled,
+  uint32_t timeout_us) POST;
+
+/**
+ * @brief Obtains the number of profiles that make up a frame, one for each
+ * scan head, camera and laser element of the phase table. A camera and laser
+ * pair scanned in more than one phase is only counted once.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @return The number of profiles per frame on success, negative value
+ * mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemGetFrameSize(
+  jsScanSystem scan_system) POST;
+
+/**
+ * @brief Obtains the phase table element whose profile is held at a given
+ * index of a frame. Elements are ordered by phase, then in the order they
+ * were inserted into the phase.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param index The index into the frame, less than the frame size.
+ * @param scan_head_id Pointer to be updated with the ID of the scan head.
+ * @param camera Pointer to be updated with the camera.
+ * @param laser Pointer to be updated with the laser.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemGetFrameElement(
+  jsScanSystem scan_system,
+  uint32_t index,
+  uint32_t *scan_head_id,
+  jsCamera *camera,
+  jsLaser *laser) POST;
+
+/**
+ * @brief Blocks until a frame is ready to be read out from a given scan
+ * system, either because it holds all of its profiles or because it timed
+ * out.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param timeout_us Maximum amount of time to wait for in microseconds.
+ * @return `0` on timeout with no frames ready, positive value indicating the
+ * number of frames ready to be read, or negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemWaitUntilFrameAvailable(
+  jsScanSystem scan_system,
+  uint32_t timeout_us) POST;
+
+/**
+ * @brief Borrows the oldest frame ready to be read out from a given scan
+ * system without copying its profiles. The profile of each element is placed
+ * at its index in `profiles`, as reported by `jsScanSystemGetFrameElement`;
+ * elements missing from the frame are set to `NULL`.
+ *
+ * @note The profiles point into storage owned by the scan heads and must be
+ * handed back with `jsScanSystemReleaseFrame` once the application is done
+ * with them.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param info Pointer to be updated with information about the frame.
+ * @param profiles Array to be filled with pointers to profile data. Note, the
+ * array must be able to hold at least `max_profiles` pointers.
+ * @param max_profiles The length of the `profiles` array. Must be at least
+ * the frame size reported by `jsScanSystemGetFrameSize`.
+ * @return `0` if no frame is ready, positive value indicating the number of
+ * entries filled in `profiles`, or negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemBorrowFrame(
+  jsScanSystem scan_system,
+  jsFrameInfo *info,
+  const jsRawProfile **profiles,
+  uint32_t max_profiles) POST;
+
+/**
+ * @brief Hands the profiles of a frame obtained with `jsScanSystemBorrowFrame`
+ * back to their scan heads so their storage can be reused. The profiles must
+ * not be accessed after being released.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param profiles Array of pointers to borrowed profile data; `NULL` entries
+ * are skipped.
+ * @param count The number of entries in the array.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemReleaseFrame(
+  jsScanSystem scan_system,
+  const jsRawProfile **profiles,
+  uint32_t count) POST;
+
+/**
+ * @brief Starts recording the data received from every scan head of the scan
+ * system to disk, exactly as received, so that it can be replayed later. The
+ * data is written by a background thread; if it falls behind, data is dropped
+ * from the recording rather than slowing the receipt of profiles. Any
+ * recording already in progress is stopped first.
+ *
+ * @note Only scan heads created before recording starts are recorded. The
+ * recording is split across files named by appending `.NNNNNN` to `path`.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param path The path of the recording.
+ * @param max_file_bytes Size in bytes at which a new file is started, or `0`
+ * for no limit.
+ * @param max_file_seconds Age in seconds at which a new file is started, or
+ * `0` for no limit.
+ * @param is_direct_io Boolean `true` to bypass the operating system's file
+ * cache where supported.
+ * @return `0` on success, negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemStartRecording(
+  jsScanSystem scan_system,
+  const char *path,
+  uint64_t max_file_bytes,
+  uint32_t max_file_seconds,
+  bool is_direct_io) POST;
+
+/**
+ * @brief Stops recording, writing out all data recorded so far.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @return `0` on success, negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemStopRecording(
+  jsScanSystem scan_system) POST;
+
+/**
+ * @brief Obtains statistics of the current or last recording.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param stats Pointer to be updated with the statistics.
+ * @return `0` on success, negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemGetRecordingStatistics(
+  jsScanSystem scan_system,
+  jsRecordingStatistics *stats) POST;
+
+/**
+ * @brief Opens a recording made with `jsScanSystemStartRecording` to be
+ * replayed into the scan system. The scan heads recorded are then reported by
+ * `jsScanSystemGetDiscovered` and can be created with
+ * `jsScanSystemCreateScanHead` and configured as though they were on the
+ * network.
+ *
+ * @note The scan system must not be connected. Scan heads created for replay
+ * can not be connected to.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param path The path the recording was made with, without file index.
+ * @return The number of scan heads recorded on success, negative value
+ * `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemOpenReplay(
+  jsScanSystem scan_system,
+  const char *path) POST;
+
+/**
+ * @brief Starts replaying the recording opened with `jsScanSystemOpenReplay`
+ * in place of `jsScanSystemStartScanning`. The recorded data of each scan
+ * head created is passed through the same processing as data received from
+ * the network, using the data format and scan period it was recorded with;
+ * profiles are read out the same way as when scanning. The scan system
+ * reports that it is scanning until `jsScanSystemStopReplay` or
+ * `jsScanSystemStopScanning` is called, even once all data has been
+ * replayed.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param speed Multiple of the recorded rate to replay at, such as `1.0` for
+ * the original timing or `10.0` for ten times faster, or `0` to replay as
+ * fast as the scan system can take the data.
+ * @return `0` on success, negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemStartReplay(
+  jsScanSystem scan_system,
+  double speed) POST;
+
+/**
+ * @brief Stops replaying a recording. Profiles already received are left
+ * available to read.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @return `0` on success, negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemStopReplay(
+  jsScanSystem scan_system) POST;
+
+/**
+ * @brief Obtains statistics of the current or last replay, including whether
+ * all data has been replayed.
+ *
+ * @param scan_system Reference to system of scan heads.
+ * @param stats Pointer to be updated with the statistics.
+ * @return `0` on success, negative value `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanSystemGetReplayStatistics(
+  jsScanSystem scan_system,
+  jsReplayStatistics *stats) POST;
+
 /**
  * @brief Obtains the product type of a given scan head.
  *
@@ -1183,6 +1834,18 @@ EXPORTED int32_t PRE jsScanHeadGetStatus(
   jsScanHead scan_head,
   jsScanHeadStatus *status) POST;
 
+/**
+ * @brief Reads the client side statistics for profile data received from a
+ * scan head.
+ *
+ * @param scan_head Reference to scan head.
+ * @param stats Pointer to be updated with statistics contents.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadGetReceiveStatistics(
+  jsScanHead scan_head,
+  jsScanHeadReceiveStatistics *stats) POST;
+
 /**
  * @brief Obtains the number of profiles currently available to be read out from
  * a given scan head.
@@ -1199,8 +1862,9 @@ EXPORTED int32_t PRE jsScanHeadGetProfilesAvailable(
  * out from a given scan head.
  *
  * @param scan_head Reference to scan head.
- * @param count The number of profiles to wait for. Should not exceed
- * `JS_SCAN_HEAD_PROFILES_MAX`.
+ * @param count The number of profiles to wait for. Values larger than the
+ * profile buffer capacity set with `jsScanHeadSetProfileBufferCapacity` wait
+ * for a full buffer.
  * @param timeout_us Maximum amount of time to wait for in microseconds.
  * @return `0` on timeout with no profiles available, positive value indicating
  * the total number of profiles able to be read after `count` or `timeout_us` is
@@ -1237,8 +1901,9 @@ EXPORTED int32_t PRE jsScanHeadClearProfiles(
  * @param profiles Pointer to memory to store profile data. Note, the memory
  * pointed to by `profiles` must be at least `sizeof(jsProfile) * max` in
  * total number of bytes available.
- * @param max_profiles The maximum number of profiles to read. Should not
- * exceed `JS_SCAN_HEAD_PROFILES_MAX`.
+ * @param max_profiles The maximum number of profiles to read. Need not
+ * exceed the profile buffer capacity set with
+ * `jsScanHeadSetProfileBufferCapacity`.
  * @return The number of profiles read on success, negative value mapping to
  * `jsError` on error.
  */
@@ -1247,6 +1912,30 @@ EXPORTED int32_t PRE jsScanHeadGetProfiles(
   jsProfile *profiles,
   uint32_t max_profiles) POST;
 
+/**
+ * @brief Reads `jsProfileSoA` formatted profile data from a given scan head.
+ * The number of profiles returned is either the max value requested or the
+ * total number of profiles ready to be read out, whichever is less.
+ *
+ * @note Profiles are only available in this format if the scan system was
+ * set to use `JS_PROFILE_LAYOUT_STRUCTURE_OF_ARRAYS` with
+ * `jsScanSystemSetProfileLayout`.
+ *
+ * @param scan_head Reference to scan head.
+ * @param profiles Pointer to memory to store profile data. Note, the memory
+ * pointed to by `profiles` must be at least `sizeof(jsProfileSoA) * max` in
+ * total number of bytes available.
+ * @param max_profiles The maximum number of profiles to read. Need not
+ * exceed the profile buffer capacity set with
+ * `jsScanHeadSetProfileBufferCapacity`.
+ * @return The number of profiles read on success, negative value mapping to
+ * `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadGetProfilesSoA(
+  jsScanHead scan_head,
+  jsProfileSoA *profiles,
+  uint32_t max_profiles) POST;
+
 /**
  * @brief Reads `jsRawProfile` formatted profile data from a given scan head.
  * The number of profiles returned is either the max value requested or the
@@ -1256,8 +1945,9 @@ EXPORTED int32_t PRE jsScanHeadGetProfiles(
  * @param profiles Pointer to memory to store profile data. Note, the memory
  * pointed to by `profiles` must be at least `sizeof(jsRawProfile) * max` in
  * total number of bytes available.
- * @param max_profiles The maximum number of profiles to read. Should not
- * exceed `JS_SCAN_HEAD_PROFILES_MAX`.
+ * @param max_profiles The maximum number of profiles to read. Need not
+ * exceed the profile buffer capacity set with
+ * `jsScanHeadSetProfileBufferCapacity`.
  * @return The number of profiles read on success, negative value mapping to
  * `jsError` on error.
  */
@@ -1266,6 +1956,182 @@ EXPORTED int32_t PRE jsScanHeadGetRawProfiles(
   jsRawProfile *profiles,
   uint32_t max_profiles) POST;
 
+/**
+ * @brief Borrows `jsRawProfile` formatted profile data from a given scan head
+ * without copying it. The number of profiles returned is either the max value
+ * requested or the total number of profiles ready to be read out, whichever
+ * is less.
+ *
+ * @note The profiles point into storage owned by the scan head and must be
+ * handed back with `jsScanHeadReleaseProfiles` once the application is done
+ * with them. Profiles held by the application can't be used to store newly
+ * received profile data; holding too many will cause profiles to be dropped,
+ * as reported by `jsScanHeadGetReceiveStatistics`.
+ *
+ * @param scan_head Reference to scan head.
+ * @param profiles Array to be filled with pointers to profile data. Note, the
+ * array must be able to hold at least `max_profiles` pointers.
+ * @param max_profiles The maximum number of profiles to borrow. Need not
+ * exceed the profile buffer capacity set with
+ * `jsScanHeadSetProfileBufferCapacity`.
+ * @return The number of profiles borrowed on success, negative value mapping
+ * to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadBorrowProfiles(
+  jsScanHead scan_head,
+  const jsRawProfile **profiles,
+  uint32_t max_profiles) POST;
+
+/**
+ * @brief Hands profiles obtained with `jsScanHeadBorrowProfiles` back to the
+ * scan head they were borrowed from so their storage can be reused. The
+ * profiles must not be accessed after being released.
+ *
+ * @param scan_head Reference to scan head.
+ * @param profiles Array of pointers to borrowed profile data.
+ * @param count The number of profiles in the array.
+ * @return `0` on success, negative value mapping to `jsError` on error. If
+ * any profile was not borrowed from the scan head, or was already released,
+ * none are released.
+ */
+EXPORTED int32_t PRE jsScanHeadReleaseProfiles(
+  jsScanHead scan_head,
+  const jsRawProfile **profiles,
+  uint32_t count) POST;
+
+/**
+ * @brief Registers a function to be called with each profile received from a
+ * given scan head as soon as it has been assembled. Profiles are passed to the
+ * function without being copied and are not stored for the functions reading
+ * profiles, such as `jsScanHeadGetProfiles`, which will not return any while
+ * a function is registered.
+ *
+ * @note The function is called from a thread internal to the library, either
+ * the one receiving scan data or one set up by
+ * `jsScanSystemSetProfileCallbackThreads`. It should return quickly; when
+ * called from the receive thread, no further data is received from any scan
+ * head serviced by that thread until it returns.
+ *
+ * @note Only profiles assembled with the
+ * `JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES` layout are passed to the function.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_head Reference to scan head.
+ * @param fn The function to call or `NULL` to unregister the function.
+ * @param user_ctx Pointer passed along to the function, may be `NULL`.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadRegisterProfileCallback(
+  jsScanHead scan_head,
+  jsProfileCallback fn,
+  void *user_ctx) POST;
+
+/**
+ * @brief Resamples the profiles of a given scan head to fixed spacing along
+ * the direction of travel. For each camera and laser pair, one profile is
+ * kept each time the encoder value crosses a multiple of `ticks_per_slice`;
+ * the others are dropped, such as when the conveyor is slow or stopped.
+ * Resampling is applied before profiles are queued or passed to the function
+ * registered with `jsScanHeadRegisterProfileCallback`.
+ *
+ * @note A profile is held until the next profile of its camera and laser
+ * pair is received, as that decides whether it is the nearest to the slice
+ * boundary. Profiles without a value for `encoder` are passed through.
+ *
+ * @note Only profiles assembled with the
+ * `JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES` layout are resampled.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_head Reference to scan head.
+ * @param encoder The encoder to resample by.
+ * @param ticks_per_slice Encoder ticks between resampled profiles, `0` to
+ * disable resampling.
+ * @param mode How the profile for each slice is produced.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadSetResampling(
+  jsScanHead scan_head,
+  jsEncoder encoder,
+  uint32_t ticks_per_slice,
+  jsResampleMode mode) POST;
+
+/**
+ * @brief Discards the profiles of a given scan head while nothing is in the
+ * scan window, so they take up no room in the profile buffers and don't wake
+ * up the application. For each camera and laser pair, the gate opens once a
+ * profile has at least `open_points` valid points and closes again once a
+ * profile has fewer than `close_points` valid points. The gate is applied
+ * before resampling set by `jsScanHeadSetResampling`.
+ *
+ * @note The first profile passed on after the gate was closed holds the
+ * number of profiles discarded in its `gap_profiles` field.
+ *
+ * @note Only profiles assembled with the
+ * `JS_PROFILE_LAYOUT_ARRAY_OF_STRUCTURES` layout are gated.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_head Reference to scan head.
+ * @param open_points Valid points needed for the gate to open, `0` to
+ * disable the gate.
+ * @param close_points Valid points below which the gate closes. Must not
+ * exceed `open_points`.
+ * @param pre_roll Number of profiles taken right before the gate opens to
+ * pass on. Must not exceed `JS_PRESENCE_GATE_PRE_ROLL_MAX`.
+ * @param post_roll Number of profiles to pass on after the gate would close.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadSetPresenceGate(
+  jsScanHead scan_head,
+  uint32_t open_points,
+  uint32_t close_points,
+  uint32_t pre_roll,
+  uint32_t post_roll) POST;
+
+/**
+ * @brief Sets the number of profiles that can be buffered for a given scan
+ * head before the application reads them out. The same capacity applies to
+ * profiles waiting on the profile callback. Memory for the profiles, each
+ * roughly the size of a `jsRawProfile`, is allocated up front.
+ *
+ * @note This function can only be called while the scan system is
+ * disconnected and not replaying a recording. Profiles not yet read out are
+ * discarded, and all profiles borrowed from the scan head must have been
+ * released, otherwise `JS_ERROR_INVALID_ARGUMENT` is returned.
+ *
+ * @param scan_head Reference to scan head.
+ * @param capacity The number of profiles to buffer. Must be between `1` and
+ * `JS_SCAN_HEAD_PROFILE_BUFFER_MAX`; defaults to `JS_SCAN_HEAD_PROFILES_MAX`.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadSetProfileBufferCapacity(
+  jsScanHead scan_head,
+  uint32_t capacity) POST;
+
+/**
+ * @brief Sets what happens to newly assembled profiles of a given scan head
+ * when its profile buffer is full. Discarded profiles are counted in the
+ * statistics returned by `jsScanHeadGetReceiveStatistics`.
+ *
+ * @note With `JS_OVERFLOW_POLICY_BLOCK`, receiving data is paused for every
+ * scan head sharing the receive thread, so network buffers may fill up in
+ * turn; keep `timeout_us` short.
+ *
+ * @note This function can not be called while the scan system is scanning.
+ *
+ * @param scan_head Reference to scan head.
+ * @param policy What to do when the profile buffer is full.
+ * @param timeout_us Maximum time in microseconds to wait for room in the
+ * profile buffer with `JS_OVERFLOW_POLICY_BLOCK`, ignored otherwise.
+ * @return `0` on success, negative value mapping to `jsError` on error.
+ */
+EXPORTED int32_t PRE jsScanHeadSetProfileBufferOverflow(
+  jsScanHead scan_head,
+  jsOverflowPolicy policy,
+  uint32_t timeout_us) POST;
+
 /**
  * @brief Obtains a single camera profile from a scan head to be used for
  * diagnostic purposes.